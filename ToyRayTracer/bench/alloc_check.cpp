@@ -0,0 +1,114 @@
+// Checks that the path tracing loop doesn't allocate: builtin scene 1 is rendered at
+// LOW_SPP and at HIGH_SPP samples per pixel in a single pass, and global operator new
+// counts the allocations each render makes on the thread that traces it. Setting up a
+// render allocates the same whatever its spp, so the counts must be equal, more at HIGH_SPP
+// fails the check (exit code 1).
+// Both the packet and the wavefront path are checked. It links the renderer's sources
+// (AllocCheck.vcxproj, or e.g. g++ -O2 -std=c++17 alloc_check.cpp ../src/builtin_scenes.cpp
+// ../src/core/*.cpp -lpthread).
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include "../src/builtin_scenes.h"
+#include "../src/core/render_job.h"
+#include "../src/core/renderer.h"
+
+namespace
+{
+	const int LOW_SPP = 16;
+	const int HIGH_SPP = 64;
+	const char* const OUTPUT_PATH = "./alloc_check.ppm";
+
+	// with one render thread every tile is traced on the calling thread, only its allocations
+	// count: the scheduler's progress reports allocate once per half second, not per sample
+	std::thread::id counted_thread;
+	std::atomic<uint64_t> allocations(0);
+}
+
+// every new and new[] without an alignment ends up here
+void* operator new(std::size_t size)
+{
+	if (std::this_thread::get_id() == counted_thread)
+		allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace
+{
+	// allocations made by one render of loaded at spp, -1 if it failed
+	int64_t CountAllocations(Renderer& renderer, const LoadedScene& loaded, bool wavefront, int spp)
+	{
+		RenderSettings settings;
+		settings.width = 64;
+		settings.height = 64;
+		settings.samples_per_pixel = spp;
+		settings.min_samples = spp;		// one pass, a pass allocates too
+		settings.error_threshold = 0;
+		settings.thread_count = 1;
+		settings.wavefront = wavefront;
+		settings.output_path = OUTPUT_PATH;
+		settings.stream_tiles = false;
+
+		RenderStats stats;
+		uint64_t before = allocations.load();
+		bool written = renderer.Render(*loaded.accel, loaded.scene, loaded.scene.camera, settings, stats);
+		uint64_t after = allocations.load();
+		return written ? static_cast<int64_t>(after - before) : -1;
+	}
+
+	// false if the render at HIGH_SPP allocates more than the one at LOW_SPP
+	bool Check(Renderer& renderer, const LoadedScene& loaded, bool wavefront)
+	{
+		const char* name = wavefront ? "wavefront" : "packets";
+
+		// the first render grows the buffers a thread keeps between renders
+		CountAllocations(renderer, loaded, wavefront, HIGH_SPP);
+
+		int64_t low = CountAllocations(renderer, loaded, wavefront, LOW_SPP);
+		int64_t high = CountAllocations(renderer, loaded, wavefront, HIGH_SPP);
+		if (low < 0 || high < 0)
+		{
+			std::printf("%-10s render failed\n", name);
+			return false;
+		}
+
+		bool passed = high <= low;
+		std::printf("%-10s %lld allocations at %d spp, %lld at %d spp: %s\n", name, static_cast<long long>(low), LOW_SPP,
+			static_cast<long long>(high), HIGH_SPP, passed ? "ok" : "FAILED, the render loop allocates");
+		return passed;
+	}
+}
+
+int main()
+{
+	counted_thread = std::this_thread::get_id();
+	SceneLibrary library(BuildScene);
+	RenderJob job;
+	job.builtin_scene = 1;
+	bool cached = false;
+	LoadedScene* loaded = library.Get(job, cached);
+	if (!loaded || !library.Prepare(job, *loaded, false, cached))
+		return 1;
+
+	Renderer renderer;
+	bool passed = Check(renderer, *loaded, false);
+	passed = Check(renderer, *loaded, true) && passed;
+	std::remove(OUTPUT_PATH);
+	return passed ? 0 : 1;
+}
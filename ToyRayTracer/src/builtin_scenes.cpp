@@ -0,0 +1,178 @@
+#include "./builtin_scenes.h"
+
+#include <iostream>
+#include <vector>
+
+#include "core/instance.h"
+#include "core/materials.h"
+#include "core/math.h"
+#include "core/aarec.h"
+#include "core/box_array.h"
+#include "core/simple_shape.h"
+#include "core/texture.h"
+
+bool BuildScene(int id, Scene& scene)
+{
+	scene.lights = make_shared<HittableList>();
+	switch (id)
+	{
+	case 1:
+		scene.world = CornellBox1(scene.materials);
+		scene.lights->add(make_shared<XZRect>(193, 363, 207, 352, 554, NO_MATERIAL));
+		scene.lights->add(make_shared<Sphere>(Point3(215.5, 300, 100), 80, NO_MATERIAL));
+		scene.camera.lookfrom = Point3(278, 278, -800);
+		scene.camera.lookat = Point3(278, 278, 0);
+		return true;
+
+	case 2:
+		scene.world = CornellBox2(scene.materials);
+		scene.lights->add(make_shared<XZRect>(153, 403, 187, 372, 554, NO_MATERIAL));
+		scene.camera.lookfrom = Point3(278, 278, -800);
+		scene.camera.lookat = Point3(278, 278, 0);
+		return true;
+
+	case 3:
+		scene.world = NextWeekendFinalScene(scene.materials);
+		scene.lights->add(make_shared<XZRect>(123, 423, 147, 412, 554, NO_MATERIAL));
+		scene.camera.lookfrom = Point3(478, 278, -600);
+		scene.camera.lookat = Point3(278, 278, 0);
+		return true;
+
+	default:
+		std::cerr << "ERROR: there is no scene " << id << "\n";
+		return false;
+	}
+}
+
+HittableList CornellBox1(MaterialTable& materials)
+{
+	HittableList objects;
+
+	auto red = materials.Add(make_shared<Lambertian>(Color(.65, .05, .05)));
+	auto white = materials.Add(make_shared<Lambertian>(Color(.73, .73, .73)));
+	auto green = materials.Add(make_shared<Lambertian>(Color(.22, .45, .15)));
+	auto blue = materials.Add(make_shared<Lambertian>(Color(.12, .42, .75)));
+	auto light = materials.Add(make_shared<DiffuseLight>(Color(15, 15, 15)));
+
+	objects.add(make_shared<YZRect>(0, 555, 0, 555, 555, green));
+	objects.add(make_shared<YZRect>(0, 555, 0, 555, 0, red));
+	objects.add(make_shared<FlipFace>(make_shared<XZRect>(193, 363, 207, 352, 554, light)));// ԴfrontfaceҪתһ£adapterģʽ
+
+	objects.add(make_shared<XZRect>(0, 555, 0, 555, 0, white));
+	objects.add(make_shared<XZRect>(0, 555, 0, 555, 555, white));
+	objects.add(make_shared<XYRect>(0, 555, 0, 555, 555, white));
+
+	shared_ptr<Hittable> box1 = make_shared<Box>(Point3(0, 0, 0), Point3(165, 220, 165), blue);
+	box1 = make_shared<Instance>(box1, Transform::Translation(Vec3(130, 0, 65)) * Transform::Rotation(Vec3(0, 1, 0), -18));
+	objects.add(box1);	
+	auto glass = materials.Add(make_shared<Dielectric>(1.5));
+	objects.add(make_shared<Sphere>(Point3(215.5, 300, 130), 80, glass));
+
+	auto aluminum = materials.Add(make_shared<Metal>(Color(0.8, 0.85, 0.85), 0.0));
+	shared_ptr<Hittable> box2 = make_shared<Box>(Point3(0, 0, 0), Point3(165, 300, 165), aluminum);
+	box2 = make_shared<Instance>(box2, Transform::Translation(Vec3(300, 0, 295)) * Transform::Rotation(Vec3(0, 1, 0), 15));
+	objects.add(box2);
+
+	return objects;
+}
+
+HittableList CornellBox2(MaterialTable& materials)
+{
+	HittableList objects;
+
+	auto red = materials.Add(make_shared<Lambertian>(Color(.65, .05, .05)));
+	auto white = materials.Add(make_shared<Lambertian>(Color(.73, .73, .73)));
+	auto green = materials.Add(make_shared<Lambertian>(Color(.22, .45, .15)));
+	auto light = materials.Add(make_shared<DiffuseLight>(Color(15, 15, 15)));
+
+	objects.add(make_shared<YZRect>(0, 555, 0, 555, 555, green));
+	objects.add(make_shared<YZRect>(0, 555, 0, 555, 0, red));
+	objects.add(make_shared<FlipFace>(make_shared<XZRect>(153, 403, 187, 372, 554, light)));// ԴfrontfaceҪתһ£adapterģʽ
+
+	objects.add(make_shared<XZRect>(0, 555, 0, 555, 0, white));
+	objects.add(make_shared<XZRect>(0, 555, 0, 555, 555, white));
+	objects.add(make_shared<XYRect>(0, 555, 0, 555, 555, white));
+
+	shared_ptr<Hittable> box1 = make_shared<Box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
+	box1 = make_shared<Instance>(box1, Transform::Translation(Vec3(265, 0, 295)) * Transform::Rotation(Vec3(0, 1, 0), 15));
+
+	shared_ptr<Hittable> box2 = make_shared<Box>(Point3(0, 0, 0), Point3(165, 165, 165), white);
+	box2 = make_shared<Instance>(box2, Transform::Translation(Vec3(130, 0, 65)) * Transform::Rotation(Vec3(0, 1, 0), -18));
+
+	auto boundary = make_shared<Sphere>(Point3(185, 235, 195), 70, materials.Add(make_shared<Dielectric>(1.5)));
+	objects.add(boundary);
+	objects.add(make_shared<ConstantMedium>(boundary, 0.1, materials.Add(make_shared<Isotropic>(Color(0.25, 0.75, 0.4)))));
+
+	objects.add(make_shared<ConstantMedium>(box1, 0.01, materials.Add(make_shared<Isotropic>(Color(0.9, 0.9, 0.9)))));
+	objects.add(make_shared<ConstantMedium>(box2, 0.01, materials.Add(make_shared<Isotropic>(Color(0.2, 0.4, 0.9)))));
+
+	return objects;
+}
+
+
+HittableList NextWeekendFinalScene(MaterialTable& materials)
+{
+	std::vector<AABB> boxes1;
+	auto ground = materials.Add(make_shared<Lambertian>(Color(0.48, 0.83, 0.53)));
+
+	// ground box
+	const int boxes_per_side = 20;
+	for (int i = 0; i < boxes_per_side; i++) 
+	{
+		for (int j = 0; j < boxes_per_side; j++) 
+		{
+			auto w = 100.0;
+			auto x0 = -1000.0 + i * w;
+			auto z0 = -1000.0 + j * w;
+			auto y0 = 0.0;
+			auto x1 = x0 + w;
+			auto y1 = RandomDouble(1, 101);
+			auto z1 = z0 + w;
+
+			boxes1.push_back(AABB(Point3(x0, y0, z0), Point3(x1, y1, z1)));
+		}
+	}
+
+	HittableList objects;
+
+	objects.add(make_shared<BoxArray>(boxes1, ground));
+
+	// top light
+	auto light = materials.Add(make_shared<DiffuseLight>(Color(7, 7, 7)));
+	objects.add(make_shared<FlipFace>(make_shared<XZRect>(123, 423, 147, 412, 554, light)));
+
+	// sphere
+	auto center = Point3(400, 400, 200);
+	auto moving_sphere_material = materials.Add(make_shared<Lambertian>(Color(0.7, 0.3, 0.1)));
+	objects.add(make_shared<Sphere>(center, 50, moving_sphere_material));
+
+	// glass sphere and metal sphere
+	objects.add(make_shared<Sphere>(Point3(260, 150, 45), 50, materials.Add(make_shared<Dielectric>(1.5))));
+	objects.add(make_shared<Sphere>(Point3(0, 150, 145), 50, materials.Add(make_shared<Metal>(Color(0.8, 0.8, 0.9), 1.0))));
+
+	// subsurface
+	auto boundary = make_shared<Sphere>(Point3(360, 170, 145), 70, materials.Add(make_shared<Dielectric>(1.5)));
+	objects.add(boundary);
+	objects.add(make_shared<ConstantMedium>(boundary, 0.2, materials.Add(make_shared<Isotropic>(Color(0.2, 0.4, 0.9)))));
+
+	// huge fog
+	boundary = make_shared<Sphere>(Point3(0, 0, 0), 5000, materials.Add(make_shared<Dielectric>(1.5)));
+	objects.add(make_shared<ConstantMedium>(boundary, .0001, materials.Add(make_shared<Isotropic>(Color(0.1, 0.1, 0.1)))));
+
+	auto emat = materials.Add(make_shared<Lambertian>(make_shared<ImageTexture>("./src/resource/earthmap.jpg")));
+	objects.add(make_shared<Sphere>(Point3(400, 200, 400), 100, emat));
+
+	objects.add(make_shared<Sphere>(Point3(220, 280, 300), 80, materials.Add(make_shared<Metal>(Color(0.8, 0.88, 0.85), 0.0))));
+
+	HittableList boxes2;
+	auto white = materials.Add(make_shared<Lambertian>(Color(.73, .73, .73)));
+	int ns = 1000;
+	for (int j = 0; j < ns; j++) {
+		boxes2.add(make_shared<Sphere>(Point3::Random(0, 165), 10, white));
+	}
+
+	objects.add(make_shared<Instance>(make_shared<HittableList>(boxes2),
+		Transform::Translation(Vec3(-100, 270, 395)) * Transform::Rotation(Vec3(0, 1, 0), 15)));
+
+	return objects;
+}
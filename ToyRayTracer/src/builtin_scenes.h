@@ -0,0 +1,9 @@
+#pragma once
+#include "core/scene.h"
+
+// The scenes built in code, --builtin N picks one. BuildScene fills scene with scene id
+// (1 to 3) and its camera, it returns false for any other id.
+bool BuildScene(int id, Scene& scene);
+HittableList CornellBox1(MaterialTable& materials);
+HittableList CornellBox2(MaterialTable& materials);
+HittableList NextWeekendFinalScene(MaterialTable& materials);
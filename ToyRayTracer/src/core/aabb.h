@@ -8,21 +8,29 @@
 class AABB
 {
 public:
-	AABB();
-	AABB(const Point3& a, const Point3& b);
+	AABB() {}
+	AABB(const Point3& a, const Point3& b) : minimum(a), maximum(b) {}
 
-	Point3 min() const;
-	Point3 max() const; 
+	const Point3& min() const { return minimum; }
+	const Point3& max() const { return maximum; }
 
 	// optimized hit function
 	inline bool Hit(const Ray& r, double t_min, double t_max) const
+	{
+		const Vec3 d = r.Direction();
+		return Hit(r.Origin(), Vec3(1.0 / d.x(), 1.0 / d.y(), 1.0 / d.z()), t_min, t_max);
+	}
+
+	// slab test with the reciprocal ray direction precomputed by the caller, so a
+	// traversal pays the three divisions once per ray instead of once per box
+	inline bool Hit(const Point3& o, const Vec3& inv_dir, double t_min, double t_max) const
 	{
 		for (int a = 0; a < 3; a++)
 		{
-			auto invD = 1.0f / r.Direction()[a];
-			auto t0 = (min()[a] - r.Origin()[a]) * invD;
-			auto t1 = (max()[a] - r.Origin()[a]) * invD;
-			if (invD < 0.0f)	// ڵǰslabǷ򴫲Ǿͽt0,t1
+			auto invD = inv_dir.e[a];
+			auto t0 = (minimum.e[a] - o.e[a]) * invD;
+			auto t1 = (maximum.e[a] - o.e[a]) * invD;
+			if (invD < 0.0)	// ڵǰslabǷ򴫲Ǿͽt0,t1
 				std::swap(t0, t1);
 
 			// t_minԱ֤t_maxҪ>0УַҲtrue
@@ -39,4 +47,17 @@ private:
 	Point3 maximum;
 };
 
-AABB SurroundingBox(AABB box0, AABB box1);
\ No newline at end of file
+inline AABB SurroundingBox(const AABB& box0, const AABB& box1)
+{
+	// ҵ2СǸx,y,z
+	Point3 small(fmin(box0.min().x(), box1.min().x()),
+		fmin(box0.min().y(), box1.min().y()),
+		fmin(box0.min().z(), box1.min().z()));
+
+	// ҵ2Ǹx,y,z
+	Point3 big(fmax(box0.max().x(), box1.max().x()),
+		fmax(box0.max().y(), box1.max().y()),
+		fmax(box0.max().z(), box1.max().z()));
+
+	return AABB(small, big);
+}
\ No newline at end of file
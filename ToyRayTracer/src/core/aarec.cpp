@@ -23,22 +23,53 @@ bool XYRect::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
 	rec.t = t;
 	auto outward_normal = Vec3(0, 0, 1);
 	rec.SetFaceNormal(r, outward_normal);
-	rec.mat_ptr = mp;
+	rec.mat_id = mat_id;
 	rec.p = r.At(t);
 	return true;
 }
 
+bool XYRect::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	auto t = (k - r.Origin().z()) / r.Direction().z();
+	if (t < t_min || t > t_max)
+		return false;
+	auto x = r.Origin().x() + t * r.Direction().x();
+	auto y = r.Origin().y() + t * r.Direction().y();
+	return x >= x0 && x <= x1 && y >= y0 && y <= y1;
+}
+
+double XYRect::PDFValue(const Point3& origin, const Vec3& v) const
+{
+	if (!Occluded(Ray(origin, v), 0.001, INF))
+		return 0;
+
+	// the normal is the z axis
+	auto t = (k - origin.z()) / v.z();
+	auto area = (x1 - x0)*(y1 - y0);
+	auto distance_squared = t * t * v.LengthSquared();
+	auto cosine = fabs(v.z() / v.Length());
+
+	return distance_squared / (cosine * area);
+}
+
+Vec3 XYRect::Random(const Point3& origin) const
+{
+	auto random_point = Point3(RandomDouble(x0, x1), RandomDouble(y0, y1), k);
+	return random_point - origin;
+}
+
 // ---XZRect---
 
 double XZRect::PDFValue(const Point3& origin, const Vec3& v) const
 {
-	HitRecord rec;
-	if (!this->Hit(Ray(origin, v), 0.001, INF, rec))
+	if (!Occluded(Ray(origin, v), 0.001, INF))
 		return 0;
 
+	// the normal is the y axis
+	auto t = (k - origin.y()) / v.y();
 	auto area = (x1 - x0)*(z1 - z0);
-	auto distance_squared = rec.t * rec.t * v.LengthSquared();
-	auto cosine = fabs(DotProduct(v, rec.normal) / v.Length());
+	auto distance_squared = t * t * v.LengthSquared();
+	auto cosine = fabs(v.y() / v.Length());
 
 	return distance_squared / (cosine * area);
 }
@@ -71,11 +102,21 @@ bool XZRect::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
 	rec.t = t;
 	auto outward_normal = Vec3(0, 1, 0);
 	rec.SetFaceNormal(r, outward_normal);
-	rec.mat_ptr = mp;
+	rec.mat_id = mat_id;
 	rec.p = r.At(t);
 	return true;
 }
 
+bool XZRect::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	auto t = (k - r.Origin().y()) / r.Direction().y();
+	if (t < t_min || t > t_max)
+		return false;
+	auto x = r.Origin().x() + t * r.Direction().x();
+	auto z = r.Origin().z() + t * r.Direction().z();
+	return x >= x0 && x <= x1 && z >= z0 && z <= z1;
+}
+
 // ---YZRect---
  bool YZRect::BoundingBox(AABB& output_box) const
  {
@@ -99,7 +140,37 @@ bool YZRect::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
 	rec.t = t;
 	auto outward_normal = Vec3(1, 0, 0);
 	rec.SetFaceNormal(r, outward_normal);
-	rec.mat_ptr = mp;
+	rec.mat_id = mat_id;
 	rec.p = r.At(t);
 	return true;
+}
+
+bool YZRect::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	auto t = (k - r.Origin().x()) / r.Direction().x();
+	if (t < t_min || t > t_max)
+		return false;
+	auto y = r.Origin().y() + t * r.Direction().y();
+	auto z = r.Origin().z() + t * r.Direction().z();
+	return y >= y0 && y <= y1 && z >= z0 && z <= z1;
+}
+
+double YZRect::PDFValue(const Point3& origin, const Vec3& v) const
+{
+	if (!Occluded(Ray(origin, v), 0.001, INF))
+		return 0;
+
+	// the normal is the x axis
+	auto t = (k - origin.x()) / v.x();
+	auto area = (y1 - y0)*(z1 - z0);
+	auto distance_squared = t * t * v.LengthSquared();
+	auto cosine = fabs(v.x() / v.Length());
+
+	return distance_squared / (cosine * area);
+}
+
+Vec3 YZRect::Random(const Point3& origin) const
+{
+	auto random_point = Point3(k, RandomDouble(y0, y1), RandomDouble(z0, z1));
+	return random_point - origin;
 }
\ No newline at end of file
@@ -8,15 +8,20 @@ public:
 	XYRect() {}
 
 	XYRect(double _x0, double _x1, double _y0, double _y1, double _k,
-		shared_ptr<Material> mat)
-		: x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mp(mat) {};
+		MaterialID mat)
+		: x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mat_id(mat) {};
 
 	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
 	virtual bool BoundingBox(AABB& output_box) const override;
 
+	virtual double PDFValue(const Point3& origin, const Vec3& v) const override;
+	virtual Vec3 Random(const Point3& origin) const override;
+	virtual double Area() const override { return (x1 - x0) * (y1 - y0); }
+
 public:
-	shared_ptr<Material> mp;
-	double x0, x1, y0, y1, k;
+	MaterialID mat_id;
+	Real x0, x1, y0, y1, k;
 };
 
 class XZRect : public Hittable {
@@ -24,18 +29,20 @@ public:
 	XZRect() {}
 
 	XZRect(double _x0, double _x1, double _z0, double _z1, double _k,
-		shared_ptr<Material> mat)
-		: x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mp(mat) {};
+		MaterialID mat)
+		: x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mat_id(mat) {};
 
 	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
 	virtual bool BoundingBox(AABB& output_box) const override;
 
 	virtual double PDFValue(const Point3& origin, const Vec3& v) const override;
 	virtual Vec3 Random(const Point3& origin) const override;
+	virtual double Area() const override { return (x1 - x0) * (z1 - z0); }
 
 public:
-	shared_ptr<Material> mp;
-	double x0, x1, z0, z1, k;
+	MaterialID mat_id;
+	Real x0, x1, z0, z1, k;
 };
 
 
@@ -45,14 +52,19 @@ public:
 	YZRect() {}
 
 	YZRect(double _y0, double _y1, double _z0, double _z1, double _k,
-		shared_ptr<Material> mat)
-		: y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mp(mat) {};
+		MaterialID mat)
+		: y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mat_id(mat) {};
 
 	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
 	virtual bool BoundingBox(AABB& output_box) const override;
 
+	virtual double PDFValue(const Point3& origin, const Vec3& v) const override;
+	virtual Vec3 Random(const Point3& origin) const override;
+	virtual double Area() const override { return (y1 - y0) * (z1 - z0); }
+
 public:
-	shared_ptr<Material> mp;
-	double y0, y1, z0, z1, k;
+	MaterialID mat_id;
+	Real y0, y1, z0, z1, k;
 };
 
@@ -0,0 +1,24 @@
+#include "./animation.h"
+
+// ---Animation---
+
+void Animation::SetTime(double time) const
+{
+	for (const auto& translate : translations)
+		translate->offset = translate->motion.At(time);
+
+	for (const auto& rotate : rotations)
+		rotate->SetAngle(rotate->motion.At(time));
+}
+
+std::vector<const Hittable*> Animation::Targets() const
+{
+	std::vector<const Hittable*> targets;
+	for (const auto& translate : translations)
+		targets.push_back(translate.get());
+	for (const auto& rotate : rotations)
+		targets.push_back(rotate.get());
+	for (const auto& object : moving)
+		targets.push_back(object.get());
+	return targets;
+}
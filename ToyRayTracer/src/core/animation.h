@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+
+#include "./math.h"
+#include "./hittable.h"
+#include "./keyframes.h"
+
+// The moving objects of a scene: transforms with keyframes (Translate::motion,
+// RotateY::motion) and objects that move by themselves (e.g. MovingSphere). Rays carry
+// the time they are traced at and find the objects where they are then, SceneAccel::Update
+// fits the acceleration structure to the frame (or shutter interval) being rendered.
+struct Animation
+{
+	std::vector<shared_ptr<Translate>> translations;
+	std::vector<shared_ptr<RotateY>> rotations;
+	std::vector<shared_ptr<Hittable>> moving;
+
+	bool Empty() const { return translations.empty() && rotations.empty() && moving.empty(); }
+
+	// Pose the transforms at time for what doesn't carry a time, i.e. light sampling
+	void SetTime(double time) const;
+
+	// every animated object, for SceneAccel to find what can move
+	std::vector<const Hittable*> Targets() const;
+};
@@ -0,0 +1,163 @@
+#include "./box_array.h"
+
+#include "./simple_shape.h"
+
+namespace
+{
+	// boxes of a leaf, tested in one loop
+	const int MAX_LEAF_SIZE = 8;
+
+	// The sah build splits down to one or two boxes, as a box costs it as much as a
+	// primitive behind a virtual call. A box here is a few flops in a loop, so every
+	// subtree of at most MAX_LEAF_SIZE boxes becomes one leaf (its boxes are consecutive
+	// in the order) and its nodes are left behind unused.
+	// returns the boxes below index and sets first to the first of them
+	uint32_t MergeSmallSubtrees(std::vector<LinearBVHNode>& nodes, uint32_t index, uint32_t& first)
+	{
+		LinearBVHNode& node = nodes[index];
+		if (node.primitive_count > 0)
+		{
+			first = node.offset;
+			return node.primitive_count;
+		}
+
+		uint32_t second_first;
+		const uint32_t count = MergeSmallSubtrees(nodes, index + 1, first)
+			+ MergeSmallSubtrees(nodes, node.offset, second_first);
+		if (count <= MAX_LEAF_SIZE)
+		{
+			node.offset = first;
+			node.primitive_count = static_cast<uint16_t>(count);
+		}
+		return count;
+	}
+
+	// A ray against the boxes of a BoxArray, with the near and far side of every axis
+	// picked once from the ray's direction, so a leaf is a loop without branches over the
+	// arrays.
+	struct RaySlabs
+	{
+		Point3 o;
+		Vec3 inv_dir;
+		const Real* near_side[3];
+		const Real* far_side[3];
+
+		RaySlabs(const Ray& r, const BoxArray& boxes) : o(r.Origin())
+		{
+			const Vec3 d = r.Direction();
+			inv_dir = Vec3(1.0 / d.x(), 1.0 / d.y(), 1.0 / d.z());
+			const std::vector<Real>* lo[3] = { &boxes.x0, &boxes.y0, &boxes.z0 };
+			const std::vector<Real>* hi[3] = { &boxes.x1, &boxes.y1, &boxes.z1 };
+			for (int a = 0; a < 3; a++)
+			{
+				near_side[a] = (inv_dir.e[a] < 0 ? hi[a] : lo[a])->data();
+				far_side[a] = (inv_dir.e[a] < 0 ? lo[a] : hi[a])->data();
+			}
+		}
+
+		// the box of first..last hit closest between t_min and closest, which shrinks to the hit
+		inline bool Nearest(uint32_t first, uint32_t last, double t_min, double& closest, uint32_t& nearest) const
+		{
+			bool found = false;
+			for (uint32_t i = first; i < last; ++i)
+			{
+				// a ray in the plane of a side gets nan, the comparisons leave it out
+				double t_near = (near_side[0][i] - o.e[0]) * inv_dir.e[0];
+				double t_far = (far_side[0][i] - o.e[0]) * inv_dir.e[0];
+				for (int a = 1; a < 3; a++)
+				{
+					const double t0 = (near_side[a][i] - o.e[a]) * inv_dir.e[a];
+					const double t1 = (far_side[a][i] - o.e[a]) * inv_dir.e[a];
+					t_near = t0 > t_near ? t0 : t_near;
+					t_far = t1 < t_far ? t1 : t_far;
+				}
+
+				// a ray starting inside the box hits it where it leaves
+				const double t = t_near >= t_min ? t_near : t_far;
+				const bool hit = t_near <= t_far && t >= t_min && t <= closest;
+				closest = hit ? t : closest;
+				nearest = hit ? i : nearest;
+				found = found || hit;
+			}
+			return found;
+		}
+	};
+}
+
+// ---BoxArray---
+
+BoxArray::BoxArray(const std::vector<AABB>& boxes, MaterialID m)
+	: simd(DetectSimdLevel()), mat_id(m)
+{
+	for (size_t i = 0; i < boxes.size(); ++i)
+		box = i == 0 ? boxes[i] : SurroundingBox(box, boxes[i]);
+
+	// store the boxes in leaf order, leaves then index them directly
+	std::vector<LinearBVHNode> binary;
+	std::vector<uint32_t> order;
+	BuildLinearBVH(boxes, binary, order, MAX_LEAF_SIZE);
+	if (!binary.empty())
+	{
+		uint32_t first;
+		MergeSmallSubtrees(binary, 0, first);
+		CollapseBVH(binary, 0, nodes);
+		nodes.shrink_to_fit();
+	}
+	for (auto* v : { &x0, &y0, &z0, &x1, &y1, &z1 })
+		v->reserve(order.size());
+	for (uint32_t i : order)
+	{
+		const AABB& b = boxes[i];
+		x0.push_back(b.min().x()); y0.push_back(b.min().y()); z0.push_back(b.min().z());
+		x1.push_back(b.max().x()); y1.push_back(b.max().y()); z1.push_back(b.max().z());
+	}
+}
+
+bool BoxArray::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
+{
+	if (nodes.empty())
+		return false;
+
+	const RaySlabs ray(r, *this);
+	uint32_t hit_box = 0;
+	bool hit_anything = TraverseWideBVH<4>(nodes.data(), simd, RayBoxData(r), 0, t_min, t_max,
+		[&](uint32_t first, uint32_t count, double& closest) {
+			uint32_t nearest;
+			if (!ray.Nearest(first, first + count, t_min, closest, nearest))
+				return false;
+			hit_box = nearest;
+			return true;
+		});
+
+	if (!hit_anything)
+		return false;
+
+	// the side is only worked out for the box that was hit
+	const Real lo[3] = { x0[hit_box], y0[hit_box], z0[hit_box] };
+	const Real hi[3] = { x1[hit_box], y1[hit_box], z1[hit_box] };
+	double t;
+	int face;
+	if (!Box::Intersect(lo, hi, r.Origin(), ray.inv_dir, t_min, t_max, t, face))
+		return false;
+	Box::FillHitRecord(lo, hi, r, t, face, mat_id, rec);
+	return true;
+}
+
+bool BoxArray::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	if (nodes.empty())
+		return false;
+
+	const RaySlabs ray(r, *this);
+	return TraverseWideBVH<4, true>(nodes.data(), simd, RayBoxData(r), 0, t_min, t_max,
+		[&](uint32_t first, uint32_t count, double& t_far) {
+			uint32_t nearest;
+			return ray.Nearest(first, first + count, t_min, t_far, nearest);
+		});
+}
+
+bool BoxArray::BoundingBox(AABB& output_box) const
+{
+	output_box = box;
+	return !x0.empty();
+}
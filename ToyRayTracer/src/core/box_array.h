@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+
+#include "./math.h"
+#include "./hittable.h"
+#include "./bvh.h"
+#include "./bvh_wide.h"
+#include "./materials.h"
+
+// Many axis aligned boxes of one material with their own 4 wide bvh, e.g. a field of
+// ground blocks. A box is six numbers in structure of arrays instead of a Box behind a
+// shared_ptr, the boxes of a leaf are slab tested straight from the arrays without a
+// virtual call and only the closest one works out its side and fills in the hit record.
+class BoxArray : public Hittable
+{
+public:
+	BoxArray(const std::vector<AABB>& boxes, MaterialID m);
+
+	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
+	virtual bool BoundingBox(AABB& output_box) const override;
+
+	size_t Size() const { return x0.size(); }
+	AABB BoxAt(size_t i) const { return AABB(Point3(x0[i], y0[i], z0[i]), Point3(x1[i], y1[i], z1[i])); }
+
+public:
+	std::vector<Real> x0, y0, z0;	// min corners, in bvh leaf order
+	std::vector<Real> x1, y1, z1;	// max corners
+	std::vector<WideBVHNode<4>> nodes;
+	SimdLevel simd;
+	AABB box;
+	MaterialID mat_id;
+};
@@ -1,5 +1,7 @@
 #include "./bvh.h"
 
+#include <thread>
+
 bool BVHNode::BoundingBox(AABB& output_box) const
 {
 	output_box = box;
@@ -66,4 +68,731 @@ bool BVHNode::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) cons
 	bool Hit_right = right->Hit(r, t_min, Hit_left ? rec.t : t_max, rec);
 
 	return Hit_left || Hit_right;
-}
\ No newline at end of file
+}
+
+bool BVHNode::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	if (!box.Hit(r, t_min, t_max))
+		return false;
+
+	return left->Occluded(r, t_min, t_max) || right->Occluded(r, t_min, t_max);
+}
+
+// ---PacketInterval---
+
+RayBoxData::RayBoxData(const Ray& r)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		origin[a] = static_cast<float>(r.Origin()[a]);
+		inv_dir[a] = static_cast<float>(1.0 / r.Direction()[a]);
+		sign[a] = inv_dir[a] < 0 ? 1 : 0;
+	}
+}
+
+bool PacketInterval::Set(const RayPacket& packet, uint32_t mask, RayBoxData* rays)
+{
+	bool coherent = true;
+	bool first_ray = true;
+	for (int k = 0; k < packet.size; ++k)
+	{
+		if (!(mask & (1u << k)))
+			continue;
+
+		rays[k] = RayBoxData(packet.rays[k]);
+		for (int a = 0; a < 3; a++)
+		{
+			coherent = coherent && std::isfinite(rays[k].inv_dir[a]);
+			if (first_ray)
+			{
+				origin_min[a] = origin_max[a] = rays[k].origin[a];
+				inv_min[a] = inv_max[a] = rays[k].inv_dir[a];
+				sign[a] = rays[k].sign[a];
+				continue;
+			}
+			coherent = coherent && sign[a] == rays[k].sign[a];
+			origin_min[a] = std::min(origin_min[a], rays[k].origin[a]);
+			origin_max[a] = std::max(origin_max[a], rays[k].origin[a]);
+			inv_min[a] = std::min(inv_min[a], rays[k].inv_dir[a]);
+			inv_max[a] = std::max(inv_max[a], rays[k].inv_dir[a]);
+		}
+		first_ray = false;
+	}
+	return coherent;
+}
+
+// ---LinearBVH---
+
+void LinearBVHNode::SetBounds(const AABB& box)
+{
+	// round outwards so the float box never cuts into the double precision primitive
+	for (int a = 0; a < 3; a++)
+	{
+		bounds_min[a] = std::nextafter(static_cast<float>(box.min()[a]), -std::numeric_limits<float>::infinity());
+		bounds_max[a] = std::nextafter(static_cast<float>(box.max()[a]), std::numeric_limits<float>::infinity());
+	}
+}
+
+namespace
+{
+	// node of the packet traversal and the packet rays that reach it
+	struct PacketStackEntry
+	{
+		uint32_t index;
+		uint32_t mask;
+	};
+
+	// box the build grows inline, AABB and SurroundingBox cost a call per coordinate
+	struct BuildBox
+	{
+		double lo[3] = { INF, INF, INF };
+		double hi[3] = { -INF, -INF, -INF };
+
+		BuildBox() {}
+		BuildBox(const AABB& box)
+		{
+			const Point3 a = box.min(), b = box.max();
+			for (int i = 0; i < 3; i++)
+			{
+				lo[i] = a.e[i];
+				hi[i] = b.e[i];
+			}
+		}
+
+		void Grow(const BuildBox& box)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				lo[i] = std::min(lo[i], box.lo[i]);
+				hi[i] = std::max(hi[i], box.hi[i]);
+			}
+		}
+
+		void Grow(const Point3& p)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				lo[i] = std::min<double>(lo[i], p.e[i]);
+				hi[i] = std::max<double>(hi[i], p.e[i]);
+			}
+		}
+
+		AABB ToAABB() const { return AABB(Point3(lo[0], lo[1], lo[2]), Point3(hi[0], hi[1], hi[2])); }
+	};
+
+	struct BuildPrimitive
+	{
+		BuildBox bounds;
+		Point3 centroid;
+		uint32_t index;
+	};
+
+	struct SAHBucket
+	{
+		int count = 0;
+		BuildBox bounds;
+	};
+
+	const int SAH_BUCKET_COUNT = 12;
+	const double SAH_TRAVERSAL_COST = 0.125;	// relative to one primitive intersection
+
+	// ranges at least this big are binned by several threads
+	const size_t PARALLEL_BIN_MIN = 65536;
+	// and their halves are built by different threads
+	const size_t PARALLEL_BUILD_MIN = 8192;
+
+	double SurfaceArea(const BuildBox& box)
+	{
+		const double dx = box.hi[0] - box.lo[0], dy = box.hi[1] - box.lo[1], dz = box.hi[2] - box.lo[2];
+		return 2 * (dx * dy + dy * dz + dz * dx);
+	}
+
+	double SurfaceArea(const LinearBVHNode& node)
+	{
+		const double dx = node.bounds_max[0] - node.bounds_min[0];
+		const double dy = node.bounds_max[1] - node.bounds_min[1];
+		const double dz = node.bounds_max[2] - node.bounds_min[2];
+		return 2 * (dx * dy + dy * dz + dz * dx);
+	}
+
+	// run body(chunk, first, last) over threads contiguous chunks of [start, end), the
+	// calling thread takes the first one
+	template<typename Body>
+	void ParallelChunks(size_t start, size_t end, int threads, Body body)
+	{
+		const size_t chunk_size = (end - start + threads - 1) / threads;
+		std::vector<std::thread> workers;
+		for (int chunk = 1; chunk < threads; ++chunk)
+		{
+			size_t first = std::min(end, start + chunk * chunk_size);
+			size_t last = std::min(end, first + chunk_size);
+			workers.emplace_back([=]() { body(chunk, first, last); });
+		}
+		body(0, start, std::min(end, start + chunk_size));
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	// box around the primitives and around their centroids
+	void RangeBounds(const std::vector<BuildPrimitive>& prims, size_t start, size_t end, int threads,
+		BuildBox& bounds, BuildBox& centroid_bounds)
+	{
+		auto bound = [&](size_t first, size_t last, BuildBox& b, BuildBox& c) {
+			b = c = BuildBox();
+			for (size_t i = first; i < last; ++i)
+			{
+				b.Grow(prims[i].bounds);
+				c.Grow(prims[i].centroid);
+			}
+		};
+
+		if (threads <= 1 || end - start < PARALLEL_BIN_MIN)
+		{
+			bound(start, end, bounds, centroid_bounds);
+			return;
+		}
+
+		// min and max don't depend on the order, the boxes come out the same
+		std::vector<BuildBox> chunk_bounds(threads), chunk_centroids(threads);
+		ParallelChunks(start, end, threads, [&](int chunk, size_t first, size_t last) {
+			bound(first, last, chunk_bounds[chunk], chunk_centroids[chunk]);
+		});
+		bounds = centroid_bounds = BuildBox();
+		for (int chunk = 0; chunk < threads; ++chunk)
+		{
+			bounds.Grow(chunk_bounds[chunk]);
+			centroid_bounds.Grow(chunk_centroids[chunk]);
+		}
+	}
+
+	// fill the sah buckets with the primitives, bucket_of places a primitive
+	template<typename BucketOf>
+	void BinPrimitives(const std::vector<BuildPrimitive>& prims, size_t start, size_t end, int threads,
+		BucketOf bucket_of, SAHBucket* buckets)
+	{
+		auto bin = [&](size_t first, size_t last, SAHBucket* into) {
+			for (size_t i = first; i < last; ++i)
+			{
+				auto& bucket = into[bucket_of(prims[i])];
+				bucket.count++;
+				bucket.bounds.Grow(prims[i].bounds);
+			}
+		};
+
+		if (threads <= 1 || end - start < PARALLEL_BIN_MIN)
+		{
+			bin(start, end, buckets);
+			return;
+		}
+
+		std::vector<SAHBucket> chunk_buckets(threads * SAH_BUCKET_COUNT);
+		ParallelChunks(start, end, threads, [&](int chunk, size_t first, size_t last) {
+			bin(first, last, &chunk_buckets[chunk * SAH_BUCKET_COUNT]);
+		});
+		for (int chunk = 0; chunk < threads; ++chunk)
+		{
+			for (int b = 0; b < SAH_BUCKET_COUNT; ++b)
+			{
+				buckets[b].count += chunk_buckets[chunk * SAH_BUCKET_COUNT + b].count;
+				buckets[b].bounds.Grow(chunk_buckets[chunk * SAH_BUCKET_COUNT + b].bounds);
+			}
+		}
+	}
+
+	// append a subtree built into its own array, returns the index of its root
+	uint32_t AppendSubtree(std::vector<LinearBVHNode>& nodes, const std::vector<LinearBVHNode>& subtree)
+	{
+		auto base = static_cast<uint32_t>(nodes.size());
+		for (LinearBVHNode node : subtree)
+		{
+			if (node.primitive_count == 0)
+				node.offset += base;	// second child, leaves index primitives
+			nodes.push_back(node);
+		}
+		return base;
+	}
+
+	// smallest b with 2^b >= n
+	inline int CeilLog2(size_t n)
+	{
+		int b = 0;
+		while ((static_cast<size_t>(1) << b) < n)
+			++b;
+		return b;
+	}
+
+	// depth is that of the new node, the root's is 1
+	uint32_t BuildRecursive(std::vector<BuildPrimitive>& prims, size_t start, size_t end,
+		std::vector<LinearBVHNode>& nodes, int max_leaf_size, int threads, int depth)
+	{
+		auto node_index = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+
+		BuildBox bounds, centroid_bounds;
+		RangeBounds(prims, start, end, threads, bounds, centroid_bounds);
+		nodes[node_index].SetBounds(bounds.ToAABB());
+
+		size_t count = end - start;
+		auto make_leaf = [&]() {
+			nodes[node_index].offset = static_cast<uint32_t>(start);
+			nodes[node_index].primitive_count = static_cast<uint16_t>(count);
+			nodes[node_index].axis = 0;
+			return node_index;
+		};
+
+		if (count == 1)
+			return make_leaf();
+
+		// split along the axis where the centroids spread the most
+		Vec3 extent(centroid_bounds.hi[0] - centroid_bounds.lo[0], centroid_bounds.hi[1] - centroid_bounds.lo[1],
+			centroid_bounds.hi[2] - centroid_bounds.lo[2]);
+		int axis = 0;
+		if (extent.y() > extent[axis]) axis = 1;
+		if (extent.z() > extent[axis]) axis = 2;
+
+		// The sah may split off a few primitives at a time, which nests ever deeper. Once the
+		// depth left is only just enough to halve the range down to single primitives, it is
+		// halved at the median, so no interior node lies deeper than LINEAR_BVH_MAX_DEPTH.
+		const bool halve = depth + CeilLog2(count) - 1 >= LINEAR_BVH_MAX_DEPTH;
+
+		size_t mid = start + count / 2;
+		if (extent[axis] <= 0)
+		{
+			// all centroids coincide, nothing to gain from sah
+			if (static_cast<int>(count) <= max_leaf_size)
+				return make_leaf();
+		}
+		else if (!halve)
+		{
+			// bin the centroids and evaluate the sah at every bucket boundary
+			const double cmin = centroid_bounds.lo[axis];
+			const double scale = SAH_BUCKET_COUNT / extent[axis];
+			auto bucket_of = [&](const BuildPrimitive& p) {
+				int b = static_cast<int>((p.centroid[axis] - cmin) * scale);
+				return b < SAH_BUCKET_COUNT ? b : SAH_BUCKET_COUNT - 1;
+			};
+
+			SAHBucket buckets[SAH_BUCKET_COUNT];
+			BinPrimitives(prims, start, end, threads, bucket_of, buckets);
+
+			// sweep from the right first, then from the left, to get both sides in O(buckets)
+			double right_area[SAH_BUCKET_COUNT];
+			int right_count[SAH_BUCKET_COUNT];
+			SAHBucket acc;
+			for (int b = SAH_BUCKET_COUNT - 1; b > 0; --b)
+			{
+				acc.count += buckets[b].count;
+				acc.bounds.Grow(buckets[b].bounds);
+				right_count[b] = acc.count;
+				right_area[b] = acc.count ? SurfaceArea(acc.bounds) : 0.0;
+			}
+
+			acc = SAHBucket();
+			double min_cost = INF;
+			int min_bucket = 0;
+			for (int b = 0; b < SAH_BUCKET_COUNT - 1; ++b)
+			{
+				acc.count += buckets[b].count;
+				acc.bounds.Grow(buckets[b].bounds);
+				double left_area = acc.count ? SurfaceArea(acc.bounds) : 0.0;
+				double cost = acc.count * left_area + right_count[b + 1] * right_area[b + 1];
+				if (cost < min_cost)
+				{
+					min_cost = cost;
+					min_bucket = b;
+				}
+			}
+
+			min_cost = SAH_TRAVERSAL_COST + min_cost / SurfaceArea(bounds);
+			if (static_cast<int>(count) <= max_leaf_size && min_cost >= static_cast<double>(count))
+				return make_leaf();
+
+			auto it = std::partition(prims.begin() + start, prims.begin() + end,
+				[&](const BuildPrimitive& p) { return bucket_of(p) <= min_bucket; });
+			mid = it - prims.begin();
+		}
+
+		if (halve || mid == start || mid == end)
+		{
+			mid = start + count / 2;
+			std::nth_element(prims.begin() + start, prims.begin() + mid, prims.begin() + end,
+				[axis](const BuildPrimitive& a, const BuildPrimitive& b) { return a.centroid[axis] < b.centroid[axis]; });
+		}
+
+		uint32_t second_child;
+		if (threads > 1 && count >= PARALLEL_BUILD_MIN)
+		{
+			// the halves go into arrays of their own at the same time, then follow this node
+			const int left_threads = threads / 2;
+			std::vector<LinearBVHNode> left_nodes, right_nodes;
+			std::thread left([&]() {
+				left_nodes.reserve(2 * (mid - start));
+				BuildRecursive(prims, start, mid, left_nodes, max_leaf_size, left_threads, depth + 1);
+			});
+			right_nodes.reserve(2 * (end - mid));
+			BuildRecursive(prims, mid, end, right_nodes, max_leaf_size, threads - left_threads, depth + 1);
+			left.join();
+
+			AppendSubtree(nodes, left_nodes);
+			second_child = AppendSubtree(nodes, right_nodes);
+		}
+		else
+		{
+			BuildRecursive(prims, start, mid, nodes, max_leaf_size, 1, depth + 1);
+			second_child = BuildRecursive(prims, mid, end, nodes, max_leaf_size, 1, depth + 1);
+		}
+
+		nodes[node_index].offset = second_child;
+		nodes[node_index].primitive_count = 0;
+		nodes[node_index].axis = static_cast<uint8_t>(axis);
+		return node_index;
+	}
+}
+
+void BuildLinearBVH(const std::vector<AABB>& prim_bounds, std::vector<LinearBVHNode>& nodes,
+	std::vector<uint32_t>& prim_order, int max_leaf_size, int thread_count)
+{
+	nodes.clear();
+	prim_order.clear();
+	if (prim_bounds.empty())
+		return;
+
+	int threads = thread_count > 0 ? thread_count : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	if (prim_bounds.size() < PARALLEL_BUILD_MIN)
+		threads = 1;
+
+	// bounds and centroids are computed once here instead of at every level of the build
+	std::vector<BuildPrimitive> prims(prim_bounds.size());
+	ParallelChunks(0, prims.size(), threads, [&](int, size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i)
+		{
+			prims[i].bounds = prim_bounds[i];
+			prims[i].centroid = 0.5 * (prim_bounds[i].min() + prim_bounds[i].max());
+			prims[i].index = static_cast<uint32_t>(i);
+		}
+	});
+
+	nodes.reserve(2 * prims.size());
+	BuildRecursive(prims, 0, prims.size(), nodes, max_leaf_size, threads, 1);
+	nodes.shrink_to_fit();
+
+	prim_order.resize(prims.size());
+	for (size_t i = 0; i < prims.size(); ++i)
+		prim_order[i] = prims[i].index;
+}
+
+LinearBVH::LinearBVH(const std::vector<shared_ptr<Hittable>>& src_objects)
+{
+	std::vector<AABB> prim_bounds(src_objects.size());
+	for (size_t i = 0; i < src_objects.size(); ++i)
+	{
+		if (!src_objects[i]->BoundingBox(prim_bounds[i]))
+			std::cerr << "No bounding box in LinearBVH constructor.\n";
+	}
+
+	Build(src_objects, prim_bounds);
+}
+
+LinearBVH::LinearBVH(const std::vector<shared_ptr<Hittable>>& src_objects, double time0, double time1)
+{
+	std::vector<AABB> prim_bounds(src_objects.size());
+	for (size_t i = 0; i < src_objects.size(); ++i)
+	{
+		AABB box0, box1;
+		if (!src_objects[i]->MotionBounds(time0, time1, box0, box1))
+			std::cerr << "No bounding box in LinearBVH constructor.\n";
+		prim_bounds[i] = SurroundingBox(box0, box1);
+	}
+
+	Build(src_objects, prim_bounds);
+}
+
+void LinearBVH::Build(const std::vector<shared_ptr<Hittable>>& src_objects, const std::vector<AABB>& prim_bounds)
+{
+	std::vector<uint32_t> prim_order;
+	BuildLinearBVH(prim_bounds, nodes, prim_order);
+
+	primitives.reserve(prim_order.size());
+	for (auto index : prim_order)
+		primitives.push_back(src_objects[index]);
+
+	if (!prim_bounds.empty())
+	{
+		box = prim_bounds[0];
+		for (const auto& b : prim_bounds)
+			box = SurroundingBox(box, b);
+	}
+	build_cost = Cost();
+}
+
+void LinearBVH::Rebuild(double time0, double time1)
+{
+	*this = LinearBVH(primitives, time0, time1);
+}
+
+void LinearBVH::Refit(double time0, double time1)
+{
+	if (nodes.empty())
+		return;
+
+	// nodes are depth first, walking backwards finishes both children before their parent
+	std::vector<AABB> node_boxes(nodes.size());
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		LinearBVHNode& node = nodes[n];
+		AABB node_box;
+		if (node.primitive_count > 0)
+		{
+			for (uint32_t p = node.offset; p < node.offset + node.primitive_count; ++p)
+			{
+				AABB box0, box1;
+				primitives[p]->MotionBounds(time0, time1, box0, box1);
+				AABB prim_box = SurroundingBox(box0, box1);
+				node_box = p == node.offset ? prim_box : SurroundingBox(node_box, prim_box);
+			}
+		}
+		else
+			node_box = SurroundingBox(node_boxes[n + 1], node_boxes[node.offset]);
+
+		node.SetBounds(node_box);
+		node_boxes[n] = node_box;
+	}
+	box = node_boxes[0];
+}
+
+double LinearBVH::Cost() const
+{
+	const Vec3 d = box.max() - box.min();
+	const double root_area = 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+	if (nodes.empty() || !(root_area > 0))
+		return 0;
+
+	// every node is entered with the probability of its area, then either has its
+	// children tested or its primitives
+	double cost = 0;
+	for (const auto& node : nodes)
+		cost += SurfaceArea(node) / root_area * (node.primitive_count > 0 ? node.primitive_count : SAH_TRAVERSAL_COST);
+	return cost;
+}
+
+bool LinearBVH::BoundingBox(AABB& output_box) const
+{
+	if (nodes.empty())
+		return false;
+
+	output_box = box;
+	return true;
+}
+
+bool LinearBVH::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
+{
+	return HitBelow(r, 0, t_min, t_max, rec);
+}
+
+bool LinearBVH::HitBelow(const Ray& r, uint32_t root, double t_min, double& t_max, HitRecord& rec) const
+{
+	return TraverseLinearBVH(nodes.data(), nodes.size(), r, t_min, t_max,
+		[&](uint32_t first, uint32_t count, double& closest) {
+			bool hit_anything = false;
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				if (primitives[i]->Hit(r, t_min, closest, rec))
+				{
+					hit_anything = true;
+					closest = t_max = rec.t;
+				}
+			}
+			return hit_anything;
+		}, root);
+}
+
+bool LinearBVH::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	return OccludedBelow(r, 0, t_min, t_max);
+}
+
+bool LinearBVH::OccludedBelow(const Ray& r, uint32_t root, double t_min, double t_max) const
+{
+	return TraverseLinearBVH<true>(nodes.data(), nodes.size(), r, t_min, t_max,
+		[&](uint32_t first, uint32_t count, double& t_far) {
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				if (primitives[i]->Occluded(r, t_min, t_far))
+					return true;
+			}
+			return false;
+		}, root);
+}
+
+uint32_t LinearBVH::HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	double* t_max, HitRecord* recs) const
+{
+	if (nodes.empty() || mask == 0)
+		return 0;
+
+	// rays pointing into different octants share no near planes, trace them one by one
+	RayBoxData rays[PACKET_SIZE];
+	PacketInterval ia;
+	if (!ia.Set(packet, mask, rays))
+		return Hittable::HitPacket(packet, mask, t_min, t_max, recs);
+
+	const auto t_min_f = static_cast<float>(t_min);
+	float t_max_f[PACKET_SIZE];
+	for (int k = 0; k < packet.size; ++k)
+		t_max_f[k] = static_cast<float>(t_max[k]);
+
+	// one entry per level on the way down plus the two children of the deepest node
+	PacketStackEntry stack[LINEAR_BVH_MAX_DEPTH + 1];
+	int stack_size = 0;
+	stack[stack_size++] = { 0, mask };
+	uint32_t hit_mask = 0;
+
+	while (stack_size > 0)
+	{
+		const PacketStackEntry entry = stack[--stack_size];
+		const LinearBVHNode& node = nodes[entry.index];
+
+		float packet_t_max = -INF;
+		for (int k = 0; k < packet.size; ++k)
+		{
+			if (entry.mask & (1u << k))
+				packet_t_max = std::max(packet_t_max, t_max_f[k]);
+		}
+		float t_near;
+		if (!node.HitInterval(ia, t_min_f, packet_t_max, t_near))
+			continue;
+
+		// rays that already hit something closer than the node drop out of the packet here
+		uint32_t active = 0;
+		int last_ray = -1;
+		for (int k = 0; k < packet.size; ++k)
+		{
+			if ((entry.mask & (1u << k)) && t_max_f[k] >= t_near)
+			{
+				active |= 1u << k;
+				last_ray = k;
+			}
+		}
+		if (active == 0)
+			continue;
+
+		if (node.primitive_count > 0)
+		{
+			// the interval test lets rays through that pass beside the box, the primitives
+			// are only tested for the ones really entering it
+			for (int k = 0; k < packet.size; ++k)
+			{
+				if ((active & (1u << k)) && !node.Hit(rays[k], t_min_f, t_max_f[k]))
+					active &= ~(1u << k);
+			}
+			for (uint32_t i = node.offset; i < node.offset + node.primitive_count && active; ++i)
+			{
+				uint32_t prim_hits = primitives[i]->HitPacket(packet, active, t_min, t_max, recs);
+				hit_mask |= prim_hits;
+				for (int k = 0; k < packet.size; ++k)
+				{
+					if (prim_hits & (1u << k))
+						t_max_f[k] = static_cast<float>(t_max[k]);
+				}
+			}
+			continue;
+		}
+
+		// the packet has diverged down to one ray, finish the subtree without masks
+		if ((active & (active - 1)) == 0)
+		{
+			int k = last_ray;
+			if (HitBelow(packet.rays[k], entry.index, t_min, t_max[k], recs[k]))
+			{
+				hit_mask |= 1u << k;
+				t_max_f[k] = static_cast<float>(t_max[k]);
+			}
+			continue;
+		}
+
+		// the near child is popped first
+		const bool second_near = ia.sign[node.axis] != 0;
+		stack[stack_size++] = { second_near ? entry.index + 1 : node.offset, active };
+		stack[stack_size++] = { second_near ? node.offset : entry.index + 1, active };
+	}
+
+	return hit_mask;
+}
+
+uint32_t LinearBVH::OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	const double* t_max) const
+{
+	if (nodes.empty() || mask == 0)
+		return 0;
+
+	RayBoxData rays[PACKET_SIZE];
+	PacketInterval ia;
+	if (!ia.Set(packet, mask, rays))
+		return Hittable::OccludedPacket(packet, mask, t_min, t_max);
+
+	const auto t_min_f = static_cast<float>(t_min);
+	float t_max_f[PACKET_SIZE];
+	for (int k = 0; k < packet.size; ++k)
+		t_max_f[k] = static_cast<float>(t_max[k]);
+
+	PacketStackEntry stack[LINEAR_BVH_MAX_DEPTH + 1];
+	int stack_size = 0;
+	stack[stack_size++] = { 0, mask };
+	uint32_t blocked = 0;
+
+	while (stack_size > 0)
+	{
+		const PacketStackEntry entry = stack[--stack_size];
+		const LinearBVHNode& node = nodes[entry.index];
+
+		float packet_t_max = -INF;
+		for (int k = 0; k < packet.size; ++k)
+		{
+			if (entry.mask & ~blocked & (1u << k))
+				packet_t_max = std::max(packet_t_max, t_max_f[k]);
+		}
+		float t_near;
+		if (!node.HitInterval(ia, t_min_f, packet_t_max, t_near))
+			continue;
+
+		// rays already blocked, or whose shadow ray ends before the node, drop out here
+		uint32_t active = 0;
+		int last_ray = -1;
+		for (int k = 0; k < packet.size; ++k)
+		{
+			if ((entry.mask & ~blocked & (1u << k)) && t_max_f[k] >= t_near)
+			{
+				active |= 1u << k;
+				last_ray = k;
+			}
+		}
+		if (active == 0)
+			continue;
+
+		if (node.primitive_count > 0)
+		{
+			for (int k = 0; k < packet.size; ++k)
+			{
+				if ((active & (1u << k)) && !node.Hit(rays[k], t_min_f, t_max_f[k]))
+					active &= ~(1u << k);
+			}
+			for (uint32_t i = node.offset; i < node.offset + node.primitive_count && (active & ~blocked); ++i)
+				blocked |= primitives[i]->OccludedPacket(packet, active & ~blocked, t_min, t_max);
+			continue;
+		}
+
+		if ((active & (active - 1)) == 0)
+		{
+			int k = last_ray;
+			if (OccludedBelow(packet.rays[k], entry.index, t_min, t_max[k]))
+				blocked |= 1u << k;
+			continue;
+		}
+
+		const bool second_near = ia.sign[node.axis] != 0;
+		stack[stack_size++] = { second_near ? entry.index + 1 : node.offset, active };
+		stack[stack_size++] = { second_near ? node.offset : entry.index + 1, active };
+	}
+
+	return blocked;
+}
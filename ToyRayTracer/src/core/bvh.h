@@ -1,5 +1,7 @@
 #pragma once
 #include <algorithm>
+#include <cstdint>
+#include <vector>
 
 #include "./math.h"
 #include "./hittable.h"
@@ -44,6 +46,7 @@ public:
 		size_t start, size_t end, double time0, double time1);
 
 	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
 
 	virtual bool BoundingBox(AABB& output_box) const override;
 
@@ -53,3 +56,242 @@ public:
 	AABB box;
 };
 
+
+// per ray data for the float box tests, computed once per traversal instead of once per box
+struct RayBoxData
+{
+	RayBoxData() {}
+	RayBoxData(const Ray& r);
+
+	float origin[3];
+	float inv_dir[3];
+	int sign[3];	// 1 where the direction is negative, selects the near slab plane
+};
+
+// far distances of the float box tests are scaled up by a few ulps so rounding never
+// drops a box the ray actually touches
+const float BOX_FAR_SCALE = 1.0f + 4 * std::numeric_limits<float>::epsilon();
+
+// Bounds of the origins and reciprocal directions of a packet, only built when all its
+// rays have the same direction signs, so the near and far planes agree for every ray.
+// A box the interval misses is missed by every ray of the packet.
+struct PacketInterval
+{
+	// Fill rays with the RayBoxData of the packet rays in mask and bound them. false when
+	// the rays point into different octants, which share no near planes
+	bool Set(const RayPacket& packet, uint32_t mask, RayBoxData* rays);
+
+	// distances between which some ray of the packet may be inside the slab of axis a
+	inline void Slab(int a, float near_plane, float far_plane, float& t0, float& t1) const
+	{
+		t0 = MulMin(near_plane - origin_max[a], near_plane - origin_min[a], inv_min[a], inv_max[a]);
+		t1 = MulMax(far_plane - origin_max[a], far_plane - origin_min[a], inv_min[a], inv_max[a]);
+	}
+
+	float origin_min[3];
+	float origin_max[3];
+	float inv_min[3];
+	float inv_max[3];
+	int sign[3];
+
+private:
+	static float MulMin(float a0, float a1, float b0, float b1)
+	{
+		return std::min(std::min(a0 * b0, a0 * b1), std::min(a1 * b0, a1 * b1));
+	}
+
+	static float MulMax(float a0, float a1, float b0, float b1)
+	{
+		return std::max(std::max(a0 * b0, a0 * b1), std::max(a1 * b0, a1 * b1));
+	}
+};
+
+// 32 byte node of the flattened bvh, nodes are laid out depth first so the first child
+// of an interior node is always the next node in the array
+struct LinearBVHNode
+{
+	float bounds_min[3];
+	float bounds_max[3];
+	uint32_t offset;			// leaf: first primitive index, interior: second child index
+	uint16_t primitive_count;	// 0 for interior nodes
+	uint8_t axis;				// split axis, decides which child is visited first
+	uint8_t pad;
+
+	void SetBounds(const AABB& box);
+
+	// slab test with the reciprocal of the ray direction computed once per ray
+	inline bool Hit(const Point3& o, const Vec3& inv_dir, double t_min, double t_max) const
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			auto t0 = (bounds_min[a] - o.e[a]) * inv_dir.e[a];
+			auto t1 = (bounds_max[a] - o.e[a]) * inv_dir.e[a];
+			if (inv_dir.e[a] < 0.0)
+				std::swap(t0, t1);
+
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+			if (t_max < t_min)
+				return false;
+		}
+		return true;
+	}
+
+	// the same slab test in float, as the packet traversal has the rays
+	inline bool Hit(const RayBoxData& ray, float t_min, float t_max) const
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			float t0 = ((ray.sign[a] ? bounds_max[a] : bounds_min[a]) - ray.origin[a]) * ray.inv_dir[a];
+			float t1 = ((ray.sign[a] ? bounds_min[a] : bounds_max[a]) - ray.origin[a]) * ray.inv_dir[a];
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+		}
+		return t_min <= t_max * BOX_FAR_SCALE;
+	}
+
+	// conservative test against every ray of a packet at once, false when all of them miss.
+	// t_near bounds the distance at which they enter
+	inline bool HitInterval(const PacketInterval& ia, float t_min, float t_max, float& t_near) const
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			float t0, t1;
+			ia.Slab(a, ia.sign[a] ? bounds_max[a] : bounds_min[a], ia.sign[a] ? bounds_min[a] : bounds_max[a], t0, t1);
+			t_min = t0 > t_min ? t0 : t_min;
+			t_max = t1 < t_max ? t1 : t_max;
+		}
+		t_near = t_min;
+		return t_min <= t_max * BOX_FAR_SCALE;
+	}
+};
+
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should fit in half a cache line");
+
+// Build a binned SAH bvh over the primitive bounds. nodes are written depth first and
+// prim_order lists the primitive indices in the order the leaves reference them.
+// Large inputs are built on thread_count threads (0 uses every hardware thread): the
+// biggest ranges are binned in parallel and the two halves of the top levels are built at
+// the same time. The tree is the same whatever the thread count.
+void BuildLinearBVH(const std::vector<AABB>& prim_bounds, std::vector<LinearBVHNode>& nodes,
+	std::vector<uint32_t>& prim_order, int max_leaf_size = 4, int thread_count = 0);
+
+// deepest interior node TraverseLinearBVH has stack room for, the root is at depth 1.
+// BuildLinearBVH never builds deeper, it splits at the median when it gets close.
+const int LINEAR_BVH_MAX_DEPTH = 64;
+
+// Iterative traversal of a flattened bvh, nearer child first.
+// hit_leaf(first, count, t_max) tests a primitive range and returns true if it found a
+// closer hit, in which case it must also shrink t_max (passed by reference) to that hit.
+// With ANY_HIT the traversal stops at the first leaf that reports a hit. Only the subtree
+// below node root is visited.
+template<bool ANY_HIT = false, typename LeafFunc>
+bool TraverseLinearBVH(const LinearBVHNode* nodes, size_t node_count, const Ray& r,
+	double t_min, double t_max, LeafFunc hit_leaf, uint32_t root = 0)
+{
+	if (node_count == 0)
+		return false;
+
+	const Point3 o = r.Origin();
+	const Vec3 d = r.Direction();
+	const Vec3 inv_dir(1.0 / d.x(), 1.0 / d.y(), 1.0 / d.z());
+	const bool dir_is_neg[3] = { inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0 };
+
+	bool hit_anything = false;
+	uint32_t to_visit[LINEAR_BVH_MAX_DEPTH];
+	int to_visit_count = 0;
+	uint32_t current = root;
+
+	while (true)
+	{
+		const LinearBVHNode& node = nodes[current];
+		if (node.Hit(o, inv_dir, t_min, t_max))
+		{
+			if (node.primitive_count > 0)
+			{
+				if (hit_leaf(node.offset, node.primitive_count, t_max))
+				{
+					if (ANY_HIT)
+						return true;
+					hit_anything = true;
+				}
+			}
+			else
+			{
+				// push the far child and descend into the near one
+				if (dir_is_neg[node.axis])
+				{
+					to_visit[to_visit_count++] = current + 1;
+					current = node.offset;
+				}
+				else
+				{
+					to_visit[to_visit_count++] = node.offset;
+					current = current + 1;
+				}
+				continue;
+			}
+		}
+
+		if (to_visit_count == 0)
+			break;
+		current = to_visit[--to_visit_count];
+	}
+
+	return hit_anything;
+}
+
+template<bool ANY_HIT = false, typename LeafFunc>
+bool TraverseLinearBVH(const std::vector<LinearBVHNode>& nodes, const Ray& r,
+	double t_min, double t_max, LeafFunc hit_leaf)
+{
+	return TraverseLinearBVH<ANY_HIT>(nodes.data(), nodes.size(), r, t_min, t_max, hit_leaf);
+}
+
+// Flattened bvh over arbitrary hittables, a drop-in replacement for BVHNode
+class LinearBVH : public Hittable
+{
+public:
+	LinearBVH() {}
+	LinearBVH(const HittableList& list) : LinearBVH(list.objects) {}
+	LinearBVH(const std::vector<shared_ptr<Hittable>>& src_objects);
+
+	// built over the boxes the objects sweep between time0 and time1 instead of their
+	// bounding boxes, which hold every time an animated object can be at
+	LinearBVH(const std::vector<shared_ptr<Hittable>>& src_objects, double time0, double time1);
+
+	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
+	virtual bool BoundingBox(AABB& output_box) const override;
+
+	// packet traversal like WideBVH's: each node is tested against the whole packet with
+	// one interval test, rays leave the packet once they hit something closer than a node,
+	// and a subtree only one ray still reaches is finished with the single ray traversal
+	virtual uint32_t HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		double* t_max, HitRecord* recs) const override;
+	virtual uint32_t OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		const double* t_max) const override;
+
+	// recompute the boxes bottom up after primitives have moved, the tree stays the same.
+	// the boxes hold the primitives from time0 to time1, which are equal without motion blur
+	void Refit(double time0, double time1);
+
+	// build the tree again over the same primitives where they are from time0 to time1
+	void Rebuild(double time0, double time1);
+
+	// sah cost of the tree relative to its root box, like WideBVH::Cost
+	double Cost() const;
+
+public:
+	std::vector<shared_ptr<Hittable>> primitives;	// in leaf order
+	std::vector<LinearBVHNode> nodes;
+	AABB box;
+	double build_cost = 0;
+
+private:
+	void Build(const std::vector<shared_ptr<Hittable>>& src_objects, const std::vector<AABB>& prim_bounds);
+
+	// single ray traversals of the subtree below node root
+	bool HitBelow(const Ray& r, uint32_t root, double t_min, double& t_max, HitRecord& rec) const;
+	bool OccludedBelow(const Ray& r, uint32_t root, double t_min, double t_max) const;
+};
@@ -0,0 +1,412 @@
+#include "./bvh_motion.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+	const double SAH_TRAVERSAL_COST = 0.125;	// relative to one primitive intersection, as in BuildLinearBVH
+
+	struct StackEntry
+	{
+		uint32_t index;
+		uint16_t count;		// > 0 for a primitive range
+		float t_near;
+	};
+
+	double SurfaceArea(const AABB& box)
+	{
+		Vec3 d = box.max() - box.min();
+		return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+	}
+
+	template<int N>
+	bool IsEmptySlot(const MotionBVHNode<N>& node, int i)
+	{
+		// the root is nobody's child, so child 0 without primitives is an empty slot
+		return node.count[i] == 0 && node.child[i] == 0;
+	}
+
+	// Store the planes of child i, moved outwards by a few ulps so the planes interpolated
+	// in float during traversal still hold the boxes between time0 and time1
+	template<int N>
+	void SetChildBounds(MotionBVHNode<N>& node, int i, const AABB& box0, const AABB& box1)
+	{
+		const float down = -std::numeric_limits<float>::infinity();
+		const float up = std::numeric_limits<float>::infinity();
+		for (int a = 0; a < 3; a++)
+		{
+			double pad = 4 * FLT_EPSILON * std::max(std::max(std::fabs(box0.min()[a]), std::fabs(box1.min()[a])),
+				std::max(std::fabs(box0.max()[a]), std::fabs(box1.max()[a])));
+			float lo = std::nextafter(static_cast<float>(box0.min()[a] - pad), down);
+			float hi = std::nextafter(static_cast<float>(box0.max()[a] + pad), up);
+			node.bounds[0][a][i] = lo;
+			node.bounds[1][a][i] = hi;
+			node.motion[0][a][i] = std::nextafter(static_cast<float>(box1.min()[a] - pad - lo), down);
+			node.motion[1][a][i] = std::nextafter(static_cast<float>(box1.max()[a] + pad - hi), up);
+		}
+	}
+
+	template<int N>
+	void SetEmptySlot(MotionBVHNode<N>& node, int i)
+	{
+		// an inverted box no ray can enter, finite so moving it along gives no nan
+		for (int a = 0; a < 3; a++)
+		{
+			node.bounds[0][a][i] = FLT_MAX;
+			node.bounds[1][a][i] = -FLT_MAX;
+			node.motion[0][a][i] = node.motion[1][a][i] = 0;
+		}
+		node.child[i] = 0;
+		node.count[i] = 0;
+	}
+
+	template<int N>
+	double ChildArea(const MotionBVHNode<N>& node, int i, float s)
+	{
+		double d[3];
+		for (int a = 0; a < 3; a++)
+			d[a] = (node.bounds[1][a][i] + s * node.motion[1][a][i]) - (node.bounds[0][a][i] + s * node.motion[0][a][i]);
+		return 2 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+	}
+
+	template<int N>
+	int IntersectChildrenScalar(const MotionBVHNode<N>& node, const RayBoxData& ray, float s,
+		float t_min, float t_max, float* t_near)
+	{
+		int mask = 0;
+		for (int i = 0; i < N; i++)
+		{
+			float tn = t_min;
+			float tf = t_max;
+			for (int a = 0; a < 3; a++)
+			{
+				const int near_side = ray.sign[a];
+				const int far_side = 1 - ray.sign[a];
+				float near_plane = node.bounds[near_side][a][i] + s * node.motion[near_side][a][i];
+				float far_plane = node.bounds[far_side][a][i] + s * node.motion[far_side][a][i];
+				float t0 = (near_plane - ray.origin[a]) * ray.inv_dir[a];
+				float t1 = (far_plane - ray.origin[a]) * ray.inv_dir[a];
+				tn = t0 > tn ? t0 : tn;
+				tf = t1 < tf ? t1 : tf;
+			}
+			t_near[i] = tn;
+			if (tn <= tf * BOX_FAR_SCALE)
+				mask |= 1 << i;
+		}
+		return mask;
+	}
+
+#if TOYRT_X86
+	int IntersectChildrenSSE(const MotionBVHNode<4>& node, const RayBoxData& ray, float s,
+		float t_min, float t_max, float* t_near)
+	{
+		const __m128 time = _mm_set1_ps(s);
+		__m128 tn = _mm_set1_ps(t_min);
+		__m128 tf = _mm_set1_ps(t_max);
+		for (int a = 0; a < 3; a++)
+		{
+			const int near_side = ray.sign[a];
+			const int far_side = 1 - ray.sign[a];
+			const __m128 o = _mm_set1_ps(ray.origin[a]);
+			const __m128 inv = _mm_set1_ps(ray.inv_dir[a]);
+			__m128 near_plane = _mm_add_ps(_mm_loadu_ps(node.bounds[near_side][a]), _mm_mul_ps(time, _mm_loadu_ps(node.motion[near_side][a])));
+			__m128 far_plane = _mm_add_ps(_mm_loadu_ps(node.bounds[far_side][a]), _mm_mul_ps(time, _mm_loadu_ps(node.motion[far_side][a])));
+			__m128 t0 = _mm_mul_ps(_mm_sub_ps(near_plane, o), inv);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(far_plane, o), inv);
+			// max/min return the second operand for NaN, which keeps the running interval
+			tn = _mm_max_ps(t0, tn);
+			tf = _mm_min_ps(t1, tf);
+		}
+		tf = _mm_mul_ps(tf, _mm_set1_ps(BOX_FAR_SCALE));
+		_mm_storeu_ps(t_near, tn);
+		return _mm_movemask_ps(_mm_cmple_ps(tn, tf));
+	}
+
+	TOYRT_TARGET_AVX2
+	int IntersectChildrenAVX2(const MotionBVHNode<8>& node, const RayBoxData& ray, float s,
+		float t_min, float t_max, float* t_near)
+	{
+		const __m256 time = _mm256_set1_ps(s);
+		__m256 tn = _mm256_set1_ps(t_min);
+		__m256 tf = _mm256_set1_ps(t_max);
+		for (int a = 0; a < 3; a++)
+		{
+			const int near_side = ray.sign[a];
+			const int far_side = 1 - ray.sign[a];
+			const __m256 o = _mm256_set1_ps(ray.origin[a]);
+			const __m256 inv = _mm256_set1_ps(ray.inv_dir[a]);
+			__m256 near_plane = _mm256_add_ps(_mm256_loadu_ps(node.bounds[near_side][a]), _mm256_mul_ps(time, _mm256_loadu_ps(node.motion[near_side][a])));
+			__m256 far_plane = _mm256_add_ps(_mm256_loadu_ps(node.bounds[far_side][a]), _mm256_mul_ps(time, _mm256_loadu_ps(node.motion[far_side][a])));
+			__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(near_plane, o), inv);
+			__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(far_plane, o), inv);
+			tn = _mm256_max_ps(t0, tn);
+			tf = _mm256_min_ps(t1, tf);
+		}
+		tf = _mm256_mul_ps(tf, _mm256_set1_ps(BOX_FAR_SCALE));
+		_mm256_storeu_ps(t_near, tn);
+		return _mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ));
+	}
+#endif
+
+	int IntersectChildren(const MotionBVHNode<4>& node, SimdLevel simd, const RayBoxData& ray, float s,
+		float t_min, float t_max, float* t_near)
+	{
+#if TOYRT_X86
+		if (simd != SimdLevel::Scalar)
+			return IntersectChildrenSSE(node, ray, s, t_min, t_max, t_near);
+#endif
+		return IntersectChildrenScalar(node, ray, s, t_min, t_max, t_near);
+	}
+
+	int IntersectChildren(const MotionBVHNode<8>& node, SimdLevel simd, const RayBoxData& ray, float s,
+		float t_min, float t_max, float* t_near)
+	{
+#if TOYRT_X86
+		if (simd == SimdLevel::AVX2)
+			return IntersectChildrenAVX2(node, ray, s, t_min, t_max, t_near);
+#endif
+		return IntersectChildrenScalar(node, ray, s, t_min, t_max, t_near);
+	}
+}
+
+// ---MotionBVH---
+
+template<int N>
+MotionBVH<N>::MotionBVH(const std::vector<shared_ptr<Hittable>>& src_objects, double time0, double time1)
+	: primitives(src_objects), simd(DetectSimdLevel())
+{
+	Rebuild(time0, time1);
+}
+
+template<int N>
+void MotionBVH<N>::Rebuild(double time0, double time1)
+{
+	// the topology of the wide bvh over the swept boxes, the bounds come from the refit
+	WideBVH<N> wide(LinearBVH(primitives, time0, time1), simd);
+	primitives.swap(wide.primitives);
+
+	nodes.assign(wide.nodes.size(), MotionBVHNode<N>());
+	for (size_t n = 0; n < nodes.size(); ++n)
+	{
+		for (int i = 0; i < N; i++)
+		{
+			nodes[n].child[i] = wide.nodes[n].child[i];
+			nodes[n].count[i] = wide.nodes[n].count[i];
+		}
+	}
+
+	Refit(time0, time1);
+	build_cost = Cost();
+}
+
+template<int N>
+void MotionBVH<N>::Refit(double time0, double time1)
+{
+	start_time = time0;
+	end_time = time1;
+	if (nodes.empty())
+		return;
+
+	// children come after the node that holds them, so walking backwards finishes every
+	// child first
+	std::vector<AABB> boxes0(nodes.size()), boxes1(nodes.size());
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		MotionBVHNode<N>& node = nodes[n];
+		bool has_box = false;
+		for (int i = 0; i < N; i++)
+		{
+			AABB child0, child1;
+			if (node.count[i] > 0)
+			{
+				for (uint32_t p = node.child[i]; p < node.child[i] + node.count[i]; ++p)
+				{
+					AABB box0, box1;
+					primitives[p]->MotionBounds(time0, time1, box0, box1);
+					child0 = p == node.child[i] ? box0 : SurroundingBox(child0, box0);
+					child1 = p == node.child[i] ? box1 : SurroundingBox(child1, box1);
+				}
+			}
+			else if (!IsEmptySlot(node, i))
+			{
+				child0 = boxes0[node.child[i]];
+				child1 = boxes1[node.child[i]];
+			}
+			else
+			{
+				SetEmptySlot(node, i);
+				continue;
+			}
+
+			SetChildBounds(node, i, child0, child1);
+			boxes0[n] = has_box ? SurroundingBox(boxes0[n], child0) : child0;
+			boxes1[n] = has_box ? SurroundingBox(boxes1[n], child1) : child1;
+			has_box = true;
+		}
+	}
+	start_box = boxes0[0];
+	end_box = boxes1[0];
+}
+
+template<int N>
+double MotionBVH<N>::Cost() const
+{
+	double root_area = SurfaceArea(start_box) + SurfaceArea(end_box);
+	if (nodes.empty() || !(root_area > 0))
+		return 0;
+
+	// every ray visits the root, and each child it reaches is either tested as a whole
+	// (a node) or has its primitives tested
+	double cost = SAH_TRAVERSAL_COST;
+	for (const auto& node : nodes)
+	{
+		for (int i = 0; i < N; i++)
+		{
+			if (IsEmptySlot(node, i))
+				continue;
+			double area = ChildArea(node, i, 0) + ChildArea(node, i, 1);
+			cost += area / root_area * (node.count[i] > 0 ? node.count[i] : SAH_TRAVERSAL_COST);
+		}
+	}
+	return cost;
+}
+
+template<int N>
+bool MotionBVH<N>::BoundingBox(AABB& output_box) const
+{
+	if (nodes.empty())
+		return false;
+
+	output_box = SurroundingBox(start_box, end_box);
+	return true;
+}
+
+template<int N>
+bool MotionBVH<N>::MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const
+{
+	if (time0 != start_time || time1 != end_time)
+		return Hittable::MotionBounds(time0, time1, box0, box1);
+	if (nodes.empty())
+		return false;
+
+	box0 = start_box;
+	box1 = end_box;
+	return true;
+}
+
+template<int N>
+bool MotionBVH<N>::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
+{
+	if (nodes.empty())
+		return false;
+
+	// how far into the interval the ray is, rays outside it see the boxes at its ends
+	const float s = end_time > start_time
+		? static_cast<float>(Clamp((r.Time() - start_time) / (end_time - start_time), 0.0, 1.0)) : 0.0f;
+	const RayBoxData ray(r);
+	const auto t_min_f = static_cast<float>(t_min);
+	auto t_max_f = static_cast<float>(t_max);
+	bool hit_anything = false;
+
+	StackEntry stack[64 * N];
+	int stack_size = 0;
+	stack[stack_size++] = { 0, 0, t_min_f };
+
+	while (stack_size > 0)
+	{
+		const StackEntry entry = stack[--stack_size];
+		if (entry.t_near > t_max_f)
+			continue;	// a closer hit was found after this entry was pushed
+
+		if (entry.count > 0)
+		{
+			for (uint32_t i = entry.index; i < entry.index + entry.count; ++i)
+			{
+				if (primitives[i]->Hit(r, t_min, t_max, rec))
+				{
+					hit_anything = true;
+					t_max = rec.t;
+					t_max_f = static_cast<float>(t_max);
+				}
+			}
+			continue;
+		}
+
+		const MotionBVHNode<N>& node = nodes[entry.index];
+		float t_near[N];
+		int mask = IntersectChildren(node, simd, ray, s, t_min_f, t_max_f, t_near);
+
+		// push the hit children far to near, so the nearest one is popped first
+		int first = stack_size;
+		for (int i = 0; i < N; i++)
+		{
+			if (!(mask & (1 << i)))
+				continue;
+
+			StackEntry child = { node.child[i], node.count[i], t_near[i] };
+			int j = stack_size++;
+			while (j > first && stack[j - 1].t_near < child.t_near)
+			{
+				stack[j] = stack[j - 1];
+				--j;
+			}
+			stack[j] = child;
+		}
+	}
+
+	return hit_anything;
+}
+
+template<int N>
+bool MotionBVH<N>::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	if (nodes.empty())
+		return false;
+
+	const float s = end_time > start_time
+		? static_cast<float>(Clamp((r.Time() - start_time) / (end_time - start_time), 0.0, 1.0)) : 0.0f;
+	const RayBoxData ray(r);
+	const auto t_min_f = static_cast<float>(t_min);
+	const auto t_max_f = static_cast<float>(t_max);
+
+	// any hit ends the search, so the children are visited in whatever order they come
+	StackEntry stack[64 * N];
+	int stack_size = 0;
+	stack[stack_size++] = { 0, 0, t_min_f };
+
+	while (stack_size > 0)
+	{
+		const StackEntry entry = stack[--stack_size];
+		if (entry.count > 0)
+		{
+			for (uint32_t i = entry.index; i < entry.index + entry.count; ++i)
+			{
+				if (primitives[i]->Occluded(r, t_min, t_max))
+					return true;
+			}
+			continue;
+		}
+
+		const MotionBVHNode<N>& node = nodes[entry.index];
+		float t_near[N];
+		int mask = IntersectChildren(node, simd, ray, s, t_min_f, t_max_f, t_near);
+		for (int i = 0; i < N; i++)
+		{
+			if (mask & (1 << i))
+				stack[stack_size++] = { node.child[i], node.count[i], t_near[i] };
+		}
+	}
+
+	return false;
+}
+
+template class MotionBVH<4>;
+template class MotionBVH<8>;
+
+shared_ptr<Hittable> MakeMotionBVH(const std::vector<shared_ptr<Hittable>>& objects, double time0, double time1)
+{
+	if (DetectSimdLevel() == SimdLevel::AVX2)
+		return make_shared<MotionBVH<8>>(objects, time0, time1);
+	return make_shared<MotionBVH<4>>(objects, time0, time1);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "./math.h"
+#include "./hittable.h"
+#include "./bvh_wide.h"
+
+// Node of a 4 or 8 wide bvh over moving objects, laid out like WideBVHNode. Every child
+// box is stored where it starts (time0 of the interval the bvh is fit to) and how far its
+// planes move by time1, a ray tests the boxes moved on to its own time, which stay tight
+// while the children move.
+template<int N>
+struct MotionBVHNode
+{
+	float bounds[2][3][N];	// [min/max][axis][child] at time0
+	float motion[2][3][N];	// change of bounds from time0 to time1
+	uint32_t child[N];		// interior child: node index, leaf child: first primitive
+	uint16_t count[N];		// primitive count of leaf children, 0 for interior and empty slots
+};
+
+// Bvh with linear motion bounds (see Hittable::MotionBounds) for the shutter interval
+// time0 to time1. The tree is the same as a WideBVH<N> built over the boxes the objects
+// sweep in that interval, but a ray only tests the boxes at its time where the wide bvh
+// would make it test the whole sweep.
+template<int N>
+class MotionBVH : public Hittable
+{
+public:
+	MotionBVH(const std::vector<shared_ptr<Hittable>>& src_objects, double time0, double time1);
+
+	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
+	virtual bool BoundingBox(AABB& output_box) const override;
+
+	// the bounds of the root when asked for the interval the bvh is fit to, its swept box otherwise
+	virtual bool MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const override;
+
+	// fit the bounds to a new interval after the primitives have moved, the tree stays the same
+	void Refit(double time0, double time1);
+
+	// build the tree again over the same primitives where they are from time0 to time1
+	void Rebuild(double time0, double time1);
+
+	// sah cost of the tree relative to its root box, averaged over both ends of the interval
+	double Cost() const;
+
+public:
+	std::vector<shared_ptr<Hittable>> primitives;	// in leaf order
+	std::vector<MotionBVHNode<N>> nodes;
+	double start_time, end_time;	// the interval the bounds are fit to
+	AABB start_box, end_box;		// of the root
+	SimdLevel simd;
+	double build_cost;
+};
+
+// Build the motion bvh layout matching the cpu: 8 wide with avx2, 4 wide elsewhere
+shared_ptr<Hittable> MakeMotionBVH(const std::vector<shared_ptr<Hittable>>& objects, double time0, double time1);
@@ -0,0 +1,588 @@
+#include "./bvh_wide.h"
+
+namespace
+{
+	template<int N>
+	int IntersectChildrenScalar(const WideBVHNode<N>& node, const RayBoxData& ray,
+		float t_min, float t_max, float* t_near)
+	{
+		int mask = 0;
+		for (int i = 0; i < N; i++)
+		{
+			float tn = t_min;
+			float tf = t_max;
+			for (int a = 0; a < 3; a++)
+			{
+				float t0 = (node.bounds[ray.sign[a]][a][i] - ray.origin[a]) * ray.inv_dir[a];
+				float t1 = (node.bounds[1 - ray.sign[a]][a][i] - ray.origin[a]) * ray.inv_dir[a];
+				tn = t0 > tn ? t0 : tn;
+				tf = t1 < tf ? t1 : tf;
+			}
+			t_near[i] = tn;
+			if (tn <= tf * BOX_FAR_SCALE)
+				mask |= 1 << i;
+		}
+		return mask;
+	}
+
+#if TOYRT_X86
+	int IntersectChildrenSSE(const WideBVHNode<4>& node, const RayBoxData& ray,
+		float t_min, float t_max, float* t_near)
+	{
+		__m128 tn = _mm_set1_ps(t_min);
+		__m128 tf = _mm_set1_ps(t_max);
+		for (int a = 0; a < 3; a++)
+		{
+			const __m128 o = _mm_set1_ps(ray.origin[a]);
+			const __m128 inv = _mm_set1_ps(ray.inv_dir[a]);
+			__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[ray.sign[a]][a]), o), inv);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[1 - ray.sign[a]][a]), o), inv);
+			// max/min return the second operand for NaN, which keeps the running interval
+			tn = _mm_max_ps(t0, tn);
+			tf = _mm_min_ps(t1, tf);
+		}
+		tf = _mm_mul_ps(tf, _mm_set1_ps(BOX_FAR_SCALE));
+		_mm_storeu_ps(t_near, tn);
+		return _mm_movemask_ps(_mm_cmple_ps(tn, tf));
+	}
+
+	TOYRT_TARGET_AVX2
+	int IntersectChildrenAVX2(const WideBVHNode<8>& node, const RayBoxData& ray,
+		float t_min, float t_max, float* t_near)
+	{
+		__m256 tn = _mm256_set1_ps(t_min);
+		__m256 tf = _mm256_set1_ps(t_max);
+		for (int a = 0; a < 3; a++)
+		{
+			const __m256 o = _mm256_set1_ps(ray.origin[a]);
+			const __m256 inv = _mm256_set1_ps(ray.inv_dir[a]);
+			__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[ray.sign[a]][a]), o), inv);
+			__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[1 - ray.sign[a]][a]), o), inv);
+			tn = _mm256_max_ps(t0, tn);
+			tf = _mm256_min_ps(t1, tf);
+		}
+		tf = _mm256_mul_ps(tf, _mm256_set1_ps(BOX_FAR_SCALE));
+		_mm256_storeu_ps(t_near, tn);
+		return _mm256_movemask_ps(_mm256_cmp_ps(tn, tf, _CMP_LE_OQ));
+	}
+#endif
+}
+
+int IntersectChildren(const WideBVHNode<4>& node, SimdLevel simd, const RayBoxData& ray,
+	float t_min, float t_max, float* t_near)
+{
+#if TOYRT_X86
+	if (simd != SimdLevel::Scalar)
+		return IntersectChildrenSSE(node, ray, t_min, t_max, t_near);
+#endif
+	return IntersectChildrenScalar(node, ray, t_min, t_max, t_near);
+}
+
+int IntersectChildren(const WideBVHNode<8>& node, SimdLevel simd, const RayBoxData& ray,
+	float t_min, float t_max, float* t_near)
+{
+#if TOYRT_X86
+	if (simd == SimdLevel::AVX2)
+		return IntersectChildrenAVX2(node, ray, t_min, t_max, t_near);
+#endif
+	return IntersectChildrenScalar(node, ray, t_min, t_max, t_near);
+}
+
+namespace
+{
+	// conservative test of all children against every ray of the packet at once, a child
+	// that fails here is missed by all of them
+	template<int N>
+	int IntersectChildrenInterval(const WideBVHNode<N>& node, const PacketInterval& ia,
+		float t_min, float t_max, float* t_near)
+	{
+		int mask = 0;
+		for (int i = 0; i < N; i++)
+		{
+			float tn = t_min;
+			float tf = t_max;
+			for (int a = 0; a < 3; a++)
+			{
+				float t0, t1;
+				ia.Slab(a, node.bounds[ia.sign[a]][a][i], node.bounds[1 - ia.sign[a]][a][i], t0, t1);
+				tn = t0 > tn ? t0 : tn;
+				tf = t1 < tf ? t1 : tf;
+			}
+			t_near[i] = tn;
+			if (tn <= tf * BOX_FAR_SCALE)
+				mask |= 1 << i;
+		}
+		return mask;
+	}
+
+	const double SAH_TRAVERSAL_COST = 0.125;	// relative to one primitive intersection, as in BuildLinearBVH
+
+	template<int N>
+	double ChildArea(const WideBVHNode<N>& node, int i)
+	{
+		double dx = node.bounds[1][0][i] - node.bounds[0][0][i];
+		double dy = node.bounds[1][1][i] - node.bounds[0][1][i];
+		double dz = node.bounds[1][2][i] - node.bounds[0][2][i];
+		return 2 * (dx * dy + dy * dz + dz * dx);
+	}
+
+	// rounded outwards like LinearBVHNode::SetBounds
+	template<int N>
+	void SetChildBounds(WideBVHNode<N>& node, int i, const AABB& box)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			node.bounds[0][a][i] = std::nextafter(static_cast<float>(box.min()[a]), -std::numeric_limits<float>::infinity());
+			node.bounds[1][a][i] = std::nextafter(static_cast<float>(box.max()[a]), std::numeric_limits<float>::infinity());
+		}
+	}
+
+	double SurfaceArea(const AABB& box)
+	{
+		Vec3 d = box.max() - box.min();
+		return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+	}
+
+	double SurfaceArea(const LinearBVHNode& node)
+	{
+		double dx = node.bounds_max[0] - node.bounds_min[0];
+		double dy = node.bounds_max[1] - node.bounds_min[1];
+		double dz = node.bounds_max[2] - node.bounds_min[2];
+		return 2 * (dx * dy + dy * dz + dz * dx);
+	}
+
+	struct PacketStackEntry
+	{
+		uint32_t index;
+		uint16_t count;		// > 0 for a primitive range
+		uint32_t mask;		// rays of the packet that reach this entry
+		float t_near;		// lower bound of the entry distance of those rays
+	};
+}
+
+template<int N>
+uint32_t CollapseBVH(const std::vector<LinearBVHNode>& binary, uint32_t index, std::vector<WideBVHNode<N>>& nodes)
+{
+	// gather the children, the root may itself be a leaf
+	uint32_t kids[N];
+	int kid_count = 0;
+	if (binary[index].primitive_count > 0)
+		kids[kid_count++] = index;
+	else
+	{
+		kids[kid_count++] = index + 1;
+		kids[kid_count++] = binary[index].offset;
+	}
+
+	// open the largest interior child until the node is full
+	while (kid_count < N)
+	{
+		int largest = -1;
+		double largest_area = -1;
+		for (int i = 0; i < kid_count; i++)
+		{
+			const auto& kid = binary[kids[i]];
+			if (kid.primitive_count == 0 && SurfaceArea(kid) > largest_area)
+			{
+				largest = i;
+				largest_area = SurfaceArea(kid);
+			}
+		}
+		if (largest < 0)
+			break;
+
+		uint32_t opened = kids[largest];
+		kids[largest] = opened + 1;
+		kids[kid_count++] = binary[opened].offset;
+	}
+
+	auto node_index = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+	for (int i = 0; i < N; i++)
+	{
+		// empty slots get an inverted box no ray can enter
+		for (int a = 0; a < 3; a++)
+		{
+			nodes[node_index].bounds[0][a][i] = i < kid_count ? binary[kids[i]].bounds_min[a] : INF;
+			nodes[node_index].bounds[1][a][i] = i < kid_count ? binary[kids[i]].bounds_max[a] : -INF;
+		}
+		nodes[node_index].child[i] = i < kid_count ? binary[kids[i]].offset : 0;
+		nodes[node_index].count[i] = i < kid_count ? binary[kids[i]].primitive_count : 0;
+	}
+
+	for (int i = 0; i < kid_count; i++)
+	{
+		if (binary[kids[i]].primitive_count == 0)
+		{
+			uint32_t child = CollapseBVH(binary, kids[i], nodes);
+			nodes[node_index].child[i] = child;
+		}
+	}
+
+	return node_index;
+}
+
+template uint32_t CollapseBVH(const std::vector<LinearBVHNode>&, uint32_t, std::vector<WideBVHNode<4>>&);
+template uint32_t CollapseBVH(const std::vector<LinearBVHNode>&, uint32_t, std::vector<WideBVHNode<8>>&);
+
+// ---WideBVH---
+
+template<int N>
+WideBVH<N>::WideBVH(const LinearBVH& bvh, SimdLevel simd_level)
+	: simd(simd_level)
+{
+	Build(bvh);
+}
+
+template<int N>
+void WideBVH<N>::Build(const LinearBVH& bvh)
+{
+	primitives = bvh.primitives;
+	box = bvh.box;
+	nodes.clear();
+	if (!bvh.nodes.empty())
+	{
+		nodes.reserve(bvh.nodes.size() / 2 + 1);
+		CollapseBVH(bvh.nodes, 0, nodes);
+	}
+	build_cost = Cost();
+}
+
+template<int N>
+void WideBVH<N>::Rebuild(double time0, double time1)
+{
+	Build(LinearBVH(primitives, time0, time1));
+}
+
+template<int N>
+void WideBVH<N>::Refit(double time0, double time1)
+{
+	if (nodes.empty())
+		return;
+
+	// Collapse places children after their parent, so walking backwards finishes every
+	// child before the node that holds it
+	std::vector<AABB> node_boxes(nodes.size());
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		WideBVHNode<N>& node = nodes[n];
+		bool has_box = false;
+		for (int i = 0; i < N; i++)
+		{
+			AABB child_box;
+			if (node.count[i] > 0)
+			{
+				for (uint32_t p = node.child[i]; p < node.child[i] + node.count[i]; ++p)
+				{
+					AABB box0, box1;
+					primitives[p]->MotionBounds(time0, time1, box0, box1);
+					AABB prim_box = SurroundingBox(box0, box1);
+					child_box = p == node.child[i] ? prim_box : SurroundingBox(child_box, prim_box);
+				}
+			}
+			else if (node.bounds[0][0][i] <= node.bounds[1][0][i])
+				child_box = node_boxes[node.child[i]];
+			else
+				continue;	// empty slot
+
+			SetChildBounds(node, i, child_box);
+			node_boxes[n] = has_box ? SurroundingBox(node_boxes[n], child_box) : child_box;
+			has_box = true;
+		}
+	}
+	box = node_boxes[0];
+}
+
+template<int N>
+double WideBVH<N>::Cost() const
+{
+	double root_area = SurfaceArea(box);
+	if (nodes.empty() || !(root_area > 0))
+		return 0;
+
+	// every child box is entered with the probability of its area, then either visited
+	// (a node) or has its primitives tested
+	double cost = SAH_TRAVERSAL_COST;
+	for (const auto& node : nodes)
+	{
+		for (int i = 0; i < N; i++)
+		{
+			if (node.bounds[0][0][i] > node.bounds[1][0][i])
+				continue;
+			double area = ChildArea(node, i);
+			cost += area / root_area * (node.count[i] > 0 ? node.count[i] : SAH_TRAVERSAL_COST);
+		}
+	}
+	return cost;
+}
+
+template<int N>
+bool WideBVH<N>::BoundingBox(AABB& output_box) const
+{
+	if (nodes.empty())
+		return false;
+
+	output_box = box;
+	return true;
+}
+
+template<int N>
+bool WideBVH<N>::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
+{
+	if (nodes.empty())
+		return false;
+
+	return Traverse(r, RayBoxData(r), 0, t_min, t_max, rec);
+}
+
+template<int N>
+bool WideBVH<N>::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	if (nodes.empty())
+		return false;
+
+	return OccludedBelow(r, RayBoxData(r), 0, t_min, t_max);
+}
+
+template<int N>
+bool WideBVH<N>::OccludedBelow(const Ray& r, const RayBoxData& ray, uint32_t root,
+	double t_min, double t_max) const
+{
+	return TraverseWideBVH<N, true>(nodes.data(), simd, ray, root, t_min, t_max,
+		[&](uint32_t first, uint32_t count, double&) {
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				if (primitives[i]->Occluded(r, t_min, t_max))
+					return true;
+			}
+			return false;
+		});
+}
+
+template<int N>
+bool WideBVH<N>::Traverse(const Ray& r, const RayBoxData& ray, uint32_t root,
+	double t_min, double& t_max, HitRecord& rec) const
+{
+	return TraverseWideBVH<N>(nodes.data(), simd, ray, root, t_min, t_max,
+		[&](uint32_t first, uint32_t count, double& closest) {
+			bool hit_leaf = false;
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				if (primitives[i]->Hit(r, t_min, closest, rec))
+				{
+					hit_leaf = true;
+					closest = t_max = rec.t;
+				}
+			}
+			return hit_leaf;
+		});
+}
+
+template<int N>
+uint32_t WideBVH<N>::HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	double* t_max, HitRecord* recs) const
+{
+	if (nodes.empty() || mask == 0)
+		return 0;
+
+	RayBoxData rays[PACKET_SIZE];
+	PacketInterval ia;
+	const bool coherent = ia.Set(packet, mask, rays);
+
+	const auto t_min_f = static_cast<float>(t_min);
+	float t_max_f[PACKET_SIZE];
+	uint32_t hit_mask = 0;
+
+	// rays pointing into different octants share no near planes, trace them one by one
+	if (!coherent)
+	{
+		for (int k = 0; k < packet.size; ++k)
+		{
+			if ((mask & (1u << k)) && Traverse(packet.rays[k], rays[k], 0, t_min, t_max[k], recs[k]))
+				hit_mask |= 1u << k;
+		}
+		return hit_mask;
+	}
+
+	for (int k = 0; k < packet.size; ++k)
+		t_max_f[k] = static_cast<float>(t_max[k]);
+
+	PacketStackEntry stack[64 * N];
+	int stack_size = 0;
+	stack[stack_size++] = { 0, 0, mask, t_min_f };
+
+	while (stack_size > 0)
+	{
+		const PacketStackEntry entry = stack[--stack_size];
+
+		// t_near bounds the entry distance of every ray, so rays that already hit something
+		// closer drop out of the packet here
+		uint32_t active = 0;
+		float packet_t_max = -INF;
+		int last_ray = -1;
+		for (int k = 0; k < packet.size; ++k)
+		{
+			if ((entry.mask & (1u << k)) && t_max_f[k] >= entry.t_near)
+			{
+				active |= 1u << k;
+				packet_t_max = std::max(packet_t_max, t_max_f[k]);
+				last_ray = k;
+			}
+		}
+		if (active == 0)
+			continue;
+
+		if (entry.count > 0)
+		{
+			for (uint32_t i = entry.index; i < entry.index + entry.count; ++i)
+			{
+				uint32_t prim_hits = primitives[i]->HitPacket(packet, active, t_min, t_max, recs);
+				hit_mask |= prim_hits;
+				for (int k = 0; k < packet.size; ++k)
+				{
+					if (prim_hits & (1u << k))
+						t_max_f[k] = static_cast<float>(t_max[k]);
+				}
+			}
+			continue;
+		}
+
+		// the packet has diverged down to one ray, finish the subtree without masks
+		if ((active & (active - 1)) == 0)
+		{
+			int k = last_ray;
+			if (Traverse(packet.rays[k], rays[k], entry.index, t_min, t_max[k], recs[k]))
+			{
+				hit_mask |= 1u << k;
+				t_max_f[k] = static_cast<float>(t_max[k]);
+			}
+			continue;
+		}
+
+		// one interval test for the whole packet, children that pass it are visited by all
+		// active rays and the exact per ray tests happen in the primitives
+		const WideBVHNode<N>& node = nodes[entry.index];
+		float t_near[N];
+		int mask_children = IntersectChildrenInterval(node, ia, t_min_f, packet_t_max, t_near);
+
+		// push the reached children far to near
+		int first = stack_size;
+		for (int i = 0; i < N; i++)
+		{
+			if (!(mask_children & (1 << i)))
+				continue;
+
+			PacketStackEntry child = { node.child[i], node.count[i], active, t_near[i] };
+			int j = stack_size++;
+			while (j > first && stack[j - 1].t_near < child.t_near)
+			{
+				stack[j] = stack[j - 1];
+				--j;
+			}
+			stack[j] = child;
+		}
+	}
+
+	return hit_mask;
+}
+
+template<int N>
+uint32_t WideBVH<N>::OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	const double* t_max) const
+{
+	if (nodes.empty() || mask == 0)
+		return 0;
+
+	RayBoxData rays[PACKET_SIZE];
+	PacketInterval ia;
+	uint32_t blocked = 0;
+	if (!ia.Set(packet, mask, rays))
+	{
+		for (int k = 0; k < packet.size; ++k)
+		{
+			if ((mask & (1u << k)) && OccludedBelow(packet.rays[k], rays[k], 0, t_min, t_max[k]))
+				blocked |= 1u << k;
+		}
+		return blocked;
+	}
+
+	const auto t_min_f = static_cast<float>(t_min);
+	float t_max_f[PACKET_SIZE];
+	for (int k = 0; k < packet.size; ++k)
+		t_max_f[k] = static_cast<float>(t_max[k]);
+
+	PacketStackEntry stack[64 * N];
+	int stack_size = 0;
+	stack[stack_size++] = { 0, 0, mask, t_min_f };
+
+	while (stack_size > 0)
+	{
+		const PacketStackEntry entry = stack[--stack_size];
+
+		// rays already blocked, or whose shadow ray ends before the entry, drop out here
+		uint32_t active = 0;
+		float packet_t_max = -INF;
+		int last_ray = -1;
+		for (int k = 0; k < packet.size; ++k)
+		{
+			if ((entry.mask & ~blocked & (1u << k)) && t_max_f[k] >= entry.t_near)
+			{
+				active |= 1u << k;
+				packet_t_max = std::max(packet_t_max, t_max_f[k]);
+				last_ray = k;
+			}
+		}
+		if (active == 0)
+			continue;
+
+		if (entry.count > 0)
+		{
+			for (uint32_t i = entry.index; i < entry.index + entry.count && (active & ~blocked); ++i)
+				blocked |= primitives[i]->OccludedPacket(packet, active & ~blocked, t_min, t_max);
+			continue;
+		}
+
+		if ((active & (active - 1)) == 0)
+		{
+			int k = last_ray;
+			if (OccludedBelow(packet.rays[k], rays[k], entry.index, t_min, t_max[k]))
+				blocked |= 1u << k;
+			continue;
+		}
+
+		const WideBVHNode<N>& node = nodes[entry.index];
+		float t_near[N];
+		int mask_children = IntersectChildrenInterval(node, ia, t_min_f, packet_t_max, t_near);
+
+		// near children are popped first, they are the likeliest to block
+		int first = stack_size;
+		for (int i = 0; i < N; i++)
+		{
+			if (!(mask_children & (1 << i)))
+				continue;
+
+			PacketStackEntry child = { node.child[i], node.count[i], active, t_near[i] };
+			int j = stack_size++;
+			while (j > first && stack[j - 1].t_near < child.t_near)
+			{
+				stack[j] = stack[j - 1];
+				--j;
+			}
+			stack[j] = child;
+		}
+	}
+
+	return blocked;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
+
+shared_ptr<Hittable> MakeBVH(const std::vector<shared_ptr<Hittable>>& objects)
+{
+	auto bvh = make_shared<LinearBVH>(objects);
+	SimdLevel level = DetectSimdLevel();
+	if (level == SimdLevel::AVX2)
+		return make_shared<WideBVH<8>>(*bvh, level);
+	return bvh;
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "./math.h"
+#include "./hittable.h"
+#include "./bvh.h"
+#include "./simd.h"
+
+// node of a 4 or 8 wide bvh. the child boxes are stored structure of arrays, so a single
+// simd instruction works on the same slab plane of every child
+template<int N>
+struct WideBVHNode
+{
+	float bounds[2][3][N];	// [min/max][axis][child]
+	uint32_t child[N];		// interior child: node index, leaf child: first primitive
+	uint16_t count[N];		// primitive count of leaf children, 0 for interior and empty slots
+};
+
+// Box tests of the N children of node, bit i of the result is set when the ray enters
+// child i between t_min and t_max, which it does at t_near[i]. simd picks the sse or
+// avx2 version where the cpu has them.
+int IntersectChildren(const WideBVHNode<4>& node, SimdLevel simd, const RayBoxData& ray,
+	float t_min, float t_max, float* t_near);
+int IntersectChildren(const WideBVHNode<8>& node, SimdLevel simd, const RayBoxData& ray,
+	float t_min, float t_max, float* t_near);
+
+// Append the binary bvh below binary[index] to nodes as N wide nodes, opening the largest
+// children until each node has N of them. Leaf children keep the primitive ranges of the
+// binary leaves. Returns the index of the new node, children come after their parent.
+template<int N>
+uint32_t CollapseBVH(const std::vector<LinearBVHNode>& binary, uint32_t index, std::vector<WideBVHNode<N>>& nodes);
+
+// Single ray traversal of an N wide bvh from node root, nearer children first, like
+// TraverseLinearBVH: hit_leaf(first, count, t_max) tests a primitive range and returns
+// true if it found a closer hit, shrinking t_max to it. With ANY_HIT the traversal stops
+// at the first leaf that reports a hit and takes the children in any order.
+template<int N, bool ANY_HIT = false, typename LeafFunc>
+bool TraverseWideBVH(const WideBVHNode<N>* nodes, SimdLevel simd, const RayBoxData& ray, uint32_t root,
+	double t_min, double t_max, LeafFunc hit_leaf)
+{
+	struct StackEntry
+	{
+		uint32_t index;
+		uint16_t count;		// > 0 for a primitive range
+		float t_near;
+	};
+
+	const auto t_min_f = static_cast<float>(t_min);
+	auto t_max_f = static_cast<float>(t_max);
+	bool hit_anything = false;
+
+	StackEntry stack[64 * N];
+	int stack_size = 0;
+	stack[stack_size++] = { root, 0, t_min_f };
+
+	while (stack_size > 0)
+	{
+		const StackEntry entry = stack[--stack_size];
+		if (entry.t_near > t_max_f)
+			continue;	// a closer hit was found after this entry was pushed
+
+		if (entry.count > 0)
+		{
+			if (hit_leaf(entry.index, entry.count, t_max))
+			{
+				if (ANY_HIT)
+					return true;
+				hit_anything = true;
+				t_max_f = static_cast<float>(t_max);
+			}
+			continue;
+		}
+
+		const WideBVHNode<N>& node = nodes[entry.index];
+		float t_near[N];
+		int mask = IntersectChildren(node, simd, ray, t_min_f, t_max_f, t_near);
+
+		// push the hit children far to near, so the nearest one is popped first
+		int first = stack_size;
+		for (int i = 0; i < N; i++)
+		{
+			if (!(mask & (1 << i)))
+				continue;
+
+			const StackEntry child = { node.child[i], node.count[i], t_near[i] };
+			int j = stack_size++;
+			while (!ANY_HIT && j > first && stack[j - 1].t_near < child.t_near)
+			{
+				stack[j] = stack[j - 1];
+				--j;
+			}
+			stack[j] = child;
+		}
+	}
+
+	return hit_anything;
+}
+
+template<int N>
+class WideBVH : public Hittable
+{
+public:
+	// collapse a binary bvh, opening the largest children until each node has N of them
+	WideBVH(const LinearBVH& bvh, SimdLevel simd_level);
+
+	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
+	virtual bool BoundingBox(AABB& output_box) const override;
+
+	// packet traversal: the children of a node are tested against the whole packet with one
+	// interval test, rays leave the packet once they hit something closer than a node, and
+	// a subtree only one ray still reaches is finished with the single ray traversal.
+	// packets whose rays point into different octants are traced ray by ray
+	virtual uint32_t HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		double* t_max, HitRecord* recs) const override;
+
+	// the same packet traversal for shadow rays, a ray leaves the packet once it is blocked
+	virtual uint32_t OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		const double* t_max) const override;
+
+	// recompute the boxes bottom up after primitives have moved, the tree stays the same.
+	// the boxes hold the primitives from time0 to time1, which are equal without motion blur
+	void Refit(double time0, double time1);
+
+	// build the tree again over the same primitives where they are from time0 to time1
+	void Rebuild(double time0, double time1);
+
+	// sah cost of the tree relative to its root box, a refit tree gets worse than the
+	// build_cost it started with as its primitives move apart
+	double Cost() const;
+
+public:
+	std::vector<shared_ptr<Hittable>> primitives;
+	std::vector<WideBVHNode<N>> nodes;
+	AABB box;
+	SimdLevel simd;
+	double build_cost;
+
+private:
+	void Build(const LinearBVH& bvh);
+
+	// single ray traversal of the subtree below node root
+	bool Traverse(const Ray& r, const RayBoxData& ray, uint32_t root,
+		double t_min, double& t_max, HitRecord& rec) const;
+
+	// single ray any hit traversal of the subtree below node root
+	bool OccludedBelow(const Ray& r, const RayBoxData& ray, uint32_t root,
+		double t_min, double t_max) const;
+};
+
+// Build the bvh layout that traces fastest on the cpu: 8 wide with avx2, and the binary
+// LinearBVH elsewhere, which 4 wide nodes don't beat with sse or scalar box tests. Both
+// trace packets with the same interval test.
+shared_ptr<Hittable> MakeBVH(const std::vector<shared_ptr<Hittable>>& objects);
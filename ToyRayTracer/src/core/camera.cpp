@@ -3,7 +3,10 @@
 Camera::Camera(Point3 lookfrom, Point3 lookat, Vec3 vup, double vfov,
 	double aspect_ratio,
 	double aperture,
-	double focus_dist)
+	double focus_dist,
+	double shutter_open,
+	double shutter_close)
+	: time0(shutter_open), time1(shutter_close)
 {
 	auto theta = DegreesToRadians(vfov);
 	auto h = tan(theta / 2);
@@ -25,5 +28,6 @@ Ray Camera::GetRay(double s, double t) const
 {
 	Vec3 rd = lens_radius * RandomInUnitDisk();
 	Vec3 offset = u * rd.x() + v * rd.y();
-	return Ray(origin + offset,lower_left_corner + s * horizontal + t * vertical - origin - offset);
+	double time = time1 > time0 ? RandomDouble(time0, time1) : time0;
+	return Ray(origin + offset,lower_left_corner + s * horizontal + t * vertical - origin - offset, time);
 }
\ No newline at end of file
@@ -7,7 +7,9 @@ class Camera
 public:
 	// vertical field-of-view in degrees
 	// only the sphere on the focus plane is clear
-	Camera(Point3 lookfrom, Point3 lookat, Vec3 vup, double vfov,double aspect_ratio,double aperture,double focus_dist);
+	// rays get a random time (in frames) while the shutter is open
+	Camera(Point3 lookfrom, Point3 lookat, Vec3 vup, double vfov,double aspect_ratio,double aperture,double focus_dist,
+		double shutter_open = 0, double shutter_close = 0);
 	Ray GetRay(double s, double t) const;
 
 private:
@@ -17,4 +19,5 @@ private:
 	Vec3 vertical;
 	Vec3 u, v, w;
 	double lens_radius;
+	double time0, time1;
 };
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "./film.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	inline double Luminance(double r, double g, double b)
+	{
+		return 0.2126 * r + 0.7152 * g + 0.0722 * b;
+	}
+
+	// below this luminance the slope of sqrt stops growing, black pixels would never converge
+	const double MIN_ERROR_LUMINANCE = 1e-3;
+}
+
+// ---Film---
+
+Film::Film(int w, int h) : width(w), height(h), pixels(static_cast<size_t>(w) * h)
+{
+	for (auto& p : pixels)
+	{
+		p.color[0] = p.color[1] = p.color[2] = 0.0f;
+		p.lum_sum = p.lum_sq_sum = 0.0f;
+		p.samples = p.batches = 0;
+		p.converged = false;
+	}
+}
+
+void Film::AddBatch(int x, int row, const Color& sum, int count)
+{
+	FilmPixel& p = pixels[row * width + x];
+	p.color[0] += static_cast<float>(sum.x());
+	p.color[1] += static_cast<float>(sum.y());
+	p.color[2] += static_cast<float>(sum.z());
+
+	double lum = Luminance(sum.x(), sum.y(), sum.z()) / count;
+	p.lum_sum += static_cast<float>(lum);
+	p.lum_sq_sum += static_cast<float>(lum * lum);
+	p.samples += count;
+	p.batches++;
+}
+
+Color Film::Value(int x, int row) const
+{
+	const FilmPixel& p = At(x, row);
+	if (p.samples == 0)
+		return Color(0, 0, 0);
+	double scale = 1.0 / p.samples;
+	return Color(p.color[0] * scale, p.color[1] * scale, p.color[2] * scale);
+}
+
+double Film::SampleDeviation(const FilmPixel& p) const
+{
+	double n = p.batches;
+	double mean = p.lum_sum / n;
+	double variance = std::max(0.0, (p.lum_sq_sum / n - mean * mean) * n / (n - 1));
+
+	// a batch mean averages samples/batches samples, scale back to a single sample, then
+	// through the slope of the gamma curve, d sqrt(l) = dl / (2 sqrt(l))
+	double deviation = std::sqrt(variance * p.samples / n);
+	return deviation / (2 * std::sqrt(std::max(mean, MIN_ERROR_LUMINANCE)));
+}
+
+double Film::Error(int x, int row) const
+{
+	const FilmPixel& p = At(x, row);
+	if (p.batches < 2)
+		return INF;
+	return SampleDeviation(p) / std::sqrt(static_cast<double>(p.samples));
+}
+
+int Film::UpdateConvergence(double threshold, int min_samples)
+{
+	std::vector<double> errors(pixels.size());
+	for (int row = 0; row < height; ++row)
+		for (int x = 0; x < width; ++x)
+			errors[row * width + x] = Error(x, row);
+
+	int active = 0;
+	for (int row = 0; row < height; ++row)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			FilmPixel& p = pixels[row * width + x];
+			if (!p.converged && p.samples >= static_cast<uint32_t>(min_samples))
+			{
+				double worst = 0.0;
+				for (int y = std::max(row - 1, 0); y <= std::min(row + 1, height - 1); ++y)
+					for (int n = std::max(x - 1, 0); n <= std::min(x + 1, width - 1); ++n)
+					{
+						// a NaN error never passes
+						double e = errors[y * width + n];
+						worst = e != e ? INF : std::max(worst, e);
+					}
+				p.converged = worst <= threshold;
+			}
+			active += p.converged ? 0 : 1;
+		}
+	}
+	return active;
+}
+
+uint64_t Film::TotalSamples() const
+{
+	uint64_t total = 0;
+	for (const auto& p : pixels)
+		total += p.samples;
+	return total;
+}
+
+double Film::UniformEqualErrorSpp() const
+{
+	// mean error of the film is sum(d_i / sqrt(n_i)) / count, with the same n everywhere it
+	// is sum(d_i) / count / sqrt(n), solve for n
+	double deviation_sum = 0.0;
+	double error_sum = 0.0;
+	for (const auto& p : pixels)
+	{
+		if (p.batches < 2)
+			continue;
+		double d = SampleDeviation(p);
+		if (d != d)
+			continue;
+		deviation_sum += d;
+		error_sum += d / std::sqrt(static_cast<double>(p.samples));
+	}
+	if (error_sum <= 0.0)
+		return 0.0;
+	double ratio = deviation_sum / error_sum;
+	return ratio * ratio;
+}
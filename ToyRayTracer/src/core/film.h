@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "./math.h"
+
+// one pixel of the film, float is plenty for sums of a few thousand samples
+struct FilmPixel
+{
+	float color[3];		// sum of the samples
+	float lum_sum;		// sum of the luminance of the batch means
+	float lum_sq_sum;	// sum of its square
+	uint32_t samples;
+	uint32_t batches;
+	bool converged;
+};
+
+// Float framebuffer for progressive rendering. Samples arrive in batches (a packet of
+// camera rays), the spread of the batch means gives an estimate of how far each pixel
+// still is from its converged value, so sampling can stop where the image is clean.
+// Pixels are stored row by row with row 0 at the top of the image.
+class Film
+{
+public:
+	Film(int width, int height);
+
+	// add sum, the sum of count samples of pixel (x, row)
+	void AddBatch(int x, int row, const Color& sum, int count);
+
+	// mean of the samples so far, black if there are none
+	Color Value(int x, int row) const;
+	int Samples(int x, int row) const { return At(x, row).samples; }
+
+	// Estimated standard error of the pixel after gamma correction (sqrt), so a threshold
+	// means the same visible noise in dark and bright areas. INF until two batches are in.
+	double Error(int x, int row) const;
+
+	// Stop the pixels with at least min_samples whose error, and that of their 8 neighbours,
+	// is below threshold. The variance of a few batches misses rare bright paths, looking at
+	// the neighbours keeps a pixel sampling until its whole surroundings agree it is clean.
+	// Call between passes, returns the pixels still sampling.
+	int UpdateConvergence(double threshold, int min_samples);
+	bool IsConverged(int x, int row) const { return At(x, row).converged; }
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+	uint64_t TotalSamples() const;
+
+	// Samples per pixel uniform sampling would need for the same mean error as the film,
+	// estimated from the per pixel variances (the error of a pixel falls as 1/sqrt(n)).
+	double UniformEqualErrorSpp() const;
+
+private:
+	const FilmPixel& At(int x, int row) const { return pixels[row * width + x]; }
+
+	// standard deviation of one sample of the pixel, after gamma correction
+	double SampleDeviation(const FilmPixel& p) const;
+
+private:
+	int width;
+	int height;
+	std::vector<FilmPixel> pixels;
+};
@@ -3,6 +3,118 @@
 #include "./ray.h"
 #include "./aabb.h"
 
+namespace
+{
+	bool SurroundMotionBounds(bool has_box, const AABB& a0, const AABB& a1, AABB& box0, AABB& box1)
+	{
+		box0 = has_box ? SurroundingBox(box0, a0) : a0;
+		box1 = has_box ? SurroundingBox(box1, a1) : a1;
+		return true;
+	}
+
+	// box of the 8 corners of box turned about the y axis
+	AABB RotateBox(const AABB& box, double sin_theta, double cos_theta)
+	{
+		Point3 min(INF, INF, INF);
+		Point3 max(-INF, -INF, -INF);
+
+		// aabb8㣬ת֮aabb
+		for (int i = 0; i < 2; i++) 
+		{
+			for (int j = 0; j < 2; j++) 
+			{
+				for (int k = 0; k < 2; k++)
+				{
+					auto x = i * box.max().x() + (1 - i)*box.min().x();
+					auto y = j * box.max().y() + (1 - j)*box.min().y();
+					auto z = k * box.max().z() + (1 - k)*box.min().z();
+
+					auto newx = cos_theta * x + sin_theta * z;
+					auto newz = -sin_theta * x + cos_theta * z;
+
+					Vec3 tester(newx, y, newz);
+
+					for (int c = 0; c < 3; c++) 
+					{
+						min[c] = fmin(min[c], tester[c]);
+						max[c] = fmax(max[c], tester[c]);
+					}
+				}
+			}
+		}
+
+		return AABB(min, max);
+	}
+
+	// box swept by box turning from angle0 to angle1 (degrees): every corner moves on an
+	// arc, which reaches its extremes at the ends or where it runs parallel to an axis
+	AABB SweepBox(const AABB& box, double angle0, double angle1)
+	{
+		const double theta0 = DegreesToRadians(angle0);
+		const double theta1 = DegreesToRadians(angle1);
+		AABB swept = RotateBox(box, sin(theta0), cos(theta0));
+		swept = SurroundingBox(swept, RotateBox(box, sin(theta1), cos(theta1)));
+
+		for (int i = 0; i < 2; i++)
+		{
+			for (int k = 0; k < 2; k++)
+			{
+				double x = i ? box.max().x() : box.min().x();
+				double z = k ? box.max().z() : box.min().z();
+				const double turns[2] = { atan2(z, x), atan2(-x, z) };
+				for (double turn : turns)
+				{
+					// every half turn from the critical angle is critical too
+					double theta = turn + PI * ceil((theta0 - turn) / PI);
+					for (; theta <= theta1; theta += PI)
+					{
+						double s = sin(theta), c = cos(theta);
+						Point3 lo(c * x + s * z, box.min().y(), -s * x + c * z);
+						Point3 hi(lo.x(), box.max().y(), lo.z());
+						swept = SurroundingBox(swept, AABB(lo, hi));
+					}
+				}
+			}
+		}
+		return swept;
+	}
+}
+
+// ---Hittable---
+
+bool Hittable::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	HitRecord rec;
+	return Hit(r, t_min, t_max, rec);
+}
+
+uint32_t Hittable::HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	double* t_max, HitRecord* recs) const
+{
+	uint32_t hit_mask = 0;
+	for (int k = 0; k < packet.size; ++k)
+	{
+		if ((mask & (1u << k)) && Hit(packet.rays[k], t_min, t_max[k], recs[k]))
+		{
+			t_max[k] = recs[k].t;
+			hit_mask |= 1u << k;
+		}
+	}
+	return hit_mask;
+}
+
+uint32_t Hittable::OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	const double* t_max) const
+{
+	uint32_t blocked = 0;
+	for (int k = 0; k < packet.size; ++k)
+	{
+		if ((mask & (1u << k)) && Occluded(packet.rays[k], t_min, t_max[k]))
+			blocked |= 1u << k;
+	}
+	return blocked;
+}
+
 // ---HittableList---
 
 bool HittableList::Hit(const Ray& r, double tMin, double tMax, HitRecord& rec) const
@@ -24,6 +136,42 @@ bool HittableList::Hit(const Ray& r, double tMin, double tMax, HitRecord& rec) c
 	return is_hit_anything;
 }
 
+bool HittableList::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	for (const auto& object : objects)
+	{
+		if (object->Occluded(r, t_min, t_max))
+			return true;
+	}
+
+	return false;
+}
+
+uint32_t HittableList::HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	double* t_max, HitRecord* recs) const
+{
+	uint32_t hit_mask = 0;
+	for (const auto& object : objects)
+		hit_mask |= object->HitPacket(packet, mask, t_min, t_max, recs);
+
+	return hit_mask;
+}
+
+uint32_t HittableList::OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	const double* t_max) const
+{
+	// a blocked ray has nothing left to look for in the other objects
+	uint32_t blocked = 0;
+	for (const auto& object : objects)
+	{
+		blocked |= object->OccludedPacket(packet, mask & ~blocked, t_min, t_max);
+		if ((mask & ~blocked) == 0)
+			break;
+	}
+
+	return blocked;
+}
+
 bool HittableList::BoundingBox(AABB& output_box) const
 {
 	if (objects.empty()) return false;
@@ -42,6 +190,21 @@ bool HittableList::BoundingBox(AABB& output_box) const
 	return true;
 }
 
+bool HittableList::MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const
+{
+	if (objects.empty()) return false;
+
+	bool has_box = false;
+	for (const auto& object : objects)
+	{
+		AABB a0, a1;
+		if (!object->MotionBounds(time0, time1, a0, a1)) return false;
+		has_box = SurroundMotionBounds(has_box, a0, a1, box0, box1);
+	}
+
+	return true;
+}
+
 double HittableList::PDFValue(const Point3& o, const Vec3& v) const
 {
 	auto weight = 1.0 / objects.size();
@@ -59,82 +222,173 @@ Vec3 HittableList::Random(const Vec3& o) const
 	return objects[RandomInt(0, int_size - 1)]->Random(o);
 }
 
+double HittableList::Area() const
+{
+	double area = 0;
+	for (const auto& object : objects)
+		area += object->Area();
+	return area;
+}
+
 // ---Translate---
 bool Translate::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
 {
 	// ĳƶԴӹߵĽǶȿǣѹߵĳ෴ķƶЧһģֻ
 	// ײҪoffsetپҪȫ
-	Ray moved_r(r.Origin() - offset, r.Direction());
+	const Vec3 moved_by = motion.Empty() ? offset : motion.At(r.Time());
+	Ray moved_r(r.Origin() - moved_by, r.Direction(), r.Time());
 	if (!ptr->Hit(moved_r, t_min, t_max, rec))
 		return false;
 
-	rec.p += offset;
+	rec.p += moved_by;
 	rec.SetFaceNormal(moved_r, rec.normal);
 
 	return true;
 }
 
+bool Translate::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	const Vec3 moved_by = motion.Empty() ? offset : motion.At(r.Time());
+	return ptr->Occluded(Ray(r.Origin() - moved_by, r.Direction(), r.Time()), t_min, t_max);
+}
+
+uint32_t Translate::HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	double* t_max, HitRecord* recs) const
+{
+	RayPacket moved;
+	Vec3 moved_by[PACKET_SIZE];
+	moved.size = packet.size;
+	for (int k = 0; k < packet.size; ++k)
+	{
+		moved_by[k] = motion.Empty() ? offset : motion.At(packet.rays[k].Time());
+		moved.rays[k] = Ray(packet.rays[k].Origin() - moved_by[k], packet.rays[k].Direction(), packet.rays[k].Time());
+	}
+
+	uint32_t hit_mask = ptr->HitPacket(moved, mask, t_min, t_max, recs);
+	for (int k = 0; k < packet.size; ++k)
+	{
+		if (hit_mask & (1u << k))
+		{
+			recs[k].p += moved_by[k];
+			recs[k].SetFaceNormal(moved.rays[k], recs[k].normal);
+		}
+	}
+
+	return hit_mask;
+}
+
+uint32_t Translate::OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	const double* t_max) const
+{
+	RayPacket moved;
+	moved.size = packet.size;
+	for (int k = 0; k < packet.size; ++k)
+	{
+		const Vec3 moved_by = motion.Empty() ? offset : motion.At(packet.rays[k].Time());
+		moved.rays[k] = Ray(packet.rays[k].Origin() - moved_by, packet.rays[k].Direction(), packet.rays[k].Time());
+	}
+
+	return ptr->OccludedPacket(moved, mask, t_min, t_max);
+}
+
 bool Translate::BoundingBox(AABB& output_box) const {
 	if (!ptr->BoundingBox(output_box))
 		return false;
 
-	output_box = AABB(output_box.min() + offset, output_box.max() + offset);
+	if (motion.Empty())
+	{
+		output_box = AABB(output_box.min() + offset, output_box.max() + offset);
+		return true;
+	}
+
+	// the offsets are held outside the keys, so the keys bound all of them
+	Vec3 lo, hi;
+	motion.Range(motion.times.front(), motion.times.back(), lo, hi);
+	output_box = AABB(output_box.min() + lo, output_box.max() + hi);
+	return true;
+}
+
+bool Translate::MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const
+{
+	if (!ptr->MotionBounds(time0, time1, box0, box1))
+		return false;
+
+	Vec3 lo0 = offset, lo1 = offset, hi0 = offset, hi1 = offset;
+	if (!motion.Empty())
+		motion.LinearBounds(time0, time1, lo0, lo1, hi0, hi1);
+	box0 = AABB(box0.min() + lo0, box0.max() + hi0);
+	box1 = AABB(box1.min() + lo1, box1.max() + hi1);
 	return true;
 }
 
 // ---RotateY---
 
 RotateY::RotateY(shared_ptr<Hittable> p, double angle) : ptr(p) 
+{
+	SetAngle(angle);
+}
+
+void RotateY::SetAngle(double angle)
 {
 	auto radians = DegreesToRadians(angle);
 	sin_theta = sin(radians);
 	cos_theta = cos(radians);
-	hasbox = ptr->BoundingBox(bbox);
-
-	Point3 min(INF, INF, INF);
-	Point3 max(-INF, -INF, -INF);
+	UpdateBox();
+}
 
-	// aabb8㣬ת֮aabb
-	for (int i = 0; i < 2; i++) 
+void RotateY::UpdateBox()
+{
+	hasbox = ptr->BoundingBox(bbox);
+	if (motion.Empty())
+		bbox = RotateBox(bbox, sin_theta, cos_theta);
+	else
 	{
-		for (int j = 0; j < 2; j++) 
-		{
-			for (int k = 0; k < 2; k++)
-			{
-				auto x = i * bbox.max().x() + (1 - i)*bbox.min().x();
-				auto y = j * bbox.max().y() + (1 - j)*bbox.min().y();
-				auto z = k * bbox.max().z() + (1 - k)*bbox.min().z();
-
-				auto newx = cos_theta * x + sin_theta * z;
-				auto newz = -sin_theta * x + cos_theta * z;
+		double lo, hi;
+		motion.Range(motion.times.front(), motion.times.back(), lo, hi);
+		bbox = SweepBox(bbox, lo, hi);
+	}
+}
 
-				Vec3 tester(newx, y, newz);
+bool RotateY::MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const
+{
+	if (!ptr->MotionBounds(time0, time1, box0, box1))
+		return false;
 
-				for (int c = 0; c < 3; c++) 
-				{
-					min[c] = fmin(min[c], tester[c]);
-					max[c] = fmax(max[c], tester[c]);
-				}
-			}
-		}
+	// turning isn't linear, a turning object gets the box it sweeps at both ends
+	if (motion.Empty())
+	{
+		box0 = RotateBox(box0, sin_theta, cos_theta);
+		box1 = RotateBox(box1, sin_theta, cos_theta);
+		return true;
 	}
 
-	bbox = AABB(min, max);
+	double lo, hi;
+	motion.Range(time0, time1, lo, hi);
+	box0 = box1 = SweepBox(SurroundingBox(box0, box1), lo, hi);
+	return true;
 }
 
 bool RotateY::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
 {
+	double sin_t = sin_theta, cos_t = cos_theta;
+	if (!motion.Empty())
+	{
+		auto radians = DegreesToRadians(motion.At(r.Time()));
+		sin_t = sin(radians);
+		cos_t = cos(radians);
+	}
+
 	auto origin = r.Origin();
 	auto direction = r.Direction();
 
 	// ԭͷҪת
-	origin[0] = cos_theta * r.Origin()[0] - sin_theta * r.Origin()[2];
-	origin[2] = sin_theta * r.Origin()[0] + cos_theta * r.Origin()[2];
+	origin[0] = cos_t * r.Origin()[0] - sin_t * r.Origin()[2];
+	origin[2] = sin_t * r.Origin()[0] + cos_t * r.Origin()[2];
 
-	direction[0] = cos_theta * r.Direction()[0] - sin_theta * r.Direction()[2];
-	direction[2] = sin_theta * r.Direction()[0] + cos_theta * r.Direction()[2];
+	direction[0] = cos_t * r.Direction()[0] - sin_t * r.Direction()[2];
+	direction[2] = sin_t * r.Direction()[0] + cos_t * r.Direction()[2];
 
-	Ray rotated_r(origin, direction);
+	Ray rotated_r(origin, direction, r.Time());
 
 	if (!ptr->Hit(rotated_r, t_min, t_max, rec))
 		return false;
@@ -142,11 +396,11 @@ bool RotateY::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) cons
 	auto p = rec.p;
 	auto normal = rec.normal;
 
-	p[0] = cos_theta * rec.p[0] + sin_theta * rec.p[2];
-	p[2] = -sin_theta * rec.p[0] + cos_theta * rec.p[2];
+	p[0] = cos_t * rec.p[0] + sin_t * rec.p[2];
+	p[2] = -sin_t * rec.p[0] + cos_t * rec.p[2];
 
-	normal[0] = cos_theta * rec.normal[0] + sin_theta * rec.normal[2];
-	normal[2] = -sin_theta * rec.normal[0] + cos_theta * rec.normal[2];
+	normal[0] = cos_t * rec.normal[0] + sin_t * rec.normal[2];
+	normal[2] = -sin_t * rec.normal[0] + cos_t * rec.normal[2];
 
 	rec.p = p;
 	rec.SetFaceNormal(rotated_r, normal);
@@ -154,6 +408,73 @@ bool RotateY::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) cons
 	return true;
 }
 
+bool RotateY::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	double sin_t = sin_theta, cos_t = cos_theta;
+	if (!motion.Empty())
+	{
+		auto radians = DegreesToRadians(motion.At(r.Time()));
+		sin_t = sin(radians);
+		cos_t = cos(radians);
+	}
+
+	const Point3 o = r.Origin();
+	const Vec3 d = r.Direction();
+	return ptr->Occluded(Ray(Point3(cos_t * o[0] - sin_t * o[2], o[1], sin_t * o[0] + cos_t * o[2]),
+		Vec3(cos_t * d[0] - sin_t * d[2], d[1], sin_t * d[0] + cos_t * d[2]), r.Time()), t_min, t_max);
+}
+
+uint32_t RotateY::HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	double* t_max, HitRecord* recs) const
+{
+	// every ray of a turning object has its own angle
+	if (!motion.Empty())
+		return Hittable::HitPacket(packet, mask, t_min, t_max, recs);
+
+	RayPacket rotated;
+	rotated.size = packet.size;
+	for (int k = 0; k < packet.size; ++k)
+	{
+		const Point3 o = packet.rays[k].Origin();
+		const Vec3 d = packet.rays[k].Direction();
+		rotated.rays[k] = Ray(Point3(cos_theta * o[0] - sin_theta * o[2], o[1], sin_theta * o[0] + cos_theta * o[2]),
+			Vec3(cos_theta * d[0] - sin_theta * d[2], d[1], sin_theta * d[0] + cos_theta * d[2]), packet.rays[k].Time());
+	}
+
+	uint32_t hit_mask = ptr->HitPacket(rotated, mask, t_min, t_max, recs);
+	for (int k = 0; k < packet.size; ++k)
+	{
+		if (!(hit_mask & (1u << k)))
+			continue;
+
+		const Point3 p = recs[k].p;
+		const Vec3 n = recs[k].normal;
+		recs[k].p = Point3(cos_theta * p[0] + sin_theta * p[2], p[1], -sin_theta * p[0] + cos_theta * p[2]);
+		recs[k].SetFaceNormal(rotated.rays[k], Vec3(cos_theta * n[0] + sin_theta * n[2], n[1], -sin_theta * n[0] + cos_theta * n[2]));
+	}
+
+	return hit_mask;
+}
+
+uint32_t RotateY::OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	const double* t_max) const
+{
+	if (!motion.Empty())
+		return Hittable::OccludedPacket(packet, mask, t_min, t_max);
+
+	RayPacket rotated;
+	rotated.size = packet.size;
+	for (int k = 0; k < packet.size; ++k)
+	{
+		const Point3 o = packet.rays[k].Origin();
+		const Vec3 d = packet.rays[k].Direction();
+		rotated.rays[k] = Ray(Point3(cos_theta * o[0] - sin_theta * o[2], o[1], sin_theta * o[0] + cos_theta * o[2]),
+			Vec3(cos_theta * d[0] - sin_theta * d[2], d[1], sin_theta * d[0] + cos_theta * d[2]), packet.rays[k].Time());
+	}
+
+	return ptr->OccludedPacket(rotated, mask, t_min, t_max);
+}
+
 // ---FlipFace---
 
 bool FlipFace::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
@@ -168,4 +489,9 @@ bool FlipFace::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) con
 bool FlipFace::BoundingBox(AABB& output_box) const 
 {
 	return ptr->BoundingBox(output_box);
+}
+
+bool FlipFace::MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const
+{
+	return ptr->MotionBounds(time0, time1, box0, box1);
 }
\ No newline at end of file
@@ -5,18 +5,27 @@
 #include "./math.h"
 #include "./ray.h"
 #include "./aabb.h"
+#include "./ray_packet.h"
+#include "./keyframes.h"
 
 // forward declaration
 class Material; 
 
+// index of a material in the scene's MaterialTable
+typedef uint32_t MaterialID;
+const MaterialID NO_MATERIAL = 0;
+
+// how far a spawned ray starts off its surface, in units of the rounding error of the point
+const Real RAY_OFFSET_ULPS = 64;
+
 struct HitRecord
 {
 	Point3 p;
 	Vec3 normal;
-	shared_ptr<Material> mat_ptr;
-	double t;
-	double u;
-	double v;
+	MaterialID mat_id;
+	Real t;
+	Real u;
+	Real v;
 	bool is_front_face;
 
 	inline void SetFaceNormal(const Ray& r, const Vec3& outward_normal)
@@ -24,14 +33,55 @@ struct HitRecord
 		is_front_face = DotProduct(r.Direction(), outward_normal) < 0;
 		normal = is_front_face ? outward_normal : -outward_normal;
 	}
+
+	// Ray leaving p in direction w, for the ray r_in that found p. Its origin is pushed
+	// off the surface along the normal, to w's side, by more than the rounding error of p
+	// (which grows with the coordinates of p and of r_in's origin), so it is traced from
+	// t = 0 without finding the surface it leaves again, at any scale and precision.
+	inline Ray SpawnRay(const Ray& r_in, const Vec3& w) const
+	{
+		const Point3 o = r_in.Origin();
+		Real magnitude = 1;
+		for (int a = 0; a < 3; a++)
+			magnitude = std::max(magnitude, std::max(std::fabs(p.e[a]), std::fabs(o.e[a])));
+		const Real offset = RAY_OFFSET_ULPS * std::numeric_limits<Real>::epsilon() * magnitude;
+		return Ray(p + (DotProduct(w, normal) < 0 ? -offset : offset) * normal, w, r_in.Time());
+	}
 };
 
 class Hittable
 {
 public:
 	virtual bool Hit(const Ray& r, double tMin, double tMax, HitRecord& rec) const = 0;
+
+	// whether anything is hit between t_min and t_max, for shadow rays. Unlike Hit it may
+	// stop at the first hit it finds and fills in nothing. The default asks Hit.
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const;
+
+	// bounds the object at every time it can be hit at
 	virtual bool BoundingBox(AABB& output_box) const = 0;
 
+	// Boxes at time0 and time1 whose linear interpolation bounds the object at every time
+	// in between, far tighter than BoundingBox for a moving object. The default is a
+	// still object.
+	virtual bool MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const
+	{
+		bool has_box = BoundingBox(box0);
+		box1 = box0;
+		return has_box;
+	}
+
+	// Intersect the packet rays selected by mask. t_max and recs hold one entry per ray and
+	// are only updated for rays that found a closer hit, those rays' bits are returned.
+	// The default traces the rays one by one.
+	virtual uint32_t HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		double* t_max, HitRecord* recs) const;
+
+	// Occluded for the packet rays selected by mask, each up to its own t_max. Returns the
+	// bits of the rays that are blocked. The default tests the rays one by one.
+	virtual uint32_t OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		const double* t_max) const;
+
 	virtual double PDFValue(const Point3& o, const Vec3& v) const 
 	{ 
 		return 0.0;
@@ -41,6 +91,12 @@ public:
 	{
 		return Vec3(1, 0, 0);
 	}
+
+	// surface area, weighs a light by its power. 0 when unknown
+	virtual double Area() const
+	{
+		return 0.0;
+	}
 };
 
 class HittableList : public Hittable
@@ -53,10 +109,17 @@ public:
 	void add(shared_ptr<Hittable> object) { objects.push_back(object); }
 
 	virtual bool Hit(const Ray& r, double tMin, double tMax, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
 	virtual bool BoundingBox(AABB& output_box) const override;
+	virtual bool MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const override;
+	virtual uint32_t HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		double* t_max, HitRecord* recs) const override;
+	virtual uint32_t OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		const double* t_max) const override;
 
 	virtual double PDFValue(const Point3& o, const Vec3& v) const override;
 	virtual Vec3 Random(const Vec3& o) const override;
+	virtual double Area() const override;
 
 public:
 	std::vector<shared_ptr<Hittable>> objects;
@@ -65,8 +128,20 @@ public:
 class RotateY : public Hittable {
 public:
 	RotateY(shared_ptr<Hittable> p, double angle);
+
+	// turn to angle (degrees), e.g. for the next frame of an animation
+	void SetAngle(double angle);
+
+	// recompute the cached box after the object below or the motion has changed
+	void UpdateBox();
+
 	virtual bool Hit(
 		const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
+	virtual uint32_t HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		double* t_max, HitRecord* recs) const override;
+	virtual uint32_t OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		const double* t_max) const override;
 
 	virtual bool BoundingBox(AABB& output_box) const override 
 	{
@@ -74,12 +149,15 @@ public:
 		return hasbox;
 	}
 
+	virtual bool MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const override;
+
 public:
 	shared_ptr<Hittable> ptr;
-	double sin_theta;
-	double cos_theta;
+	Real sin_theta;
+	Real cos_theta;
 	bool hasbox;
 	AABB bbox;
+	Keyframes<double> motion;	// angle over time, rays are turned by the angle at their time when set
 };
 
 class Translate : public Hittable 
@@ -90,11 +168,35 @@ public:
 
 	virtual bool Hit(
 		const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
 	virtual bool BoundingBox(AABB& output_box) const override;
+	virtual bool MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const override;
+	virtual uint32_t HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		double* t_max, HitRecord* recs) const override;
+	virtual uint32_t OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		const double* t_max) const override;
+
+	// a moved light is sampled like the object inside, seen from the moved origin (offset
+	// is the one at the start of the frame for a moving light)
+	virtual double PDFValue(const Point3& o, const Vec3& v) const override
+	{
+		return ptr->PDFValue(o - offset, v);
+	}
+
+	virtual Vec3 Random(const Vec3& o) const override
+	{
+		return ptr->Random(o - offset);
+	}
+
+	virtual double Area() const override
+	{
+		return ptr->Area();
+	}
 
 public:
 	shared_ptr<Hittable> ptr;
 	Vec3 offset;
+	Keyframes<Vec3> motion;	// offset over time, rays are moved by the offset at their time when set
 };
 
 class FlipFace : public Hittable {
@@ -102,7 +204,30 @@ public:
 	FlipFace(shared_ptr<Hittable> p) : ptr(p) {}
 
 	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override
+	{
+		return ptr->Occluded(r, t_min, t_max);
+	}
+
 	virtual bool BoundingBox(AABB& output_box) const override;
+	virtual bool MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const override;
+
+	// a flipped light is sampled like the one inside, which light sampling never looks at
+	// the side of
+	virtual double PDFValue(const Point3& o, const Vec3& v) const override
+	{
+		return ptr->PDFValue(o, v);
+	}
+
+	virtual Vec3 Random(const Vec3& o) const override
+	{
+		return ptr->Random(o);
+	}
+
+	virtual double Area() const override
+	{
+		return ptr->Area();
+	}
 
 public:
 	shared_ptr<Hittable> ptr;
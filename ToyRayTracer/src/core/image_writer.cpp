@@ -0,0 +1,326 @@
+#include "./image_writer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	// NaN from a broken path is written as black
+	inline float Radiance(double c)
+	{
+		return c != c ? 0.0f : static_cast<float>(c);
+	}
+
+	// gamma 2 and clamp to [0,255], same as the old P3 output
+	inline unsigned char ToByte(double c)
+	{
+		if (c != c)
+			c = 0.0;
+		return static_cast<unsigned char>(256 * Clamp(std::sqrt(c), 0.0, 0.999));
+	}
+
+	void ByteRow(const Film& film, int row, int x0, int x1, unsigned char* out)
+	{
+		for (int x = x0; x < x1; ++x)
+		{
+			Color c = film.Value(x, row);
+			*out++ = ToByte(c.x());
+			*out++ = ToByte(c.y());
+			*out++ = ToByte(c.z());
+		}
+	}
+
+	// pfm stores rows from the bottom of the image up, little endian (negative scale)
+	void FloatRow(const Film& film, int row, int x0, int x1, float* out)
+	{
+		for (int x = x0; x < x1; ++x)
+		{
+			Color c = film.Value(x, row);
+			*out++ = Radiance(c.x());
+			*out++ = Radiance(c.y());
+			*out++ = Radiance(c.z());
+		}
+	}
+
+	std::string PPMHeader(int width, int height)
+	{
+		std::ostringstream header;
+		header << "P6\n" << width << " " << height << "\n255\n";
+		return header.str();
+	}
+
+	std::string PFMHeader(int width, int height)
+	{
+		std::ostringstream header;
+		header << "PF\n" << width << " " << height << "\n-1.0\n";
+		return header.str();
+	}
+
+	bool IsLittleEndian()
+	{
+		uint16_t one = 1;
+		unsigned char first;
+		std::memcpy(&first, &one, 1);
+		return first == 1;
+	}
+
+	void SwapBytes(float* values, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			unsigned char b[4];
+			std::memcpy(b, &values[i], 4);
+			std::swap(b[0], b[3]);
+			std::swap(b[1], b[2]);
+			std::memcpy(&values[i], b, 4);
+		}
+	}
+
+	bool OpenForWrite(std::ofstream& file, const std::string& path)
+	{
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			std::cerr << "ERROR: Could not open image file '" << path << "'.\n";
+		return static_cast<bool>(file);
+	}
+
+	// ---png---
+
+	std::vector<uint32_t> MakeCrcTable()
+	{
+		std::vector<uint32_t> table(256);
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		return table;
+	}
+
+	uint32_t Crc32(const unsigned char* data, size_t size)
+	{
+		static const std::vector<uint32_t> table = MakeCrcTable();
+		uint32_t crc = ~0u;
+		for (size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void PutU32(std::vector<unsigned char>& out, uint32_t v)
+	{
+		out.push_back(static_cast<unsigned char>(v >> 24));
+		out.push_back(static_cast<unsigned char>(v >> 16));
+		out.push_back(static_cast<unsigned char>(v >> 8));
+		out.push_back(static_cast<unsigned char>(v));
+	}
+
+	void PutChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+	{
+		PutU32(out, static_cast<uint32_t>(data.size()));
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		PutU32(out, Crc32(&out[start], out.size() - start));
+	}
+
+	// zlib stream made of stored (uncompressed) deflate blocks, a noisy render barely
+	// compresses anyway and this needs no library
+	std::vector<unsigned char> ZlibStored(const std::vector<unsigned char>& raw)
+	{
+		const size_t MAX_BLOCK = 65535;
+		std::vector<unsigned char> out = { 0x78, 0x01 };
+		size_t pos = 0;
+		do
+		{
+			size_t len = std::min(MAX_BLOCK, raw.size() - pos);
+			bool last = pos + len == raw.size();
+			out.push_back(last ? 1 : 0);
+			out.push_back(static_cast<unsigned char>(len));
+			out.push_back(static_cast<unsigned char>(len >> 8));
+			out.push_back(static_cast<unsigned char>(~len));
+			out.push_back(static_cast<unsigned char>(~len >> 8));
+			out.insert(out.end(), raw.begin() + pos, raw.begin() + pos + len);
+			pos += len;
+		} while (pos < raw.size());
+
+		uint32_t a = 1, b = 0;
+		for (unsigned char c : raw)
+		{
+			a = (a + c) % 65521;
+			b = (b + a) % 65521;
+		}
+		PutU32(out, (b << 16) | a);
+		return out;
+	}
+}
+
+ImageFormat FormatFromPath(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+		return ImageFormat::Unknown;
+	std::string ext = path.substr(dot + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	if (ext == "ppm")
+		return ImageFormat::PPM;
+	if (ext == "pfm")
+		return ImageFormat::PFM;
+	if (ext == "png")
+		return ImageFormat::PNG;
+	return ImageFormat::Unknown;
+}
+
+bool WriteImage(const std::string& path, const Film& film)
+{
+	switch (FormatFromPath(path))
+	{
+	case ImageFormat::PPM:
+		return WritePPM(path, film);
+	case ImageFormat::PFM:
+		return WritePFM(path, film);
+	case ImageFormat::PNG:
+		return WritePNG(path, film);
+	default:
+		std::cerr << "ERROR: Unknown image format '" << path << "', use .ppm, .pfm or .png.\n";
+		return false;
+	}
+}
+
+bool WritePPM(const std::string& path, const Film& film)
+{
+	std::ofstream file;
+	if (!OpenForWrite(file, path))
+		return false;
+
+	file << PPMHeader(film.Width(), film.Height());
+	std::vector<unsigned char> row(film.Width() * 3);
+	for (int y = 0; y < film.Height(); ++y)
+	{
+		ByteRow(film, y, 0, film.Width(), row.data());
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+	return static_cast<bool>(file);
+}
+
+bool WritePFM(const std::string& path, const Film& film)
+{
+	std::ofstream file;
+	if (!OpenForWrite(file, path))
+		return false;
+
+	file << PFMHeader(film.Width(), film.Height());
+	std::vector<float> row(film.Width() * 3);
+	for (int y = film.Height() - 1; y >= 0; --y)
+	{
+		FloatRow(film, y, 0, film.Width(), row.data());
+		if (!IsLittleEndian())
+			SwapBytes(row.data(), row.size());
+		file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+	}
+	return static_cast<bool>(file);
+}
+
+bool WritePNG(const std::string& path, const Film& film)
+{
+	std::ofstream file;
+	if (!OpenForWrite(file, path))
+		return false;
+
+	const int width = film.Width();
+	const int height = film.Height();
+
+	// every scanline starts with its filter type, 0 is none
+	std::vector<unsigned char> raw(static_cast<size_t>(width * 3 + 1) * height);
+	for (int y = 0; y < height; ++y)
+	{
+		unsigned char* line = &raw[static_cast<size_t>(width * 3 + 1) * y];
+		line[0] = 0;
+		ByteRow(film, y, 0, width, line + 1);
+	}
+
+	std::vector<unsigned char> header;
+	PutU32(header, width);
+	PutU32(header, height);
+	header.push_back(8);	// bit depth
+	header.push_back(2);	// color type rgb
+	header.push_back(0);	// compression
+	header.push_back(0);	// filter
+	header.push_back(0);	// no interlace
+
+	std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	PutChunk(png, "IHDR", header);
+	PutChunk(png, "IDAT", ZlibStored(raw));
+	PutChunk(png, "IEND", std::vector<unsigned char>());
+
+	file.write(reinterpret_cast<const char*>(png.data()), png.size());
+	return static_cast<bool>(file);
+}
+
+// ---ImageStream---
+
+ImageStream::ImageStream(const std::string& path, int w, int h)
+	: format(FormatFromPath(path)), header_size(0), width(w), height(h), is_open(false)
+{
+	if (!CanStream(format))
+	{
+		std::cerr << "ERROR: '" << path << "' can't be written tile by tile, use .ppm or .pfm.\n";
+		return;
+	}
+	if (!OpenForWrite(file, path))
+		return;
+
+	// lay out the whole file up front, black until the tiles arrive
+	std::string header = format == ImageFormat::PPM ? PPMHeader(width, height) : PFMHeader(width, height);
+	size_t pixel_size = format == ImageFormat::PPM ? 3 : 3 * sizeof(float);
+	file << header;
+	header_size = static_cast<std::streamoff>(header.size());
+	std::vector<char> zeros(width * pixel_size, 0);
+	for (int y = 0; y < height; ++y)
+		file.write(zeros.data(), zeros.size());
+	file.flush();
+	is_open = static_cast<bool>(file);
+}
+
+void ImageStream::WriteTile(const Film& film, const Tile& tile)
+{
+	if (!is_open)
+		return;
+
+	// convert the tile before taking the lock, only the file writes are serialized
+	const int count = tile.x1 - tile.x0;
+	const int rows = tile.y1 - tile.y0;
+	const size_t pixel_size = format == ImageFormat::PPM ? 3 : 3 * sizeof(float);
+	std::vector<char> data(static_cast<size_t>(count) * rows * pixel_size);
+	for (int y = tile.y0; y < tile.y1; ++y)
+	{
+		char* line = &data[static_cast<size_t>(y - tile.y0) * count * pixel_size];
+		if (format == ImageFormat::PPM)
+			ByteRow(film, y, tile.x0, tile.x1, reinterpret_cast<unsigned char*>(line));
+		else
+		{
+			std::vector<float> floats(count * 3);
+			FloatRow(film, y, tile.x0, tile.x1, floats.data());
+			if (!IsLittleEndian())
+				SwapBytes(floats.data(), floats.size());
+			std::memcpy(line, floats.data(), floats.size() * sizeof(float));
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int y = tile.y0; y < tile.y1; ++y)
+	{
+		// pfm lines go bottom up
+		std::streamoff line = format == ImageFormat::PPM ? y : height - 1 - y;
+		file.seekp(header_size + (line * width + tile.x0) * static_cast<std::streamoff>(pixel_size));
+		file.write(&data[static_cast<size_t>(y - tile.y0) * count * pixel_size], count * pixel_size);
+	}
+	// hand it to the os, so it survives the process dying
+	file.flush();
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include "./film.h"
+#include "./scheduler.h"
+
+enum class ImageFormat
+{
+	PPM,	// binary P6, 8 bits, gamma corrected
+	PFM,	// 32-bit float, linear radiance, nothing clamped
+	PNG,	// 8 bits, gamma corrected
+	Unknown
+};
+
+// format picked from the extension of path
+ImageFormat FormatFromPath(const std::string& path);
+
+// Write the whole film to path in the format of its extension, errors are reported on
+// std::cerr and return false.
+bool WriteImage(const std::string& path, const Film& film);
+
+bool WritePPM(const std::string& path, const Film& film);
+bool WritePFM(const std::string& path, const Film& film);
+bool WritePNG(const std::string& path, const Film& film);
+
+// Image file that is updated tile by tile while the render runs, so a crashed or killed
+// render still leaves everything finished so far on disk. Only formats with a fixed size
+// per pixel (PPM and PFM) can be patched in place.
+class ImageStream
+{
+public:
+	ImageStream(const std::string& path, int width, int height);
+
+	bool IsOpen() const { return is_open; }
+	static bool CanStream(ImageFormat format) { return format == ImageFormat::PPM || format == ImageFormat::PFM; }
+
+	// write the current value of the tile's pixels, safe to call from the render threads
+	void WriteTile(const Film& film, const Tile& tile);
+
+private:
+	std::ofstream file;
+	std::mutex mutex;
+	ImageFormat format;
+	std::streamoff header_size;
+	int width;
+	int height;
+	bool is_open;
+};
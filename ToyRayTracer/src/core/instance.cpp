@@ -0,0 +1,74 @@
+#include "./instance.h"
+
+#include <cmath>
+
+// ---Instance---
+
+Instance::Instance(shared_ptr<Hittable> p, const Transform& transform)
+	: ptr(p), to_world(transform)
+{
+	to_world.Inverse(to_object);
+	UpdateBox();
+}
+
+void Instance::UpdateBox()
+{
+	hasbox = ptr->BoundingBox(bbox);
+	if (hasbox)
+		bbox = to_world.Box(bbox);
+}
+
+bool Instance::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
+{
+	if (!ptr->Hit(to_object.Apply(r), t_min, t_max, rec))
+		return false;
+
+	ToWorld(rec);
+	return true;
+}
+
+uint32_t Instance::HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	double* t_max, HitRecord* recs) const
+{
+	RayPacket moved;
+	moved.size = packet.size;
+	for (int k = 0; k < packet.size; ++k)
+		moved.rays[k] = to_object.Apply(packet.rays[k]);
+
+	uint32_t hit_mask = ptr->HitPacket(moved, mask, t_min, t_max, recs);
+	for (int k = 0; k < packet.size; ++k)
+	{
+		if (hit_mask & (1u << k))
+			ToWorld(recs[k]);
+	}
+
+	return hit_mask;
+}
+
+uint32_t Instance::OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	const double* t_max) const
+{
+	RayPacket moved;
+	moved.size = packet.size;
+	for (int k = 0; k < packet.size; ++k)
+		moved.rays[k] = to_object.Apply(packet.rays[k]);
+
+	return ptr->OccludedPacket(moved, mask, t_min, t_max);
+}
+
+bool Instance::MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const
+{
+	if (!ptr->MotionBounds(time0, time1, box0, box1))
+		return false;
+
+	// the bounds are linear in the box, so the transformed ends still bound every time between
+	box0 = to_world.Box(box0);
+	box1 = to_world.Box(box1);
+	return true;
+}
+
+double Instance::Area() const
+{
+	// exact when every direction is scaled alike
+	return ptr->Area() * std::pow(std::fabs(to_world.Determinant()), 2.0 / 3.0);
+}
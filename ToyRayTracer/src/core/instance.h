@@ -0,0 +1,67 @@
+#pragma once
+#include "./math.h"
+#include "./hittable.h"
+#include "./transform.h"
+
+// An object placed in the world by an affine transform (any rotation, scale and offset),
+// kept as a matrix and its inverse. Rays are taken into the object's space with one
+// matrix, hits come back with the other, so a stack of transforms is one step and any
+// number of instances can share one object (and the one bvh built for it), each costing
+// only its matrices.
+// The transform must be invertible. Light sampling through an instance is exact for
+// rigid and uniformly scaled transforms, a medium inside one only for rigid ones.
+class Instance : public Hittable
+{
+public:
+	Instance(shared_ptr<Hittable> p, const Transform& transform);
+
+	// recompute the cached box after the object below has changed
+	void UpdateBox();
+
+	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override
+	{
+		return ptr->Occluded(to_object.Apply(r), t_min, t_max);
+	}
+
+	virtual uint32_t HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		double* t_max, HitRecord* recs) const override;
+	virtual uint32_t OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		const double* t_max) const override;
+
+	virtual bool BoundingBox(AABB& output_box) const override
+	{
+		output_box = bbox;
+		return hasbox;
+	}
+
+	virtual bool MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const override;
+
+	virtual double PDFValue(const Point3& o, const Vec3& v) const override
+	{
+		return ptr->PDFValue(to_object.Point(o), to_object.Vector(v));
+	}
+
+	virtual Vec3 Random(const Vec3& o) const override
+	{
+		return to_world.Vector(ptr->Random(to_object.Point(o)));
+	}
+
+	virtual double Area() const override;
+
+public:
+	shared_ptr<Hittable> ptr;
+	Transform to_world;
+	Transform to_object;
+	bool hasbox;
+	AABB bbox;
+
+private:
+	// the hit found in object space, moved to the world
+	inline void ToWorld(HitRecord& rec) const
+	{
+		// the normal keeps its side of the ray, so is_front_face stays right
+		rec.p = to_world.Point(rec.p);
+		rec.normal = UnitVector(to_object.TransposedVector(rec.normal));
+	}
+};
@@ -0,0 +1,196 @@
+#include "./integrator.h"
+
+#include <algorithm>
+
+#include "./materials.h"
+#include "./pdf.h"
+
+namespace
+{
+	// part of the distance to a sampled light the shadow ray leaves out
+	const double SHADOW_EPSILON = 1e-4;
+
+	// weight of the strategy that sampled a direction with pdf f when another one could
+	// have sampled it with pdf g
+	inline double PowerHeuristic(double f, double g)
+	{
+		if (!(g > 0))
+			return 1;
+		return f * f / (f * f + g * g);
+	}
+
+	inline bool IsBlack(const Color& c)
+	{
+		return c.x() <= 0 && c.y() <= 0 && c.z() <= 0;
+	}
+}
+
+PathIntegrator::PathIntegrator(const Hittable& w, const MaterialTable& m, shared_ptr<HittableList> l,
+	const Color& bg, int max_d, int rr_d)
+	: world(w), materials(m), lights(l), light_sampler(l.get(), w, m), background(bg), max_depth(max_d), rr_depth(rr_d)
+{
+}
+
+Color PathIntegrator::Li(const Ray& r) const
+{
+	PathState path = { r, Color(1, 1, 1), Color(0, 0, 0), 0, 0.0 };
+	Trace(path);
+	return path.radiance;
+}
+
+Color PathIntegrator::LiPacket(const RayPacket& packet) const
+{
+	if (max_depth <= 0)
+		return Color(0, 0, 0);
+
+	HitRecord recs[PACKET_SIZE];
+	double t_max[PACKET_SIZE];
+	for (int k = 0; k < packet.size; ++k)
+		t_max[k] = INF;
+
+	uint32_t hit_mask = world.HitPacket(packet, packet.FullMask(), 0, t_max, recs);
+
+	// shade the first hits, keeping their shadow rays to trace as a packet too: they leave
+	// points close together for the same lights
+	PathState paths[PACKET_SIZE];
+	ShadowRay shadows[PACKET_SIZE];
+	RayPacket shadow_packet;
+	shadow_packet.size = packet.size;
+	uint32_t alive = 0, shadow_mask = 0;
+	for (int k = 0; k < packet.size; ++k)
+	{
+		paths[k] = { packet.rays[k], Color(1, 1, 1), Color(0, 0, 0), 0, 0.0 };
+		if (!(hit_mask & (1u << k)))
+		{
+			paths[k].radiance = background;
+			continue;
+		}
+
+		if (Bounce(paths[k], recs[k], &shadows[k]))
+			alive |= 1u << k;
+		if (shadows[k].t_max > 0)
+		{
+			shadow_packet.rays[k] = shadows[k].ray;
+			t_max[k] = shadows[k].t_max;
+			shadow_mask |= 1u << k;
+		}
+	}
+	uint32_t blocked = shadow_mask ? world.OccludedPacket(shadow_packet, shadow_mask, 0, t_max) : 0;
+
+	Color sum(0, 0, 0);
+	for (int k = 0; k < packet.size; ++k)
+	{
+		if (shadow_mask & ~blocked & (1u << k))
+			paths[k].radiance += shadows[k].radiance;
+		if (alive & (1u << k))
+			Trace(paths[k]);
+		sum += paths[k].radiance;
+	}
+	return sum;
+}
+
+void PathIntegrator::Trace(PathState& path) const
+{
+	HitRecord rec;
+	while (path.depth < max_depth)
+	{
+		// If the ray hits nothing, it picks up the background color. Rays leave surfaces
+		// through HitRecord::SpawnRay, so they are traced from t = 0.
+		if (!world.Hit(path.ray, 0, INF, rec))
+		{
+			path.radiance += path.throughput * background;
+			return;
+		}
+
+		if (!Bounce(path, rec))
+			return;
+	}
+}
+
+bool PathIntegrator::Bounce(PathState& path, const HitRecord& rec, ShadowRay* shadow) const
+{
+	const Ray& r = path.ray;
+	path.depth++;
+	if (shadow)
+		shadow->t_max = 0;
+
+	const Material* mat = materials.Get(rec.mat_id);
+	Color emitted = mat->Emitted(r, rec, rec.u, rec.v, rec.p);
+	if (!IsBlack(emitted))
+	{
+		// a light the last bounce could also have reached by next event estimation, lights
+		// behind the surface hit don't count: their samples are blocked by it
+		double weight = path.bounce_pdf > 0
+			? PowerHeuristic(path.bounce_pdf, light_sampler.PDFValue(r.Origin(), r.Direction(), rec.t * (1 + SHADOW_EPSILON))) : 1.0;
+		path.radiance += path.throughput * emitted * weight;
+	}
+
+	ScatterRecord srec;
+	if (!mat->Scatter(r, rec, srec))
+		return false;
+
+	if (srec.is_specular)
+	{
+		path.throughput = path.throughput * srec.attenuation;
+		path.ray = rec.SpawnRay(r, srec.specular_ray.Direction());
+		path.bounce_pdf = 0;
+	}
+	else
+	{
+		// the bsdf, mixed with the lights that only guide the bounce when there are any
+		HittablePDF guide_pdf(&light_sampler.guides, rec.p);
+		MixturePDF mixture_pdf(&guide_pdf, &srec.pdf);
+		const PDF& p = light_sampler.guides.objects.empty() ? static_cast<const PDF&>(srec.pdf) : mixture_pdf;
+
+		// the light reached from here is one bounce further down the path
+		ShadowRay to_light;
+		if (!light_sampler.Empty() && path.depth < max_depth && SampleDirectLight(r, rec, mat, srec, p, to_light))
+		{
+			to_light.radiance = path.throughput * to_light.radiance;
+			if (shadow)
+				*shadow = to_light;
+			else if (!world.Occluded(to_light.ray, 0, to_light.t_max))
+				path.radiance += to_light.radiance;
+		}
+
+		Ray scattered = rec.SpawnRay(r, p.Generate());
+		auto pdf_val = p.Value(scattered.Direction());
+
+		path.throughput = path.throughput * srec.attenuation
+			* mat->ScatteringPDF(r, rec, scattered) / pdf_val;
+		path.ray = scattered;
+		path.bounce_pdf = pdf_val;
+	}
+
+	// russian roulette: keep the path with a probability following its throughput and
+	// reweight the survivors, so the estimate stays unbiased
+	if (path.depth >= rr_depth)
+	{
+		double survive = std::min<double>(0.95, std::max(path.throughput.x(), std::max(path.throughput.y(), path.throughput.z())));
+		if (RandomDouble() >= survive)
+			return false;
+		path.throughput /= survive;
+	}
+
+	return true;
+}
+
+bool PathIntegrator::SampleDirectLight(const Ray& r, const HitRecord& rec, const Material* mat,
+	const ScatterRecord& srec, const PDF& bounce_pdf, ShadowRay& shadow) const
+{
+	LightSample light;
+	if (!light_sampler.Sample(rec.p, r.Time(), light) || IsBlack(light.emitted))
+		return false;
+
+	Ray to_light = rec.SpawnRay(r, light.direction);
+	double scattering_pdf = mat->ScatteringPDF(r, rec, to_light);
+	if (!(scattering_pdf > 0))
+		return false;
+
+	// the shadow ray stops just short of the light, whose surface is in the world too
+	double weight = PowerHeuristic(light.pdf, bounce_pdf.Value(to_light.Direction()));
+	shadow.ray = to_light;
+	shadow.t_max = light.t * (1 - SHADOW_EPSILON);
+	shadow.radiance = srec.attenuation * light.emitted * (scattering_pdf * weight / light.pdf);
+	return true;
+}
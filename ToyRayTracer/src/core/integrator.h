@@ -0,0 +1,73 @@
+#pragma once
+#include "./math.h"
+#include "./ray.h"
+#include "./ray_packet.h"
+#include "./hittable.h"
+#include "./materials.h"
+#include "./material_table.h"
+#include "./light_sampler.h"
+
+// everything a path carries from one bounce to the next
+struct PathState
+{
+	Ray ray;
+	Color throughput;	// product of attenuation * bsdf / pdf along the path so far
+	Color radiance;		// light gathered so far
+	int depth;
+	double bounce_pdf;	// pdf the last bounce sampled ray with, 0 after a specular bounce or none
+};
+
+// ray towards a sampled light, and the light it adds to its path unless something blocks it
+struct ShadowRay
+{
+	Ray ray;
+	double t_max = 0;	// 0 when no light was sampled
+	Color radiance;
+};
+
+// Iterative path tracer with next event estimation and russian roulette. At every diffuse
+// bounce a ray is sent towards a light picked by power (see LightSampler), and the light
+// it reaches is weighted against the bsdf sampled ray finding the same light with the
+// power heuristic of multiple importance sampling.
+class PathIntegrator
+{
+public:
+	// Paths are cut after max_depth bounces, and from rr_depth bounces on they are
+	// randomly terminated with a probability that grows as their throughput shrinks.
+	// materials is the table of the scene world was built from.
+	PathIntegrator(const Hittable& world, const MaterialTable& materials, shared_ptr<HittableList> lights,
+		const Color& background, int max_depth, int rr_depth);
+
+	// radiance arriving along r
+	Color Li(const Ray& r) const;
+
+	// sum of the radiance arriving along the packet rays, the first hits and the shadow rays
+	// leaving them are traced for the whole packet and the paths continue ray by ray
+	Color LiPacket(const RayPacket& packet) const;
+
+private:
+	// traces the same paths a wave at a time, shading them with Bounce
+	friend class WavefrontIntegrator;
+
+	// follow the path until it leaves the scene or is terminated
+	void Trace(PathState& path) const;
+
+	// Add the light emitted at rec and scatter the path, false when the path ends there.
+	// With shadow the ray towards a light is not traced but handed back, for the caller to
+	// trace along with others and add its radiance to the path if it is not blocked.
+	bool Bounce(PathState& path, const HitRecord& rec, ShadowRay* shadow = nullptr) const;
+
+	// ray from the diffuse point rec towards a light and the light it brings, weighted
+	// against bounce_pdf sampling the same ray. false when there is none to trace
+	bool SampleDirectLight(const Ray& r, const HitRecord& rec, const Material* mat,
+		const ScatterRecord& srec, const PDF& bounce_pdf, ShadowRay& shadow) const;
+
+private:
+	const Hittable& world;
+	const MaterialTable& materials;
+	shared_ptr<HittableList> lights;
+	LightSampler light_sampler;
+	Color background;
+	int max_depth;
+	int rr_depth;
+};
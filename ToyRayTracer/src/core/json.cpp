@@ -0,0 +1,318 @@
+#include "./json.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	// nesting deeper than this is surely a broken file, and would overflow the stack
+	const int MAX_DEPTH = 256;
+
+	class JsonParser
+	{
+	public:
+		JsonParser(const std::string& text, const std::string& file_name)
+			: p(text.c_str()), end(text.c_str() + text.size()), name(file_name), line(1) {}
+
+		bool ParseDocument(JsonValue& value)
+		{
+			if (!ParseValue(value, 0))
+				return false;
+			SkipSpace();
+			if (p != end)
+				return Error("unexpected text after the end of the document");
+			return true;
+		}
+
+	private:
+		bool Error(const char* what)
+		{
+			std::cerr << "ERROR: " << name << ":" << line << ": " << what << "\n";
+			return false;
+		}
+
+		void SkipSpace()
+		{
+			while (p < end)
+			{
+				if (*p == '\n')
+					++line;
+				if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+					++p;
+				else if (*p == '/' && p + 1 < end && p[1] == '/')
+				{
+					while (p < end && *p != '\n')
+						++p;
+				}
+				else
+					break;
+			}
+		}
+
+		bool Literal(const char* word)
+		{
+			const char* q = p;
+			for (; *word; ++word, ++q)
+			{
+				if (q == end || *q != *word)
+					return false;
+			}
+			p = q;
+			return true;
+		}
+
+		bool ParseValue(JsonValue& value, int depth)
+		{
+			if (depth > MAX_DEPTH)
+				return Error("nested too deeply");
+
+			SkipSpace();
+			value.line = line;
+			if (p == end)
+				return Error("unexpected end of the document");
+
+			switch (*p)
+			{
+			case '{':
+				return ParseObject(value, depth);
+			case '[':
+				return ParseArray(value, depth);
+			case '"':
+				value.type = JsonValue::Type::String;
+				return ParseString(value.string);
+			case 't':
+			case 'f':
+				value.type = JsonValue::Type::Bool;
+				value.boolean = *p == 't';
+				if (Literal(value.boolean ? "true" : "false"))
+					return true;
+				return Error("unknown word, expected true or false");
+			case 'n':
+				if (Literal("null"))
+					return true;
+				return Error("unknown word, expected null");
+			default:
+				return ParseNumber(value);
+			}
+		}
+
+		bool ParseNumber(JsonValue& value)
+		{
+			// strtod also takes hex and inf, only let json numbers through
+			const char* q = p;
+			if (q < end && *q == '-')
+				++q;
+			if (q == end || *q < '0' || *q > '9')
+				return Error("expected a value");
+
+			std::string digits;
+			while (q < end && ((*q >= '0' && *q <= '9') || *q == '-' || *q == '+' || *q == '.' || *q == 'e' || *q == 'E'))
+				++q;
+			digits.assign(p, q);
+
+			char* parsed_end = nullptr;
+			value.type = JsonValue::Type::Number;
+			value.number = std::strtod(digits.c_str(), &parsed_end);
+			if (parsed_end != digits.c_str() + digits.size())
+				return Error("malformed number");
+			p = q;
+			return true;
+		}
+
+		bool ParseString(std::string& out)
+		{
+			++p;
+			out.clear();
+			while (p < end && *p != '"')
+			{
+				if (*p == '\n')
+					return Error("line break inside a string");
+				if (*p != '\\')
+				{
+					out += *p++;
+					continue;
+				}
+
+				if (++p == end)
+					break;
+				switch (*p++)
+				{
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u':
+				{
+					// code points of the basic plane as utf-8, enough for file names
+					if (end - p < 4)
+						return Error("malformed \\u escape");
+					unsigned code = 0;
+					for (int k = 0; k < 4; ++k, ++p)
+					{
+						char c = *p;
+						code <<= 4;
+						if (c >= '0' && c <= '9') code |= c - '0';
+						else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+						else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+						else return Error("malformed \\u escape");
+					}
+					if (code < 0x80)
+						out += static_cast<char>(code);
+					else if (code < 0x800)
+					{
+						out += static_cast<char>(0xc0 | (code >> 6));
+						out += static_cast<char>(0x80 | (code & 0x3f));
+					}
+					else
+					{
+						out += static_cast<char>(0xe0 | (code >> 12));
+						out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+						out += static_cast<char>(0x80 | (code & 0x3f));
+					}
+					break;
+				}
+				default:
+					return Error("unknown escape in a string");
+				}
+			}
+
+			if (p == end)
+				return Error("string is not closed");
+			++p;
+			return true;
+		}
+
+		bool ParseArray(JsonValue& value, int depth)
+		{
+			value.type = JsonValue::Type::Array;
+			++p;
+			SkipSpace();
+			if (p < end && *p == ']')
+			{
+				++p;
+				return true;
+			}
+
+			while (true)
+			{
+				value.items.emplace_back();
+				if (!ParseValue(value.items.back(), depth + 1))
+					return false;
+
+				SkipSpace();
+				if (p < end && *p == ',')
+					++p;
+				else if (p < end && *p == ']')
+				{
+					++p;
+					return true;
+				}
+				else
+					return Error("expected ',' or ']' in an array");
+			}
+		}
+
+		bool ParseObject(JsonValue& value, int depth)
+		{
+			value.type = JsonValue::Type::Object;
+			++p;
+			SkipSpace();
+			if (p < end && *p == '}')
+			{
+				++p;
+				return true;
+			}
+
+			while (true)
+			{
+				SkipSpace();
+				if (p == end || *p != '"')
+					return Error("expected a member name in quotes");
+
+				std::string key;
+				if (!ParseString(key))
+					return false;
+				if (value.Find(key))
+					return Error("member appears twice");
+
+				SkipSpace();
+				if (p == end || *p != ':')
+					return Error("expected ':' after the member name");
+				++p;
+
+				value.members.emplace_back(key, JsonValue());
+				if (!ParseValue(value.members.back().second, depth + 1))
+					return false;
+
+				SkipSpace();
+				if (p < end && *p == ',')
+					++p;
+				else if (p < end && *p == '}')
+				{
+					++p;
+					return true;
+				}
+				else
+					return Error("expected ',' or '}' in an object");
+			}
+		}
+
+	private:
+		const char* p;
+		const char* end;
+		const std::string& name;
+		int line;
+	};
+}
+
+// ---JsonValue---
+
+const JsonValue* JsonValue::Find(const std::string& key) const
+{
+	for (const auto& member : members)
+	{
+		if (member.first == key)
+			return &member.second;
+	}
+	return nullptr;
+}
+
+const char* JsonValue::TypeName() const
+{
+	switch (type)
+	{
+	case Type::Bool: return "a boolean";
+	case Type::Number: return "a number";
+	case Type::String: return "a string";
+	case Type::Array: return "an array";
+	case Type::Object: return "an object";
+	default: return "null";
+	}
+}
+
+bool ParseJson(const std::string& text, const std::string& name, JsonValue& value)
+{
+	value = JsonValue();
+	JsonParser parser(text, name);
+	return parser.ParseDocument(value);
+}
+
+bool ReadJsonFile(const std::string& path, JsonValue& value)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "ERROR: could not open '" << path << "'\n";
+		return false;
+	}
+
+	std::ostringstream text;
+	text << file.rdbuf();
+	return ParseJson(text.str(), path, value);
+}
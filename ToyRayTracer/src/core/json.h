@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+// A value of a json document, as read by ParseJson. Objects keep their members in the
+// order of the file, every value remembers its line for error messages.
+class JsonValue
+{
+public:
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	JsonValue() : type(Type::Null), boolean(false), number(0), line(0) {}
+
+	bool IsNumber() const { return type == Type::Number; }
+	bool IsString() const { return type == Type::String; }
+	bool IsArray() const { return type == Type::Array; }
+	bool IsObject() const { return type == Type::Object; }
+
+	// the member called key of an object, nullptr if there is none
+	const JsonValue* Find(const std::string& key) const;
+
+	// the name of the type, for error messages
+	const char* TypeName() const;
+
+public:
+	Type type;
+	bool boolean;
+	double number;
+	std::string string;
+	std::vector<JsonValue> items;							// array
+	std::vector<std::pair<std::string, JsonValue>> members;	// object
+	int line;
+};
+
+// Parse json text into value, // comments are allowed so scene files can be annotated.
+// Errors are reported on std::cerr as name:line and return false.
+bool ParseJson(const std::string& text, const std::string& name, JsonValue& value);
+
+// read and parse the json file at path
+bool ReadJsonFile(const std::string& path, JsonValue& value);
@@ -0,0 +1,99 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+#include "./math.h"
+
+// Values of a transform over time, linear between keys and held before the first and
+// after the last one. Times are in frames.
+template<typename T>
+struct Keyframes
+{
+	std::vector<double> times;	// increasing
+	std::vector<T> values;
+
+	bool Empty() const { return times.empty(); }
+
+	void Add(double time, const T& value)
+	{
+		times.push_back(time);
+		values.push_back(value);
+	}
+
+	T At(double time) const
+	{
+		auto next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+		if (next == 0)
+			return values.front();
+		if (next == static_cast<long>(times.size()))
+			return values.back();
+
+		double s = (time - times[next - 1]) / (times[next] - times[next - 1]);
+		return values[next - 1] * (1 - s) + values[next] * s;
+	}
+
+	// smallest and largest value over [time0, time1], reached at the ends or at a key
+	void Range(double time0, double time1, T& lo, T& hi) const
+	{
+		lo = hi = At(time0);
+		Extend(At(time1), lo, hi);
+		for (size_t i = 0; i < times.size(); ++i)
+		{
+			if (times[i] > time0 && times[i] < time1)
+				Extend(values[i], lo, hi);
+		}
+	}
+
+	// Lines through time0 and time1 that stay below (lo0 to lo1) and above (hi0 to hi1)
+	// the values over the whole interval: the line between the ends, pushed out by the
+	// furthest key that crosses it
+	void LinearBounds(double time0, double time1, T& lo0, T& lo1, T& hi0, T& hi1) const
+	{
+		lo0 = hi0 = At(time0);
+		lo1 = hi1 = At(time1);
+		for (size_t i = 0; i < times.size(); ++i)
+		{
+			if (!(times[i] > time0 && times[i] < time1))
+				continue;
+
+			double s = (times[i] - time0) / (time1 - time0);
+			T line = lo0 * (1 - s) + lo1 * s;
+			T below, above;
+			Deviation(values[i], line, below, above);
+			lo0 = lo0 - below;
+			lo1 = lo1 - below;
+			line = hi0 * (1 - s) + hi1 * s;
+			Deviation(values[i], line, below, above);
+			hi0 = hi0 + above;
+			hi1 = hi1 + above;
+		}
+	}
+
+private:
+	template<typename S>
+	static void Extend(S value, S& lo, S& hi)
+	{
+		lo = std::min(lo, value);
+		hi = std::max(hi, value);
+	}
+
+	static void Extend(const Vec3& value, Vec3& lo, Vec3& hi)
+	{
+		for (int a = 0; a < 3; a++)
+			Extend(value.e[a], lo.e[a], hi.e[a]);
+	}
+
+	// how far value lies below and above line, 0 on the other side
+	template<typename S>
+	static void Deviation(S value, S line, S& below, S& above)
+	{
+		below = std::max(S(0), line - value);
+		above = std::max(S(0), value - line);
+	}
+
+	static void Deviation(const Vec3& value, const Vec3& line, Vec3& below, Vec3& above)
+	{
+		for (int a = 0; a < 3; a++)
+			Deviation(value.e[a], line.e[a], below.e[a], above.e[a]);
+	}
+};
@@ -0,0 +1,193 @@
+#include "./light_sampler.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "./materials.h"
+
+namespace
+{
+	const int EMISSION_PROBES = 16;
+
+	// how far from a light the world is searched for the surface it lies on
+	const double PROBE_DISTANCE = 0.01;
+
+	double Luminance(const Color& c)
+	{
+		return (c.x() + c.y() + c.z()) / 3;
+	}
+
+	// emission of the material at rec, from whichever side it emits
+	double Emission(const MaterialTable& materials, const Ray& r, HitRecord rec)
+	{
+		const Material* mat = materials.Get(rec.mat_id);
+		if (!mat)
+			return 0;
+
+		rec.is_front_face = true;
+		return Luminance(mat->Emitted(r, rec, rec.u, rec.v, rec.p));
+	}
+
+	// mean emission over points sampled on light, seen from outside its box. A light
+	// without an emitting material of its own gets the surface it marks as emitter
+	double MeanEmission(const Hittable& light, const Hittable& world, const MaterialTable& materials,
+		LightSampler::Emitter& emitter)
+	{
+		AABB box;
+		if (!light.BoundingBox(box))
+			return 0;
+
+		// look along the flattest axis of the box, so a rectangle is seen face on
+		Vec3 extent = box.max() - box.min();
+		int flat = 0;
+		for (int a = 1; a < 3; a++)
+		{
+			if (extent[a] < extent[flat])
+				flat = a;
+		}
+		Vec3 axis(0, 0, 0);
+		axis.e[flat] = 1;
+		const Point3 origin = 0.5 * (box.min() + box.max()) + (extent.Length() + 1) * axis;
+
+		double sum = 0;
+		for (int i = 0; i < EMISSION_PROBES; ++i)
+		{
+			Ray to_light(origin, light.Random(origin));
+			HitRecord rec;
+			if (!light.Hit(to_light, 0.001, INF, rec))
+				continue;
+
+			double emission = emitter.mat_id == NO_MATERIAL ? Emission(materials, to_light, rec) : 0;
+			if (emission <= 0)
+			{
+				// a light without a material only marks where the world's emitter is
+				HitRecord surface, marker;
+				for (double side : { 1.0, -1.0 })
+				{
+					Ray probe(rec.p + side * PROBE_DISTANCE * rec.normal, -side * rec.normal);
+					if (!world.Hit(probe, 0, 2 * PROBE_DISTANCE, surface) || !light.Hit(probe, 0, 2 * PROBE_DISTANCE, marker))
+						continue;
+
+					double surface_emission = Emission(materials, probe, surface);
+					if (surface_emission > emission)
+					{
+						emission = surface_emission;
+						emitter.mat_id = surface.mat_id;
+						emitter.flip = surface.is_front_face != marker.is_front_face;
+					}
+				}
+			}
+			sum += emission;
+		}
+		return sum / EMISSION_PROBES;
+	}
+}
+
+// ---LightSampler---
+
+LightSampler::LightSampler(const HittableList* lights, const Hittable& world, const MaterialTable& m)
+	: materials(m)
+{
+	if (!lights)
+		return;
+
+	std::vector<shared_ptr<Hittable>> lit;
+	std::vector<double> powers;
+	std::vector<Emitter> lit_emitters;
+	for (const auto& light : lights->objects)
+	{
+		AABB box;
+		Emitter emitter;
+		double emission = MeanEmission(*light, world, materials, emitter);
+		if (emission > 0 && light->BoundingBox(box))
+		{
+			lit.push_back(light);
+			// a light of unknown area counts as one of unit area
+			double area = light->Area();
+			powers.push_back(emission * (area > 0 ? area : 1.0));
+			lit_emitters.push_back(emitter);
+		}
+		else
+			guides.add(light);
+	}
+	if (lit.empty())
+		return;
+
+	bvh = LinearBVH(lit);
+
+	// the bvh reorders the lights, their probabilities and emitters follow
+	std::unordered_map<const Hittable*, size_t> index_of;
+	double total = 0;
+	for (size_t i = 0; i < lit.size(); ++i)
+	{
+		index_of[lit[i].get()] = i;
+		total += powers[i];
+	}
+
+	pick.resize(bvh.primitives.size());
+	cdf.resize(bvh.primitives.size());
+	emitters.resize(bvh.primitives.size());
+	double running = 0;
+	for (size_t i = 0; i < bvh.primitives.size(); ++i)
+	{
+		size_t index = index_of[bvh.primitives[i].get()];
+		pick[i] = powers[index] / total;
+		running += pick[i];
+		cdf[i] = running;
+		emitters[i] = lit_emitters[index];
+	}
+	cdf.back() = 1.0;
+}
+
+bool LightSampler::Sample(const Point3& o, double time, LightSample& sample) const
+{
+	if (Empty())
+		return false;
+
+	size_t index = std::upper_bound(cdf.begin(), cdf.end(), RandomDouble()) - cdf.begin();
+	index = std::min(index, cdf.size() - 1);
+	const Hittable& light = *bvh.primitives[index];
+
+	sample.direction = light.Random(o);
+	Ray to_light(o, sample.direction, time);
+	HitRecord rec;
+	if (!light.Hit(to_light, 0.001, INF, rec))
+		return false;
+
+	const Emitter& emitter = emitters[index];
+	const Material* mat = materials.Get(emitter.mat_id != NO_MATERIAL ? emitter.mat_id : rec.mat_id);
+	if (!mat)
+		return false;
+	if (emitter.flip)
+		rec.is_front_face = !rec.is_front_face;
+
+	sample.t = rec.t;
+	sample.pdf = pick[index] * light.PDFValue(o, sample.direction);
+	sample.emitted = mat->Emitted(to_light, rec, rec.u, rec.v, rec.p);
+	return sample.pdf > 0;
+}
+
+double LightSampler::PDFValue(const Point3& o, const Vec3& v, double t_max) const
+{
+	if (Empty())
+		return 0;
+
+	// a sample towards any light behind the first one would be blocked by it
+	const Ray r(o, v);
+	HitRecord rec;
+	uint32_t first_light = 0;
+	bool found = TraverseLinearBVH(bvh.nodes, r, 0.001, t_max, [&](uint32_t first, uint32_t count, double& closest) {
+		bool hit_leaf = false;
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			if (bvh.primitives[i]->Hit(r, 0.001, closest, rec))
+			{
+				closest = rec.t;
+				first_light = i;
+				hit_leaf = true;
+			}
+		}
+		return hit_leaf;
+	});
+	return found ? pick[first_light] * bvh.primitives[first_light]->PDFValue(o, v) : 0;
+}
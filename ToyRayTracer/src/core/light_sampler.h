@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+
+#include "./math.h"
+#include "./hittable.h"
+#include "./bvh.h"
+#include "./material_table.h"
+
+// a point on a light sampled from o
+struct LightSample
+{
+	Vec3 direction;		// from o to the point, not normalized
+	double t;			// of the point along direction, a shadow ray has to end before it
+	double pdf;			// solid angle pdf of the direction
+	Color emitted;		// towards o
+};
+
+// The lights of a scene as seen by next event estimation. Lights that emit are picked in
+// proportion to their power (area times mean emission) and a direction is sampled towards
+// a point on the picked one, which only counts if no other surface, including another
+// light, is in between. The pdf of a direction is that of the first light the ray
+// reaches, which a bvh over the lights finds without a Hit per light.
+// Lights that don't emit, like a glass ball sampled for its caustics, are kept as guides
+// for the bsdf sampling of the next bounce instead.
+class LightSampler
+{
+public:
+	// world is the scene the lights are in, an entry of lights without an emitting
+	// material of its own takes the emission of the world's surface it lies on. materials
+	// is the scene's table, it has to outlive the sampler.
+	LightSampler(const HittableList* lights, const Hittable& world, const MaterialTable& materials);
+
+	bool Empty() const { return bvh.primitives.empty(); }
+
+	// sample a point on a light picked by power, false when there is no light to reach
+	bool Sample(const Point3& o, double time, LightSample& sample) const;
+
+	// Solid angle pdf of Sample returning direction v from o. Only a light the ray o + t v
+	// reaches before t_max counts: for a ray that stopped at t_max on an emitter which is
+	// not one of the lights, the pdf is 0, as no sample could have got past that surface.
+	double PDFValue(const Point3& o, const Vec3& v, double t_max = INF) const;
+
+public:
+	// the material a light is shaded with where a ray hits it
+	struct Emitter
+	{
+		MaterialID mat_id = NO_MATERIAL;	// of the world's surface below the light, NO_MATERIAL for the light's own
+		bool flip = false;					// that surface faces the other way than the light
+	};
+
+	const MaterialTable& materials;
+	LinearBVH bvh;					// over the emitting lights
+	std::vector<double> pick;		// probability of each light, in bvh.primitives order
+	std::vector<double> cdf;		// running sum of pick
+	std::vector<Emitter> emitters;	// in bvh.primitives order
+	HittableList guides;
+};
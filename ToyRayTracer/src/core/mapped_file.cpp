@@ -0,0 +1,123 @@
+#include "./mapped_file.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ---MappedFile---
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+	: data(nullptr), size(0), file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr) {}
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "ERROR: could not open '" << path << "'\n";
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+	{
+		std::cerr << "ERROR: '" << path << "' is empty\n";
+		Close();
+		return false;
+	}
+
+	mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle)
+		data = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if (!data)
+	{
+		std::cerr << "ERROR: could not map '" << path << "'\n";
+		Close();
+		return false;
+	}
+
+	size = static_cast<size_t>(file_size.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	if (file_handle != INVALID_HANDLE_VALUE)
+		CloseHandle(file_handle);
+
+	data = nullptr;
+	size = 0;
+	mapping_handle = nullptr;
+	file_handle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile() : data(nullptr), size(0) {}
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		std::cerr << "ERROR: could not open '" << path << "'\n";
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		std::cerr << "ERROR: '" << path << "' is empty\n";
+		close(fd);
+		return false;
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		std::cerr << "ERROR: could not map '" << path << "'\n";
+		return false;
+	}
+
+	data = static_cast<const unsigned char*>(mapped);
+	size = static_cast<size_t>(st.st_size);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		munmap(const_cast<unsigned char*>(data), size);
+
+	data = nullptr;
+	size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
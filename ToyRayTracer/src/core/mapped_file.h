@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read only view of a whole file mapped into memory. Pages are loaded by the os when they
+// are first touched, so opening a large file costs next to nothing and a file that was
+// read recently comes straight from the page cache.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// map path, errors are reported on std::cerr and return false
+	bool Open(const std::string& path);
+	void Close();
+
+	const unsigned char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	void* file_handle;
+	void* mapping_handle;
+#endif
+};
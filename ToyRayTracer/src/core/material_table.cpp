@@ -0,0 +1,24 @@
+#include "./material_table.h"
+
+// ---MaterialTable---
+
+MaterialTable::MaterialTable()
+{
+	// slot 0 is NO_MATERIAL
+	materials.push_back(nullptr);
+	lookup.push_back(nullptr);
+	ids[nullptr] = NO_MATERIAL;
+}
+
+MaterialID MaterialTable::Add(shared_ptr<Material> m)
+{
+	auto found = ids.find(m.get());
+	if (found != ids.end())
+		return found->second;
+
+	MaterialID id = static_cast<MaterialID>(lookup.size());
+	ids[m.get()] = id;
+	lookup.push_back(m.get());
+	materials.push_back(m);
+	return id;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cassert>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "./hittable.h"
+#include "./materials.h"
+
+// The materials of a scene, shapes keep the id of their material instead of a shared_ptr
+// so a hit only copies a 32-bit id and never touches a refcount shared by all threads.
+// Each Scene owns its table, the ids of its shapes only mean something in it. Fill it
+// while building the scene, it must not change once rendering has started.
+class MaterialTable
+{
+public:
+	MaterialTable();
+
+	// the id of m, m is added the first time it is seen, a null material gets NO_MATERIAL
+	MaterialID Add(shared_ptr<Material> m);
+
+	// an id from another table or a corrupt cache stops debug builds here
+	inline const Material* Get(MaterialID id) const
+	{
+		assert(id < lookup.size());
+		return lookup[id];
+	}
+	size_t Size() const { return lookup.size(); }
+
+private:
+	std::vector<shared_ptr<Material>> materials;
+	std::vector<const Material*> lookup;	// same as materials, without the control blocks
+	std::unordered_map<const Material*, MaterialID> ids;
+};
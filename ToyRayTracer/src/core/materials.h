@@ -9,7 +9,7 @@ struct ScatterRecord {
 	Ray specular_ray;
 	bool is_specular;
 	Color attenuation;
-	shared_ptr<PDF> pdf_ptr;
+	CosPDF pdf;		// diffuse sampling pdf, held by value so scattering never allocates
 };
 
 class Material {
@@ -43,7 +43,7 @@ public:
 	{
 		srec.is_specular = false;
 		srec.attenuation = albedo->Value(rec.u, rec.v, rec.p);
-		srec.pdf_ptr = make_shared<CosPDF>(rec.normal);
+		srec.pdf = CosPDF(rec.normal);
 		return true;
 	}
 
@@ -67,10 +67,9 @@ public:
 	) const override 
 	{
 		Vec3 reflected = Reflect(UnitVector(r_in.Direction()), rec.normal);
-		srec.specular_ray = Ray(rec.p, reflected + fuzz * random_in_unit_sphere());
+		srec.specular_ray = Ray(rec.p, reflected + fuzz * random_in_unit_sphere(), r_in.Time());
 		srec.attenuation = albedo;
 		srec.is_specular = true;
-		srec.pdf_ptr = nullptr;
 		return true;
 	}
 public:
@@ -88,7 +87,6 @@ public:
 	) const override
 	{
 		srec.is_specular = true;
-		srec.pdf_ptr = nullptr;
 		srec.attenuation = Color(1.0, 1.0, 1.0);
 		double refraction_ratio = rec.is_front_face ? (1.0 / ir) : ir;
 
@@ -105,7 +103,7 @@ public:
 		else
 			direction = Refract(unit_direction, rec.normal, refraction_ratio);
 
-		srec.specular_ray = Ray(rec.p, direction);
+		srec.specular_ray = Ray(rec.p, direction, r_in.Time());
 		return true;
 	}
 
@@ -153,9 +151,8 @@ public:
 		const Ray& r_in, const HitRecord& rec, ScatterRecord& srec
 	) const override {
 		srec.is_specular = true;
-		srec.specular_ray = Ray(rec.p, random_in_unit_sphere());
+		srec.specular_ray = Ray(rec.p, random_in_unit_sphere(), r_in.Time());
 		srec.attenuation = albedo->Value(rec.u, rec.v, rec.p);
-		srec.pdf_ptr = nullptr;
 		return true;
 	}
 
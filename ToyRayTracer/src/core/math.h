@@ -4,54 +4,118 @@
 #include <limits>
 #include <memory>
 
+#include "./sampler.h"
+#include "./simd.h"
+
 // Usings
 using std::shared_ptr;
 using std::make_shared;
 using std::sqrt;
 
+// Scalar of the geometry and shading types. Vec3 (points, directions, colors), rays, hit
+// records and boxes hold doubles, or floats when the renderer is built with TOYRT_FLOAT
+// defined: half the memory and twice the values per simd register.
+#ifdef TOYRT_FLOAT
+typedef float Real;
+#else
+typedef double Real;
+#endif
+
 // Constants
 const double INF = std::numeric_limits<double>::infinity();
 const double PI = 3.1415926535897932385;
 
-class Vec3
+// A float Vec3 is padded to the four lanes of a 16 byte simd register, its arithmetic then
+// runs on sse (x86) or neon (arm). Doubles would need two registers for three values, they
+// stay three scalars like every other build.
+#if defined(TOYRT_FLOAT) && TOYRT_X86
+#define TOYRT_VEC3_SSE 1
+#elif defined(TOYRT_FLOAT) && (defined(__ARM_NEON) || defined(_M_ARM64))
+#define TOYRT_VEC3_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if TOYRT_VEC3_SSE || TOYRT_VEC3_NEON
+#define TOYRT_VEC3_LANES 4
+#else
+#define TOYRT_VEC3_LANES 3
+#endif
+
+class alignas(TOYRT_VEC3_LANES == 4 ? 16 : alignof(Real)) Vec3
 {
 public:
-	Vec3();
-	Vec3(double e0, double e1, double e2);
-
-	double x() const;
-	double y() const;
-	double z() const;
+	Vec3() : e{ 0, 0, 0 } {}
+	Vec3(Real e0, Real e1, Real e2) : e{ e0, e1, e2 } {}
 
+	Real x() const { return e[0]; }
+	Real y() const { return e[1]; }
+	Real z() const { return e[2]; }
 
 	Vec3 operator-() const;
-	double operator[](int i) const;
-	double& operator[](int i);
+	Real operator[](int i) const { return e[i]; }
+	Real& operator[](int i) { return e[i]; }
 
 	Vec3& operator+=(const Vec3 &v);
-	Vec3& operator*=(const double t);
-	Vec3& operator/=(const double t);
+	Vec3& operator*=(const Real t);
+	Vec3& operator/=(const Real t) { return *this *= 1 / t; }
 
-	double Length() const;
-	double LengthSquared() const;
+	Real LengthSquared() const { return e[0] * e[0] + e[1] * e[1] + e[2] * e[2]; }
+	Real Length() const { return sqrt(LengthSquared()); }
 
 	static Vec3 Random();
 	static Vec3 Random(double min, double max);
 
 public:
-	double e[3];
+	Real e[TOYRT_VEC3_LANES];	// a padded vector keeps 0 in its last lane
 };
 
 // Type aliases for Vec3
 using Point3 = Vec3;   // 3D point
 using Color = Vec3;    // RGB color
 
+// the lanes of a padded Vec3, unaligned loads so vectors in any allocation work
+#if TOYRT_VEC3_SSE
+typedef __m128 Vec3Lanes;
+inline Vec3Lanes LoadLanes(const Vec3& v) { return _mm_loadu_ps(v.e); }
+inline Vec3 StoreLanes(Vec3Lanes a) { Vec3 v; _mm_storeu_ps(v.e, a); return v; }
+inline Vec3Lanes AddLanes(Vec3Lanes a, Vec3Lanes b) { return _mm_add_ps(a, b); }
+inline Vec3Lanes SubLanes(Vec3Lanes a, Vec3Lanes b) { return _mm_sub_ps(a, b); }
+inline Vec3Lanes MulLanes(Vec3Lanes a, Vec3Lanes b) { return _mm_mul_ps(a, b); }
+inline Vec3Lanes SplatLanes(float t) { return _mm_set1_ps(t); }
+inline Vec3Lanes NegLanes(Vec3Lanes a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+#elif TOYRT_VEC3_NEON
+typedef float32x4_t Vec3Lanes;
+inline Vec3Lanes LoadLanes(const Vec3& v) { return vld1q_f32(v.e); }
+inline Vec3 StoreLanes(Vec3Lanes a) { Vec3 v; vst1q_f32(v.e, a); return v; }
+inline Vec3Lanes AddLanes(Vec3Lanes a, Vec3Lanes b) { return vaddq_f32(a, b); }
+inline Vec3Lanes SubLanes(Vec3Lanes a, Vec3Lanes b) { return vsubq_f32(a, b); }
+inline Vec3Lanes MulLanes(Vec3Lanes a, Vec3Lanes b) { return vmulq_f32(a, b); }
+inline Vec3Lanes SplatLanes(float t) { return vdupq_n_f32(t); }
+inline Vec3Lanes NegLanes(Vec3Lanes a) { return vnegq_f32(a); }
+#endif
+
+#if TOYRT_VEC3_LANES == 4
+inline Vec3 Vec3::operator-() const { return StoreLanes(NegLanes(LoadLanes(*this))); }
+inline Vec3& Vec3::operator+=(const Vec3 &v) { return *this = StoreLanes(AddLanes(LoadLanes(*this), LoadLanes(v))); }
+inline Vec3& Vec3::operator*=(const Real t) { return *this = StoreLanes(MulLanes(LoadLanes(*this), SplatLanes(t))); }
+#else
+inline Vec3 Vec3::operator-() const { return Vec3(-e[0], -e[1], -e[2]); }
+inline Vec3& Vec3::operator+=(const Vec3 &v) { e[0] += v.e[0]; e[1] += v.e[1]; e[2] += v.e[2]; return *this; }
+inline Vec3& Vec3::operator*=(const Real t) { e[0] *= t; e[1] *= t; e[2] *= t; return *this; }
+#endif
+
 // Vec3 Utility Functions
 inline std::ostream& operator<<(std::ostream &out, const Vec3 &v)
 {
 	return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
+#if TOYRT_VEC3_LANES == 4
+inline Vec3 operator+(const Vec3 &u, const Vec3 &v) { return StoreLanes(AddLanes(LoadLanes(u), LoadLanes(v))); }
+inline Vec3 operator-(const Vec3 &u, const Vec3 &v) { return StoreLanes(SubLanes(LoadLanes(u), LoadLanes(v))); }
+inline Vec3 operator*(const Vec3 &u, const Vec3 &v) { return StoreLanes(MulLanes(LoadLanes(u), LoadLanes(v))); }
+inline Vec3 operator*(Real t, const Vec3 &v) { return StoreLanes(MulLanes(SplatLanes(t), LoadLanes(v))); }
+#else
 inline Vec3 operator+(const Vec3 &u, const Vec3 &v)
 {
 	return Vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
@@ -67,22 +131,23 @@ inline Vec3 operator*(const Vec3 &u, const Vec3 &v)
 	return Vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
 }
 
-inline Vec3 operator*(double t, const Vec3 &v)
+inline Vec3 operator*(Real t, const Vec3 &v)
 {
 	return Vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
 }
+#endif
 
-inline Vec3 operator*(const Vec3 &v, double t)
+inline Vec3 operator*(const Vec3 &v, Real t)
 {
 	return t * v;
 }
 
-inline Vec3 operator/(Vec3 v, double t)
+inline Vec3 operator/(Vec3 v, Real t)
 {
 	return (1 / t) * v;
 }
 
-inline double DotProduct(const Vec3 &u, const Vec3 &v)
+inline Real DotProduct(const Vec3 &u, const Vec3 &v)
 {
 	return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
 }
@@ -104,7 +169,7 @@ inline Vec3 Reflect(const Vec3& v, const Vec3& n)
 	return v - 2 * DotProduct(v, n)*n;
 }
 
-inline Vec3 Refract(const Vec3& in, const Vec3& n, double etai_over_etat)
+inline Vec3 Refract(const Vec3& in, const Vec3& n, Real etai_over_etat)
 {
 	auto cos_theta = fmin(DotProduct(-in, n), 1.0);
 	Vec3 r_out_perp = etai_over_etat * (in + cos_theta * n);
@@ -121,7 +186,7 @@ inline double DegreesToRadians(double degrees)
 inline double RandomDouble()
 {
 	// Returns a random real in [0,1).
-	return rand() / (RAND_MAX + 1.0);
+	return ThreadSampler().NextDouble();
 }
 
 inline double RandomDouble(double min, double max)
@@ -130,6 +195,9 @@ inline double RandomDouble(double min, double max)
 	return min + (max - min)*RandomDouble();
 }
 
+inline Vec3 Vec3::Random() { return Vec3(RandomDouble(), RandomDouble(), RandomDouble()); }
+inline Vec3 Vec3::Random(double min, double max) { return Vec3(RandomDouble(min, max), RandomDouble(min, max), RandomDouble(min, max)); }
+
 inline int RandomInt(int min, int max)
 {
 	// Returns a random integer in [min,max].
@@ -0,0 +1,279 @@
+#include "./obj_loader.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	const size_t CHUNK_SIZE = 1 << 20;
+
+	// Hands out the lines of a file without loading all of it, a line may not be longer
+	// than a chunk.
+	class LineReader
+	{
+	public:
+		LineReader(const std::string& path)
+			: file(std::fopen(path.c_str(), "rb")), buffer(CHUNK_SIZE), begin(0), end(0), too_long(false) {}
+		~LineReader() { if (file) std::fclose(file); }
+
+		bool IsOpen() const { return file != nullptr; }
+		bool LineTooLong() const { return too_long; }
+
+		// [line, line_end) is the next line without its line break
+		bool Next(const char*& line, const char*& line_end)
+		{
+			while (true)
+			{
+				const char* start = buffer.data() + begin;
+				const char* stop = buffer.data() + end;
+				const char* newline = static_cast<const char*>(std::memchr(start, '\n', stop - start));
+				if (newline)
+				{
+					line = start;
+					line_end = newline;
+					begin = newline + 1 - buffer.data();
+					return true;
+				}
+
+				// move the partial line to the front and read more behind it
+				size_t rest = end - begin;
+				std::memmove(buffer.data(), start, rest);
+				begin = 0;
+				end = rest;
+				size_t got = file ? std::fread(buffer.data() + end, 1, buffer.size() - end, file) : 0;
+				end += got;
+				if (got == 0)
+				{
+					too_long = rest == buffer.size();
+					// last line without a line break
+					if (end == 0 || too_long)
+						return false;
+					line = buffer.data();
+					line_end = buffer.data() + end;
+					begin = end;
+					return true;
+				}
+			}
+		}
+
+	private:
+		FILE* file;
+		std::vector<char> buffer;
+		size_t begin;
+		size_t end;
+		bool too_long;
+	};
+
+	inline const char* SkipSpace(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+			++p;
+		return p;
+	}
+
+	// plain decimal float parser, several times faster than strtod and locale independent
+	bool ParseFloat(const char*& p, const char* end, float& value)
+	{
+		p = SkipSpace(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		double mantissa = 0.0;
+		int exponent = 0;
+		bool digits = false;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			mantissa = mantissa * 10.0 + (*p++ - '0');
+			digits = true;
+		}
+		if (p < end && *p == '.')
+		{
+			++p;
+			while (p < end && *p >= '0' && *p <= '9')
+			{
+				mantissa = mantissa * 10.0 + (*p++ - '0');
+				--exponent;
+				digits = true;
+			}
+		}
+		if (!digits)
+			return false;
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			bool negative_exponent = false;
+			if (p < end && (*p == '-' || *p == '+'))
+				negative_exponent = *p++ == '-';
+			int e = 0;
+			while (p < end && *p >= '0' && *p <= '9')
+				e = e * 10 + (*p++ - '0');
+			exponent += negative_exponent ? -e : e;
+		}
+
+		value = static_cast<float>((negative ? -mantissa : mantissa) * std::pow(10.0, exponent));
+		return true;
+	}
+
+	bool ParseInt(const char*& p, const char* end, long& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+		if (p == end || *p < '0' || *p > '9')
+			return false;
+		long v = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+			v = v * 10 + (*p++ - '0');
+		value = negative ? -v : v;
+		return true;
+	}
+
+	// obj indices start at 1, negative ones count back from the last element read
+	inline bool ResolveIndex(long index, size_t count, uint32_t& resolved)
+	{
+		long i = index > 0 ? index - 1 : static_cast<long>(count) + index;
+		if (index == 0 || i < 0 || i >= static_cast<long>(count))
+			return false;
+		resolved = static_cast<uint32_t>(i);
+		return true;
+	}
+
+	struct FaceCorner
+	{
+		uint32_t position;
+		uint32_t uv;
+		uint32_t normal;
+	};
+}
+
+bool LoadOBJ(const std::string& path, MeshData& mesh)
+{
+	LineReader reader(path);
+	if (!reader.IsOpen())
+	{
+		std::cerr << "ERROR: Could not open obj file '" << path << "'.\n";
+		return false;
+	}
+
+	std::vector<FaceCorner> face;
+	const char* line;
+	const char* end;
+	size_t line_number = 0;
+
+	auto fail = [&](const char* what) {
+		std::cerr << "ERROR: " << path << ":" << line_number << ": " << what << "\n";
+		return false;
+	};
+
+	while (reader.Next(line, end))
+	{
+		++line_number;
+		const char* p = SkipSpace(line, end);
+		if (p == end || *p == '#')
+			continue;
+
+		if (p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			p += 2;
+			float x, y, z;
+			if (!ParseFloat(p, end, x) || !ParseFloat(p, end, y) || !ParseFloat(p, end, z))
+				return fail("bad vertex");
+			mesh.px.push_back(x);
+			mesh.py.push_back(y);
+			mesh.pz.push_back(z);
+		}
+		else if (p + 2 < end && p[0] == 'v' && p[1] == 'n')
+		{
+			p += 2;
+			float x, y, z;
+			if (!ParseFloat(p, end, x) || !ParseFloat(p, end, y) || !ParseFloat(p, end, z))
+				return fail("bad normal");
+			mesh.nx.push_back(x);
+			mesh.ny.push_back(y);
+			mesh.nz.push_back(z);
+		}
+		else if (p + 2 < end && p[0] == 'v' && p[1] == 't')
+		{
+			p += 2;
+			float u, v = 0.0f;
+			if (!ParseFloat(p, end, u))
+				return fail("bad texture coordinate");
+			ParseFloat(p, end, v);
+			mesh.u.push_back(u);
+			mesh.v.push_back(v);
+		}
+		else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			// corners are v, v/vt, v//vn or v/vt/vn
+			p += 2;
+			face.clear();
+			while ((p = SkipSpace(p, end)) < end)
+			{
+				FaceCorner corner = { 0, NO_INDEX, NO_INDEX };
+				long index;
+				if (!ParseInt(p, end, index) || !ResolveIndex(index, mesh.px.size(), corner.position))
+					return fail("bad face vertex index");
+				if (p < end && *p == '/')
+				{
+					++p;
+					if (p < end && *p != '/')
+					{
+						if (!ParseInt(p, end, index) || !ResolveIndex(index, mesh.u.size(), corner.uv))
+							return fail("bad face texture index");
+					}
+					if (p < end && *p == '/')
+					{
+						++p;
+						if (!ParseInt(p, end, index) || !ResolveIndex(index, mesh.nx.size(), corner.normal))
+							return fail("bad face normal index");
+					}
+				}
+				face.push_back(corner);
+			}
+			if (face.size() < 3)
+				return fail("face with less than 3 vertices");
+
+			// the uv and normal arrays only exist once some face uses them
+			for (const auto& corner : face)
+			{
+				if (corner.uv != NO_INDEX && mesh.uv_index.empty())
+					mesh.uv_index.assign(mesh.position_index.size(), NO_INDEX);
+				if (corner.normal != NO_INDEX && mesh.normal_index.empty())
+					mesh.normal_index.assign(mesh.position_index.size(), NO_INDEX);
+			}
+
+			for (size_t k = 1; k + 1 < face.size(); ++k)
+			{
+				const FaceCorner* triangle[3] = { &face[0], &face[k], &face[k + 1] };
+				for (auto corner : triangle)
+				{
+					mesh.position_index.push_back(corner->position);
+					if (!mesh.uv_index.empty())
+						mesh.uv_index.push_back(corner->uv);
+					if (!mesh.normal_index.empty())
+						mesh.normal_index.push_back(corner->normal);
+				}
+			}
+		}
+	}
+
+	if (reader.LineTooLong())
+		return fail("line too long");
+	if (mesh.position_index.empty())
+	{
+		std::cerr << "ERROR: No faces in obj file '" << path << "'.\n";
+		return false;
+	}
+	return true;
+}
+
+shared_ptr<TriangleMesh> LoadOBJMesh(const std::string& path, MaterialID m)
+{
+	MeshData mesh;
+	if (!LoadOBJ(path, mesh))
+		return nullptr;
+	return make_shared<TriangleMesh>(std::move(mesh), m);
+}
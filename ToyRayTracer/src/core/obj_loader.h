@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+
+#include "./triangle_mesh.h"
+
+// Read the v/vt/vn/f records of a wavefront obj file into mesh, polygons are split into
+// triangle fans and everything else (groups, materials, smoothing) is ignored. The file is
+// parsed in fixed size chunks, so memory only grows with the mesh itself.
+// Errors are reported on std::cerr and return false.
+bool LoadOBJ(const std::string& path, MeshData& mesh);
+
+// the obj file as a single mesh with material m, nullptr if it couldn't be read
+shared_ptr<TriangleMesh> LoadOBJMesh(const std::string& path, MaterialID m);
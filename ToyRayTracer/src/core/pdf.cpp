@@ -18,7 +18,7 @@ Vec3 CosPDF::Generate() const
 
 // ---HittablePDF---
 // use the hittable object to help calcualte pdf and sample direction
-HittablePDF::HittablePDF(shared_ptr<Hittable> p, const Point3& origin) : ptr(p), o(origin) {}
+HittablePDF::HittablePDF(const Hittable* p, const Point3& origin) : ptr(p), o(origin) {}
 
 double HittablePDF::Value(const Vec3& direction) const
 {
@@ -16,6 +16,7 @@ public:
 class CosPDF : public PDF 
 {
 public:
+	CosPDF() {}
 	CosPDF(const Vec3& w);
 
 	// pdf value
@@ -28,9 +29,11 @@ public:
 	ONB uvw;
 };
 
+// pdfs are built on the stack for every bounce, so they only point at what they sample
+// and never own it, keeping the hot loop free of allocations and refcount traffic
 class HittablePDF : public PDF {
 public:
-	HittablePDF(shared_ptr<Hittable> p, const Point3& origin);
+	HittablePDF(const Hittable* p, const Point3& origin);
 
 	virtual double Value(const Vec3& direction) const override;
 
@@ -38,12 +41,12 @@ public:
 
 public:
 	Point3 o;
-	shared_ptr<Hittable> ptr;
+	const Hittable* ptr;
 };
 
 class MixturePDF : public PDF {
 public:
-	MixturePDF(shared_ptr<PDF> p0, shared_ptr<PDF> p1) {
+	MixturePDF(const PDF* p0, const PDF* p1) {
 		p[0] = p0;
 		p[1] = p1;
 	}
@@ -61,5 +64,5 @@ public:
 	}
 
 public:
-	shared_ptr<PDF> p[2];
+	const PDF* p[2];
 };
\ No newline at end of file
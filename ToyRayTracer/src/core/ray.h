@@ -4,14 +4,16 @@
 class Ray
 {
 public:
-	Ray();
-	Ray(const Point3& origin, const Vec3& direction);
+	Ray() : tm(0) {}
+	Ray(const Point3& origin, const Vec3& direction, Real time = 0) : orig(origin), dir(direction), tm(time) {}
 
-	Point3 Origin() const ;
-	Vec3 Direction() const;
-	Point3 At(double t) const;
+	const Point3& Origin() const { return orig; }
+	const Vec3& Direction() const { return dir; }
+	Real Time() const { return tm; }
+	Point3 At(Real t) const { return orig + t * dir; }
 
 public:
 	Point3 orig;
 	Vec3 dir;
-};
\ No newline at end of file
+	Real tm;	// when the ray is traced, in frames, moving objects are hit where they are then
+};
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+#include "./ray.h"
+
+// number of rays traced together, one bit per ray in the packet masks
+const int PACKET_SIZE = 8;
+
+// a group of coherent rays (the camera samples of one pixel) intersected together, so the
+// bvh nodes they visit are loaded once for the whole group
+struct RayPacket
+{
+	Ray rays[PACKET_SIZE];
+	int size = 0;
+
+	uint32_t FullMask() const { return (1u << size) - 1; }
+};
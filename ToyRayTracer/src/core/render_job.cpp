@@ -0,0 +1,201 @@
+#include "./render_job.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "./scene_cache.h"
+#include "./scene_file.h"
+
+namespace
+{
+	// modification time of path, 0 if it doesn't exist
+	time_t ModifiedTime(const std::string& path)
+	{
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			return 0;
+		return info.st_mtime;
+	}
+
+	std::string SceneKey(const RenderJob& job)
+	{
+		if (!job.cache_path.empty())
+			return "cache:" + job.cache_path;
+		if (!job.scene_path.empty())
+			return "scene:" + job.scene_path;
+		return "builtin:" + std::to_string(job.builtin_scene);
+	}
+}
+
+bool ParseJobArguments(const std::vector<std::string>& args, RenderJob& job)
+{
+	for (size_t a = 0; a < args.size(); ++a)
+	{
+		const std::string& arg = args[a];
+		if (arg.compare(0, 2, "--") != 0 || a + 1 == args.size())
+		{
+			std::cerr << "ERROR: bad argument '" << arg << "'\n";
+			return false;
+		}
+
+		const std::string& value = args[++a];
+		if (arg == "--scene")
+			job.scene_path = value;
+		else if (arg == "--builtin")
+			job.builtin_scene = std::atoi(value.c_str());
+		else if (arg == "--cache")
+			job.cache_path = value;
+		else if (arg == "--write-cache")
+			job.write_cache_path = value;
+		else
+		{
+			std::string name = arg.substr(2);
+			std::replace(name.begin(), name.end(), '-', '_');
+			job.options.emplace_back(name, value);
+		}
+	}
+	return true;
+}
+
+bool SplitJobLine(const std::string& line, std::vector<std::string>& args)
+{
+	args.clear();
+	std::string arg;
+	bool in_arg = false, quoted = false;
+	for (char c : line)
+	{
+		if (c == '"')
+		{
+			quoted = !quoted;
+			in_arg = true;
+		}
+		else if (!quoted && (c == ' ' || c == '\t' || c == '\r' || c == '\n'))
+		{
+			if (in_arg)
+				args.push_back(arg);
+			arg.clear();
+			in_arg = false;
+		}
+		else
+		{
+			arg += c;
+			in_arg = true;
+		}
+	}
+	if (in_arg)
+		args.push_back(arg);
+
+	if (quoted)
+		std::cerr << "ERROR: unbalanced quotes in '" << line << "'\n";
+	return !quoted;
+}
+
+bool ApplyJobOptions(const RenderJob& job, RenderSettings& settings, CameraSettings& camera)
+{
+	for (const auto& option : job.options)
+	{
+		bool ok = IsCameraOption(option.first) ? SetCameraOption(camera, option.first, option.second)
+			: SetRenderOption(settings, option.first, option.second);
+		if (!ok)
+			return false;
+	}
+	return true;
+}
+
+std::string FrameOutputPath(const std::string& path, int frame)
+{
+	char number[16];
+	snprintf(number, sizeof(number), "_%04d", frame);
+
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		dot = path.size();
+	return path.substr(0, dot) + number + path.substr(dot);
+}
+
+// ---SceneLibrary---
+
+bool SceneLibrary::LoadFresh(const RenderJob& job, Scene& scene, RenderSettings& settings) const
+{
+	if (!job.cache_path.empty())
+		return LoadSceneCache(job.cache_path, scene);
+	if (!job.scene_path.empty())
+		return LoadSceneFile(job.scene_path, scene, settings);
+	return build_builtin && build_builtin(job.builtin_scene, scene);
+}
+
+LoadedScene* SceneLibrary::Get(const RenderJob& job, bool& cached)
+{
+	const std::string key = SceneKey(job);
+	const std::string& path = !job.cache_path.empty() ? job.cache_path : job.scene_path;
+	const time_t modified = path.empty() ? 0 : ModifiedTime(path);
+
+	auto found = scenes.find(key);
+	cached = found != scenes.end() && found->second->modified == modified;
+	if (cached)
+	{
+		found->second->last_used = ++uses;
+		return found->second.get();
+	}
+
+	// the scene being replaced stays alive until the new one is loaded, their images are shared
+	std::unique_ptr<LoadedScene> loaded(new LoadedScene());
+	loaded->modified = modified;
+
+	auto load_start = std::chrono::steady_clock::now();
+	if (!LoadFresh(job, loaded->scene, loaded->settings))
+		return nullptr;
+	loaded->load_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+
+	loaded->last_used = ++uses;
+	auto& entry = scenes[key];
+	entry = std::move(loaded);
+	LoadedScene* result = entry.get();
+	Evict(result);
+	return result;
+}
+
+void SceneLibrary::Evict(const LoadedScene* keep)
+{
+	while (capacity > 0 && scenes.size() > capacity)
+	{
+		auto oldest = scenes.end();
+		for (auto it = scenes.begin(); it != scenes.end(); ++it)
+		{
+			if (it->second.get() != keep && (oldest == scenes.end() || it->second->last_used < oldest->second->last_used))
+				oldest = it;
+		}
+		if (oldest == scenes.end())
+			return;
+		scenes.erase(oldest);
+	}
+}
+
+bool SceneLibrary::Prepare(const RenderJob& job, LoadedScene& loaded, bool motion_blur, bool& cached) const
+{
+	if (loaded.accel && loaded.motion_blur == motion_blur)
+		return true;
+
+	cached = false;
+	if (loaded.accel)
+	{
+		auto load_start = std::chrono::steady_clock::now();
+		loaded.accel.reset();
+		loaded.scene = Scene();
+		if (!LoadFresh(job, loaded.scene, loaded.settings))
+			return false;
+		loaded.load_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+	}
+
+	auto accel_start = std::chrono::steady_clock::now();
+	loaded.accel.reset(new SceneAccel(loaded.scene.world, loaded.scene.animation.Targets(), motion_blur));
+	loaded.motion_blur = motion_blur;
+	loaded.accel_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - accel_start).count();
+	return true;
+}
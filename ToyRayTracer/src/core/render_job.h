@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./scene.h"
+#include "./scene_accel.h"
+#include "./render_settings.h"
+
+// One image to render: where the scene comes from and the options set over the scene
+// file's own (render options and camera options, see SetRenderOption and SetCameraOption).
+struct RenderJob
+{
+	std::string scene_path;		// json scene file
+	int builtin_scene = 1;		// used when no scene file or cache is given
+	std::string cache_path;		// scene cache written by WriteSceneCache
+	std::string write_cache_path;	// store the scene in a cache instead of rendering
+	std::vector<std::pair<std::string, std::string>> options;
+};
+
+// Read a job from arguments of the form --NAME VALUE (see the usage in main), '-' in
+// names becomes '_'. Errors are reported on std::cerr and return false.
+bool ParseJobArguments(const std::vector<std::string>& args, RenderJob& job);
+
+// Split a job line into arguments at whitespace, "double quotes" keep spaces.
+// Returns false for unbalanced quotes.
+bool SplitJobLine(const std::string& line, std::vector<std::string>& args);
+
+// Settings and camera of job: the scene's own, then the job's options. Errors are reported
+// on std::cerr and return false.
+bool ApplyJobOptions(const RenderJob& job, RenderSettings& settings, CameraSettings& camera);
+
+// path with the frame number before the extension, image/res.ppm becomes image/res_0012.ppm
+std::string FrameOutputPath(const std::string& path, int frame);
+
+// A scene as loaded for rendering, with its acceleration structure once it is prepared.
+struct LoadedScene
+{
+	Scene scene;
+	RenderSettings settings;	// defaults with the scene file's "render" block
+	std::unique_ptr<SceneAccel> accel;
+	bool motion_blur = false;	// accel was built for motion blur
+	time_t modified = 0;		// of the scene file or cache
+	uint64_t last_used = 0;		// SceneLibrary's count of Get calls when this scene was last returned
+	double load_time = 0;		// seconds
+	double accel_time = 0;
+};
+
+// how many scenes a SceneLibrary keeps loaded unless it is told otherwise
+const size_t DEFAULT_KEPT_SCENES = 4;
+
+// Scenes kept loaded between render jobs. A job for a scene that was loaded before reuses
+// its geometry, textures and acceleration structure unless the file has changed since.
+// No more than kept scenes stay loaded (0 for no limit), loading another frees the one
+// used longest ago. A replaced or dropped scene is freed with its materials and textures.
+class SceneLibrary
+{
+public:
+	typedef std::function<bool(int, Scene&)> BuiltinBuilder;
+
+	explicit SceneLibrary(BuiltinBuilder builtin, size_t kept = DEFAULT_KEPT_SCENES)
+		: build_builtin(builtin), capacity(kept), uses(0) {}
+
+	// The scene of job, nullptr if it can't be loaded (reported on std::cerr). cached is
+	// set when a loaded scene was reused. An animated scene is left at whatever frame was
+	// rendered last. The scene stays valid until the next call.
+	LoadedScene* Get(const RenderJob& job, bool& cached);
+
+	// Build the acceleration structure of a scene from Get, unless it has one for the same
+	// motion_blur already (cached stays set then). SceneAccel builds its bvhs into the
+	// scene's world, so a scene whose accel was built for the other mode is loaded again first.
+	bool Prepare(const RenderJob& job, LoadedScene& loaded, bool motion_blur, bool& cached) const;
+
+	// Load the scene of job without keeping it, e.g. to write a cache (a kept scene has
+	// the bvhs of its SceneAccel in its world, which can't be written).
+	bool LoadFresh(const RenderJob& job, Scene& scene, RenderSettings& settings) const;
+
+	void Clear() { scenes.clear(); }
+	size_t Size() const { return scenes.size(); }
+	size_t Capacity() const { return capacity; }
+
+private:
+	// free the scenes used longest ago until there are at most capacity, keep stays
+	void Evict(const LoadedScene* keep);
+
+private:
+	BuiltinBuilder build_builtin;
+	size_t capacity;
+	uint64_t uses;
+	std::map<std::string, std::unique_ptr<LoadedScene>> scenes;
+};
@@ -0,0 +1,183 @@
+#include "./render_settings.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+	bool ParseInt(const std::string& text, int min_value, int& value)
+	{
+		if (text.empty())
+			return false;
+		errno = 0;
+		char* end = nullptr;
+		long parsed = std::strtol(text.c_str(), &end, 10);
+		if (*end != '\0' || errno != 0 || parsed < min_value || parsed > 1000000000L)
+			return false;
+		value = static_cast<int>(parsed);
+		return true;
+	}
+
+	bool ParseDouble(const std::string& text, double& value)
+	{
+		if (text.empty())
+			return false;
+		char* end = nullptr;
+		double parsed = std::strtod(text.c_str(), &end);
+		if (*end != '\0' || !(parsed >= 0) || parsed == HUGE_VAL)
+			return false;
+		value = parsed;
+		return true;
+	}
+
+	// any number, for positions
+	bool ParseCoordinate(const std::string& text, double& value)
+	{
+		if (text.empty())
+			return false;
+		char* end = nullptr;
+		double parsed = std::strtod(text.c_str(), &end);
+		if (*end != '\0' || !std::isfinite(parsed))
+			return false;
+		value = parsed;
+		return true;
+	}
+
+	// "x,y,z"
+	bool ParseVec3(const std::string& text, Vec3& value)
+	{
+		size_t first = text.find(',');
+		size_t second = first == std::string::npos ? first : text.find(',', first + 1);
+		if (second == std::string::npos)
+			return false;
+
+		double x = 0, y = 0, z = 0;
+		if (!ParseCoordinate(text.substr(0, first), x)
+			|| !ParseCoordinate(text.substr(first + 1, second - first - 1), y)
+			|| !ParseCoordinate(text.substr(second + 1), z))
+			return false;
+		value = Vec3(x, y, z);
+		return true;
+	}
+
+	bool ParseBool(const std::string& text, bool& value)
+	{
+		if (text == "true" || text == "1")
+			value = true;
+		else if (text == "false" || text == "0")
+			value = false;
+		else
+			return false;
+		return true;
+	}
+}
+
+bool SetRenderOption(RenderSettings& settings, const std::string& name, const std::string& value)
+{
+	bool ok;
+	if (name == "width")
+		ok = ParseInt(value, 1, settings.width);
+	else if (name == "height")
+		ok = ParseInt(value, 1, settings.height);
+	else if (name == "spp")
+		ok = ParseInt(value, 1, settings.samples_per_pixel);
+	else if (name == "min_spp")
+		ok = ParseInt(value, 1, settings.min_samples);
+	else if (name == "pass_spp")
+		ok = ParseInt(value, 1, settings.pass_samples);
+	else if (name == "error")
+		ok = ParseDouble(value, settings.error_threshold);
+	else if (name == "time")
+		ok = ParseDouble(value, settings.time_budget);
+	else if (name == "depth")
+		ok = ParseInt(value, 1, settings.max_depth);
+	else if (name == "rr_depth")
+		ok = ParseInt(value, 0, settings.rr_depth);
+	else if (name == "tile")
+		ok = ParseInt(value, 1, settings.tile_size);
+	else if (name == "threads")
+		ok = ParseInt(value, 0, settings.thread_count);
+	else if (name == "wavefront")
+		ok = ParseBool(value, settings.wavefront);
+	else if (name == "frames")
+		ok = ParseInt(value, 1, settings.frames);
+	else if (name == "first_frame")
+		ok = ParseInt(value, 0, settings.first_frame);
+	else if (name == "rebuild")
+		ok = ParseDouble(value, settings.rebuild_ratio) && settings.rebuild_ratio >= 1;
+	else if (name == "shutter")
+		ok = ParseDouble(value, settings.shutter);
+	else if (name == "output")
+	{
+		ok = !value.empty();
+		settings.output_path = value;
+	}
+	else if (name == "stream")
+		ok = ParseBool(value, settings.stream_tiles);
+	else
+	{
+		std::cerr << "ERROR: unknown render option '" << name << "'\n";
+		return false;
+	}
+
+	if (!ok)
+		std::cerr << "ERROR: bad value '" << value << "' for render option '" << name << "'\n";
+	return ok;
+}
+
+bool IsCameraOption(const std::string& name)
+{
+	return name == "lookfrom" || name == "lookat" || name == "vup"
+		|| name == "vfov" || name == "aperture" || name == "focus_dist";
+}
+
+bool SetCameraOption(CameraSettings& camera, const std::string& name, const std::string& value)
+{
+	bool ok;
+	if (name == "lookfrom")
+		ok = ParseVec3(value, camera.lookfrom);
+	else if (name == "lookat")
+		ok = ParseVec3(value, camera.lookat);
+	else if (name == "vup")
+		ok = ParseVec3(value, camera.vup);
+	else if (name == "vfov")
+		ok = ParseDouble(value, camera.vfov) && camera.vfov < 180;
+	else if (name == "aperture")
+		ok = ParseDouble(value, camera.aperture);
+	else if (name == "focus_dist")
+		ok = ParseDouble(value, camera.dist_to_focus);
+	else
+	{
+		std::cerr << "ERROR: unknown camera option '" << name << "'\n";
+		return false;
+	}
+
+	if (!ok)
+		std::cerr << "ERROR: bad value '" << value << "' for camera option '" << name << "'\n";
+	return ok;
+}
+
+const char* RenderOptionHelp()
+{
+	return
+		"  width N, height N   image size in pixels\n"
+		"  spp N               most samples per pixel\n"
+		"  min_spp N           samples before a pixel may stop\n"
+		"  pass_spp N          samples per progressive pass\n"
+		"  error X             noise at which a pixel stops, 0 samples uniformly\n"
+		"  time X              time budget in seconds, 0 is no limit\n"
+		"  depth N             most bounces of a path\n"
+		"  rr_depth N          bounces before russian roulette\n"
+		"  tile N              tile size in pixels\n"
+		"  threads N           render threads, 0 uses all\n"
+		"  wavefront true|false  trace a tile's paths together, a bounce at a time\n"
+		"  frames N            frames of the animation, numbered from first_frame N\n"
+		"  rebuild X           rebuild a refit bvh once its cost grew X times\n"
+		"  shutter X           motion blur over X frames from the start of each, 0 is off\n"
+		"  output FILE         .ppm, .pfm or .png\n"
+		"  stream true|false   write finished tiles while rendering\n"
+		"  lookfrom X,Y,Z, lookat X,Y,Z, vup X,Y,Z\n"
+		"  vfov X, aperture X, focus_dist X   camera\n";
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+
+#include "./scene.h"
+
+// How a scene is rendered. The defaults are overridden by the "render" block of a scene
+// file and then by the command line, both through SetRenderOption.
+struct RenderSettings
+{
+	int width = 500;
+	int height = 500;
+	int samples_per_pixel = 200;	// most samples a pixel gets
+	int min_samples = 32;			// samples before a pixel may count as converged
+	int pass_samples = 16;			// samples added to every unconverged pixel per pass
+	double error_threshold = 0.02;	// noise (in 0..1 output units) at which a pixel stops, 0 samples uniformly
+	double time_budget = 0;			// seconds, rendering stops after the pass that exceeds it, 0 is no limit
+	int max_depth = 50;
+	int rr_depth = 5;				// bounces before russian roulette may end a path
+	int tile_size = 32;
+	int thread_count = 0;			// 0 uses every hardware thread
+	bool wavefront = false;			// trace the paths of a tile together a bounce at a time (see WavefrontIntegrator)
+
+	int frames = 1;					// frames of the scene's animation, each one written to its own file
+	int first_frame = 0;
+	double rebuild_ratio = 1.2;		// a refit bvh is rebuilt once its sah cost grows past this multiple of its build cost
+	double shutter = 0;				// frames the shutter stays open for from the start of a frame, 0 renders without motion blur
+
+	std::string output_path = "./image/res.ppm";	// .ppm (binary), .pfm (float, linear) or .png
+	bool stream_tiles = true;		// keep the file up to date while rendering (.ppm and .pfm only)
+};
+
+// Set the option called name (width, height, spp, min_spp, pass_spp, error, time, depth,
+// rr_depth, tile, threads, wavefront, frames, first_frame, rebuild, shutter, output, stream)
+// from its text.
+// Unknown names and values out of range are reported on std::cerr and return false.
+bool SetRenderOption(RenderSettings& settings, const std::string& name, const std::string& value);
+
+// Camera options override the camera of the scene: lookfrom, lookat, vup (as x,y,z),
+// vfov, aperture and focus_dist.
+bool IsCameraOption(const std::string& name);
+bool SetCameraOption(CameraSettings& camera, const std::string& name, const std::string& value);
+
+// one line per render and camera option, for usage messages
+const char* RenderOptionHelp();
@@ -0,0 +1,133 @@
+#include "./renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+#include "./camera.h"
+#include "./film.h"
+#include "./image_writer.h"
+#include "./integrator.h"
+#include "./ray_packet.h"
+#include "./sampler.h"
+#include "./wavefront.h"
+
+// ---Renderer---
+
+void Renderer::Cancel()
+{
+	cancelled = true;
+	TileScheduler* scheduler = active;
+	if (scheduler)
+		scheduler->Cancel();
+}
+
+bool Renderer::Render(const Hittable& accel, const Scene& scene, const CameraSettings& camera,
+	const RenderSettings& settings, RenderStats& stats, double time)
+{
+	const int image_width = settings.width;
+	const int image_height = settings.height;
+	const double aspect_ratio = static_cast<double>(image_width) / image_height;
+	stats = RenderStats();
+
+	Camera cam(camera.lookfrom, camera.lookat, camera.vup, camera.vfov, aspect_ratio, camera.aperture, camera.dist_to_focus,
+		time, time + settings.shutter);
+
+	Film film(image_width, image_height);
+
+	// finished tiles go straight to disk, a crashed render still leaves an image
+	std::unique_ptr<ImageStream> stream;
+	if (settings.stream_tiles && ImageStream::CanStream(FormatFromPath(settings.output_path)))
+		stream.reset(new ImageStream(settings.output_path, image_width, image_height));
+
+	PathIntegrator integrator(accel, scene.materials, scene.lights, scene.background, settings.max_depth, settings.rr_depth);
+	WavefrontIntegrator wavefront(integrator);
+
+	TileScheduler scheduler(image_width, image_height, settings.tile_size, settings.thread_count);
+	active = &scheduler;
+	if (cancelled)
+		scheduler.Cancel();
+
+	auto start = std::chrono::steady_clock::now();
+	std::cerr << "running on " << scheduler.ThreadCount() << " threads, "
+		<< scheduler.TileCount() << " tiles\n" << std::flush;
+
+	// progressive passes, each one adds samples to the pixels that are still noisy
+	int spp = 0;
+	stats.finished = true;
+	for (int pass = 0; spp < settings.samples_per_pixel; ++pass)
+	{
+		const int pass_spp = std::min(pass == 0 ? settings.min_samples : settings.pass_samples, settings.samples_per_pixel - spp);
+
+		bool finished = scheduler.Run([&](const Tile& tile) {
+			if (settings.wavefront)
+			{
+				// the paths of a tile are traced together, one random stream per tile and pass
+				ThreadSampler().Seed(DEFAULT_SAMPLER_SEED + pass, static_cast<uint64_t>(tile.y0) * image_width + tile.x0);
+				wavefront.RenderTile(tile, cam, pass_spp, film);
+			}
+			else
+			{
+				// tiles count rows from the top of the image, j counts them from the bottom
+				for (int row = tile.y0; row < tile.y1; ++row)
+				{
+					int j = image_height - 1 - row;
+					for (int i = tile.x0; i < tile.x1; ++i)
+					{
+						if (film.IsConverged(i, row))
+							continue;
+
+						// one random stream per pixel and pass, the image doesn't depend on thread count or order
+						ThreadSampler().Seed(DEFAULT_SAMPLER_SEED + pass, static_cast<uint64_t>(j) * image_width + i);
+
+						// the camera rays of a pixel are nearly parallel, trace them as packets
+						for (int s = 0; s < pass_spp; s += PACKET_SIZE)
+						{
+							RayPacket packet;
+							packet.size = std::min(PACKET_SIZE, pass_spp - s);
+							for (int k = 0; k < packet.size; ++k)
+							{
+								auto u = (i + RandomDouble()) / (image_width - 1);
+								auto v = (j + RandomDouble()) / (image_height - 1);
+								packet.rays[k] = cam.GetRay(u, v);
+							}
+							film.AddBatch(i, row, integrator.LiPacket(packet), packet.size);
+						}
+					}
+				}
+			}
+
+			if (stream)
+				stream->WriteTile(film, tile);
+		});
+		spp += pass_spp;
+		stats.passes = pass + 1;
+
+		int still_sampling = settings.error_threshold > 0 ? film.UpdateConvergence(settings.error_threshold, settings.min_samples) : image_width * image_height;
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cerr << "pass " << pass << ": " << spp << " spp, " << still_sampling << " pixels still sampling\n" << std::flush;
+		stats.finished = finished;
+		if (!finished || still_sampling == 0 || (settings.time_budget > 0 && elapsed >= settings.time_budget))
+			break;
+	}
+
+	active = nullptr;
+
+	stats.render_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	stats.samples = film.TotalSamples();
+	std::cerr << "runtime:" << stats.render_time << "s\n";
+
+	double uniform_spp = film.UniformEqualErrorSpp();
+	std::cerr << "samples:" << stats.samples << " (" << (double)stats.samples / (image_width * image_height)
+		<< " per pixel), uniform sampling needs ~" << uniform_spp << " per pixel for the same mean error ("
+		<< uniform_spp * image_width * image_height / std::max<uint64_t>(stats.samples, 1) << "x)\n" << std::flush;
+
+	stream.reset();
+	auto write_start = std::chrono::steady_clock::now();
+	stats.written = WriteImage(settings.output_path, film);
+	stats.write_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - write_start).count();
+	if (stats.written)
+		std::cerr << "wrote " << settings.output_path << " in " << stats.write_time << "s\n" << std::flush;
+	return stats.written;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "./hittable.h"
+#include "./scene.h"
+#include "./render_settings.h"
+#include "./scheduler.h"
+
+struct RenderStats
+{
+	double render_time = 0;		// seconds spent in the passes
+	double write_time = 0;		// seconds writing the final image
+	uint64_t samples = 0;
+	int passes = 0;
+	bool finished = false;		// false when the render was cancelled
+	bool written = false;
+};
+
+// Renders images with progressive passes of tiles (see TileScheduler and Film), the
+// finished image is written to settings.output_path.
+class Renderer
+{
+public:
+	Renderer() : active(nullptr), cancelled(false) {}
+
+	// Render scene, traced through accel (its acceleration structure), as seen by camera.
+	// The shutter opens at time (the frame) and stays open for settings.shutter frames.
+	// Returns false if the image could not be written.
+	bool Render(const Hittable& accel, const Scene& scene, const CameraSettings& camera,
+		const RenderSettings& settings, RenderStats& stats, double time = 0);
+
+	// Stop the render in flight after the tiles that are running, its image is still
+	// written. Safe to call from a signal handler, later renders are stopped too.
+	void Cancel();
+	bool IsCancelled() const { return cancelled; }
+
+private:
+	std::atomic<TileScheduler*> active;
+	std::atomic<bool> cancelled;
+};
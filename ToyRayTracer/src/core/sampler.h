@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+// PCG32 random number generator (see pcg-random.org)
+// each render thread owns one, so sampling never touches a shared lock the way rand() does
+class Sampler
+{
+public:
+	constexpr Sampler() : state(0x853c49e6748fea9bULL), inc(0xda3e39cb94b95bdbULL) {}
+	Sampler(uint64_t seed, uint64_t sequence) { Seed(seed, sequence); }
+
+	// every sequence index selects an independent stream, so seeding with a pixel index
+	// gives the same samples for that pixel whichever thread renders it
+	inline void Seed(uint64_t seed, uint64_t sequence)
+	{
+		state = 0u;
+		inc = (sequence << 1u) | 1u;
+		NextUInt();
+		state += seed;
+		NextUInt();
+	}
+
+	inline uint32_t NextUInt()
+	{
+		uint64_t oldstate = state;
+		state = oldstate * 6364136223846793005ULL + inc;
+		uint32_t xorshifted = static_cast<uint32_t>(((oldstate >> 18u) ^ oldstate) >> 27u);
+		uint32_t rot = static_cast<uint32_t>(oldstate >> 59u);
+		return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+	}
+
+	// Returns a random real in [0,1).
+	inline double NextDouble()
+	{
+		return NextUInt() * (1.0 / 4294967296.0);
+	}
+
+private:
+	uint64_t state;
+	uint64_t inc;
+};
+
+// seed shared by all pixel streams, change it to get a different noise pattern
+const uint64_t DEFAULT_SAMPLER_SEED = 0x5851f42d4c957f2dULL;
+
+// the sampler of the calling thread, constant initialized so no guard is paid per call
+inline Sampler& ThreadSampler()
+{
+	static thread_local Sampler sampler;
+	return sampler;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <memory>
+
+#include "./math.h"
+#include "./hittable.h"
+#include "./animation.h"
+#include "./material_table.h"
+
+// where the camera is and what it sees, the image's aspect ratio comes from the render settings
+struct CameraSettings
+{
+	Point3 lookfrom;
+	Point3 lookat;
+	Vec3 vup = Vec3(0, 1, 0);
+	double vfov = 40.0;		// vertical, in degrees
+	double aperture = 0.0;
+	double dist_to_focus = 10.0;
+};
+
+// A scene apart from the render settings: its objects, the materials they refer to by id,
+// the lights that are sampled directly, the camera looking at them and how the objects
+// move. The materials and their textures live as long as the scene.
+struct Scene
+{
+	MaterialTable materials;
+	HittableList world;
+	shared_ptr<HittableList> lights;
+	CameraSettings camera;
+	Color background;
+	Animation animation;
+};
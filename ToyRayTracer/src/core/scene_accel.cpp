@@ -0,0 +1,381 @@
+#include "./scene_accel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+#include "./bvh_motion.h"
+#include "./instance.h"
+#include "./simple_shape.h"
+
+namespace
+{
+	// groups smaller than this are cheaper to test linearly
+	const size_t MIN_BLAS_SIZE = 5;
+
+	// an object is kept out of the tlas when its box has this many times the surface
+	// area of the box around all other objects
+	const double OVERSIZED_AREA_RATIO = 16.0;
+
+	double SurfaceArea(const AABB& box)
+	{
+		Vec3 d = box.max() - box.min();
+		return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+	}
+
+	// the objects directly below object
+	std::vector<const Hittable*> Children(const Hittable* object)
+	{
+		std::vector<const Hittable*> children;
+		auto add = [&](const std::vector<shared_ptr<Hittable>>& objects) {
+			for (const auto& child : objects)
+				children.push_back(child.get());
+		};
+
+		if (auto list = dynamic_cast<const HittableList*>(object))
+			add(list->objects);
+		else if (auto bvh = dynamic_cast<const LinearBVH*>(object))
+			add(bvh->primitives);
+		else if (auto bvh = dynamic_cast<const WideBVH<4>*>(object))
+			add(bvh->primitives);
+		else if (auto bvh = dynamic_cast<const WideBVH<8>*>(object))
+			add(bvh->primitives);
+		else if (auto bvh = dynamic_cast<const MotionBVH<4>*>(object))
+			add(bvh->primitives);
+		else if (auto bvh = dynamic_cast<const MotionBVH<8>*>(object))
+			add(bvh->primitives);
+		else if (auto translate = dynamic_cast<const Translate*>(object))
+			children.push_back(translate->ptr.get());
+		else if (auto rotate = dynamic_cast<const RotateY*>(object))
+			children.push_back(rotate->ptr.get());
+		else if (auto instance = dynamic_cast<const Instance*>(object))
+			children.push_back(instance->ptr.get());
+		else if (auto flip = dynamic_cast<const FlipFace*>(object))
+			children.push_back(flip->ptr.get());
+		else if (auto medium = dynamic_cast<const ConstantMedium*>(object))
+			children.push_back(medium->boundary.get());
+		return children;
+	}
+
+	// adds object to dynamic if it or anything below it is animated
+	bool MarkDynamic(const Hittable* object, const std::unordered_set<const Hittable*>& animated,
+		std::unordered_set<const Hittable*>& dynamic)
+	{
+		bool is_dynamic = animated.count(object) > 0;
+		for (const Hittable* child : Children(object))
+		{
+			if (MarkDynamic(child, animated, dynamic))
+				is_dynamic = true;
+		}
+
+		if (is_dynamic)
+			dynamic.insert(object);
+		return is_dynamic;
+	}
+
+	struct Refitter
+	{
+		const std::unordered_set<const Hittable*>& dynamic;
+		double time0, time1;
+		double rebuild_ratio;
+		SceneAccel::UpdateStats& stats;
+
+		// children first, then the boxes that depend on them
+		void Refit(Hittable* object)
+		{
+			if (!dynamic.count(object))
+				return;
+
+			if (auto list = dynamic_cast<HittableList*>(object))
+			{
+				for (auto& child : list->objects)
+					Refit(child.get());
+			}
+			else if (auto bvh = dynamic_cast<LinearBVH*>(object))
+				RefitBVH(*bvh);
+			else if (auto bvh = dynamic_cast<WideBVH<4>*>(object))
+				RefitBVH(*bvh);
+			else if (auto bvh = dynamic_cast<WideBVH<8>*>(object))
+				RefitBVH(*bvh);
+			else if (auto bvh = dynamic_cast<MotionBVH<4>*>(object))
+				RefitBVH(*bvh);
+			else if (auto bvh = dynamic_cast<MotionBVH<8>*>(object))
+				RefitBVH(*bvh);
+			else if (auto translate = dynamic_cast<Translate*>(object))
+				Refit(translate->ptr.get());
+			else if (auto rotate = dynamic_cast<RotateY*>(object))
+			{
+				if (dynamic.count(rotate->ptr.get()))
+				{
+					Refit(rotate->ptr.get());
+					rotate->UpdateBox();
+				}
+			}
+			else if (auto instance = dynamic_cast<Instance*>(object))
+			{
+				if (dynamic.count(instance->ptr.get()))
+				{
+					Refit(instance->ptr.get());
+					instance->UpdateBox();
+				}
+			}
+			else if (auto flip = dynamic_cast<FlipFace*>(object))
+				Refit(flip->ptr.get());
+			else if (auto medium = dynamic_cast<ConstantMedium*>(object))
+				Refit(medium->boundary.get());
+		}
+
+		// LinearBVH, WideBVH or MotionBVH
+		template<typename BVH>
+		void RefitBVH(BVH& bvh)
+		{
+			for (auto& primitive : bvh.primitives)
+				Refit(primitive.get());
+
+			bvh.Refit(time0, time1);
+			double ratio = bvh.build_cost > 0 ? bvh.Cost() / bvh.build_cost : 1;
+			if (ratio > rebuild_ratio)
+			{
+				// the rebuilt bvh replaces the old one in place, so dynamic stays valid
+				bvh.Rebuild(time0, time1);
+				++stats.rebuilt;
+			}
+			else
+			{
+				++stats.refit;
+				stats.cost_ratio = std::max(stats.cost_ratio, ratio);
+			}
+		}
+	};
+}
+
+namespace
+{
+	// what BuildGroups made of an object that was seen before
+	struct Built
+	{
+		shared_ptr<Hittable> object;
+		bool moving;
+	};
+	typedef std::unordered_map<const Hittable*, Built> BuiltObjects;
+
+	// BuildBLAS, with moving set to whether anything below object is in motion. Groups
+	// holding something in motion become MotionBVHs, there are none without motion.
+	// A group shared by several parents (the object of many Instances) gets one bvh.
+	shared_ptr<Hittable> BuildGroups(shared_ptr<Hittable> object,
+		const std::unordered_set<const Hittable*>* motion, BuiltObjects& built, bool& moving)
+	{
+		auto found = built.find(object.get());
+		if (found != built.end())
+		{
+			moving = found->second.moving;
+			return found->second.object;
+		}
+
+		moving = motion && motion->count(object.get()) > 0;
+		bool child_moving = false;
+		shared_ptr<Hittable> result = object;
+
+		if (auto list = std::dynamic_pointer_cast<HittableList>(object))
+		{
+			for (auto& child : list->objects)
+			{
+				child = BuildGroups(child, motion, built, child_moving);
+				moving = moving || child_moving;
+			}
+
+			if (list->objects.size() >= MIN_BLAS_SIZE)
+				result = moving ? MakeMotionBVH(list->objects, 0.0, 0.0) : MakeBVH(list->objects);
+			built[object.get()] = { result, moving };
+			return result;
+		}
+
+		// look through the wrappers, their cached bounding boxes stay valid since a bvh has
+		// the same box as the group it replaces
+		if (auto translate = dynamic_cast<Translate*>(object.get()))
+			translate->ptr = BuildGroups(translate->ptr, motion, built, child_moving);
+		else if (auto rotate = dynamic_cast<RotateY*>(object.get()))
+			rotate->ptr = BuildGroups(rotate->ptr, motion, built, child_moving);
+		else if (auto instance = dynamic_cast<Instance*>(object.get()))
+			instance->ptr = BuildGroups(instance->ptr, motion, built, child_moving);
+		else if (auto flip = dynamic_cast<FlipFace*>(object.get()))
+			flip->ptr = BuildGroups(flip->ptr, motion, built, child_moving);
+		else if (auto medium = dynamic_cast<ConstantMedium*>(object.get()))
+			medium->boundary = BuildGroups(medium->boundary, motion, built, child_moving);
+
+		moving = moving || child_moving;
+		built[object.get()] = { object, moving };
+		return object;
+	}
+}
+
+shared_ptr<Hittable> BuildBLAS(shared_ptr<Hittable> object)
+{
+	BuiltObjects built;
+	bool moving;
+	return BuildGroups(object, nullptr, built, moving);
+}
+
+// ---SceneAccel---
+
+SceneAccel::SceneAccel(HittableList& world, const std::vector<const Hittable*>& animated,
+	bool motion_blur)
+{
+	std::unordered_set<const Hittable*> targets(animated.begin(), animated.end());
+	const std::unordered_set<const Hittable*>* motion = motion_blur ? &targets : nullptr;
+
+	std::vector<shared_ptr<Hittable>> bounded;
+	std::vector<AABB> boxes;
+	std::unordered_set<const Hittable*> moving_objects;
+	BuiltObjects built;
+
+	for (const auto& object : world.objects)
+	{
+		bool moving;
+		auto instance = BuildGroups(object, motion, built, moving);
+		if (moving)
+			moving_objects.insert(instance.get());
+
+		AABB box;
+		if (instance->BoundingBox(box))
+		{
+			bounded.push_back(instance);
+			boxes.push_back(box);
+		}
+		else
+			unbounded.add(instance);
+	}
+
+	// prefix/suffix unions give the box around all other objects in O(n)
+	size_t n = boxes.size();
+	if (n > 1)
+	{
+		std::vector<AABB> prefix(n), suffix(n);
+		prefix[0] = boxes[0];
+		for (size_t i = 1; i < n; ++i)
+			prefix[i] = SurroundingBox(prefix[i - 1], boxes[i]);
+		suffix[n - 1] = boxes[n - 1];
+		for (size_t i = n - 1; i-- > 0;)
+			suffix[i] = SurroundingBox(suffix[i + 1], boxes[i]);
+
+		std::vector<shared_ptr<Hittable>> kept;
+		for (size_t i = 0; i < n; ++i)
+		{
+			AABB others = i == 0 ? suffix[1]
+				: i == n - 1 ? prefix[n - 2]
+				: SurroundingBox(prefix[i - 1], suffix[i + 1]);
+
+			if (SurfaceArea(boxes[i]) > OVERSIZED_AREA_RATIO * SurfaceArea(others))
+				unbounded.add(bounded[i]);
+			else
+				kept.push_back(bounded[i]);
+		}
+		bounded.swap(kept);
+	}
+
+	bool tlas_moving = std::any_of(bounded.begin(), bounded.end(),
+		[&](const shared_ptr<Hittable>& object) { return moving_objects.count(object.get()) > 0; });
+	if (tlas_moving)
+		tlas = MakeMotionBVH(bounded, 0.0, 0.0);
+	else
+		tlas = MakeBVH(bounded);
+
+	if (!animated.empty())
+	{
+		MarkDynamic(tlas.get(), targets, dynamic);
+		for (const auto& object : unbounded.objects)
+			MarkDynamic(object.get(), targets, dynamic);
+	}
+}
+
+SceneAccel::UpdateStats SceneAccel::Update(double time0, double time1, double rebuild_ratio)
+{
+	UpdateStats stats;
+	auto start = std::chrono::steady_clock::now();
+
+	// the bvhs were built around everywhere the animated objects go, the first update
+	// rebuilds them around where they are
+	if (!fitted)
+		rebuild_ratio = 0;
+	fitted = true;
+
+	Refitter refitter = { dynamic, time0, time1, rebuild_ratio, stats };
+	refitter.Refit(tlas.get());
+	for (const auto& object : unbounded.objects)
+		refitter.Refit(object.get());
+
+	stats.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+bool SceneAccel::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
+{
+	bool hit_anything = tlas->Hit(r, t_min, t_max, rec);
+	if (hit_anything)
+		t_max = rec.t;
+
+	for (const auto& object : unbounded.objects)
+	{
+		if (object->Hit(r, t_min, t_max, rec))
+		{
+			hit_anything = true;
+			t_max = rec.t;
+		}
+	}
+
+	return hit_anything;
+}
+
+bool SceneAccel::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	if (tlas->Occluded(r, t_min, t_max))
+		return true;
+
+	for (const auto& object : unbounded.objects)
+	{
+		if (object->Occluded(r, t_min, t_max))
+			return true;
+	}
+
+	return false;
+}
+
+uint32_t SceneAccel::HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	double* t_max, HitRecord* recs) const
+{
+	uint32_t hit_mask = tlas->HitPacket(packet, mask, t_min, t_max, recs);
+	for (const auto& object : unbounded.objects)
+		hit_mask |= object->HitPacket(packet, mask, t_min, t_max, recs);
+
+	return hit_mask;
+}
+
+uint32_t SceneAccel::OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+	const double* t_max) const
+{
+	uint32_t blocked = tlas->OccludedPacket(packet, mask, t_min, t_max);
+	for (const auto& object : unbounded.objects)
+	{
+		if ((mask & ~blocked) == 0)
+			break;
+		blocked |= object->OccludedPacket(packet, mask & ~blocked, t_min, t_max);
+	}
+
+	return blocked;
+}
+
+bool SceneAccel::BoundingBox(AABB& output_box) const
+{
+	AABB temp_box;
+	bool has_box = tlas->BoundingBox(output_box);
+
+	for (const auto& object : unbounded.objects)
+	{
+		if (!object->BoundingBox(temp_box))
+			return false;
+		output_box = has_box ? SurroundingBox(output_box, temp_box) : temp_box;
+		has_box = true;
+	}
+
+	return has_box;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <unordered_set>
+#include <vector>
+
+#include "./math.h"
+#include "./hittable.h"
+#include "./bvh_wide.h"
+
+// Two level acceleration structure built automatically over a whole scene.
+// Every group (HittableList) with enough objects, including those hidden behind
+// Translate/RotateY/Instance/FlipFace/ConstantMedium, is turned into its own bvh (blas),
+// once even when many Instances share it, and a top level bvh (tlas) is built over what
+// is left at the top of the scene. Both levels use the
+// bvh layout picked for the cpu (see MakeBVH).
+// Objects without a bounding box, or whose box dwarfs the rest of the scene (a fog volume
+// around everything), stay out of the tlas and are tested linearly after it.
+// Animated transforms (see Animation) are remembered with every bvh above them, after they
+// move Update refits just those bvhs. With motion_blur the bvhs above them are MotionBVHs
+// instead, whose boxes follow the objects through the shutter interval.
+class SceneAccel : public Hittable
+{
+public:
+	// Builds the bvhs into world itself: the groups below its objects are replaced by
+	// their bvhs, in the lists that hold them and in the ptr (boundary) of the wrappers
+	// above them. world traces the same afterwards, but it can no longer be written to a
+	// scene cache, and another SceneAccel built over it finds bvhs where the groups were
+	// (so it can't make them MotionBVHs).
+	SceneAccel(HittableList& world, const std::vector<const Hittable*>& animated = {},
+		bool motion_blur = false);
+
+	struct UpdateStats
+	{
+		double time = 0;		// seconds
+		int refit = 0;			// bvhs refit
+		int rebuilt = 0;		// bvhs rebuilt after a refit made them too slow
+		double cost_ratio = 1;	// worst sah cost of a refit bvh relative to its build
+	};
+
+	// Bring the boxes up to date for rays from time0 to time1 (the shutter interval, or
+	// both the frame's time without motion blur). A bvh is refit bottom up, or rebuilt once
+	// its cost grows past rebuild_ratio times its build cost.
+	UpdateStats Update(double time0, double time1, double rebuild_ratio);
+
+	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
+	virtual bool BoundingBox(AABB& output_box) const override;
+	virtual uint32_t HitPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		double* t_max, HitRecord* recs) const override;
+	virtual uint32_t OccludedPacket(const RayPacket& packet, uint32_t mask, double t_min,
+		const double* t_max) const override;
+
+public:
+	shared_ptr<Hittable> tlas;
+	HittableList unbounded;
+
+private:
+	// objects that are animated or hold something animated
+	std::unordered_set<const Hittable*> dynamic;
+	bool fitted = false;
+};
+
+// Replace the groups below object by bvhs, returns the object to use in its place
+shared_ptr<Hittable> BuildBLAS(shared_ptr<Hittable> object);
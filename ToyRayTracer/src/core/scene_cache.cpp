@@ -0,0 +1,899 @@
+#include "./scene_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "./aarec.h"
+#include "./box_array.h"
+#include "./instance.h"
+#include "./simple_shape.h"
+#include "./materials.h"
+#include "./material_table.h"
+#include "./texture.h"
+#include "./triangle_mesh.h"
+#include "./mapped_file.h"
+
+namespace
+{
+	const char SCENE_CACHE_MAGIC[8] = { 'T', 'O', 'Y', 'R', 'T', 'S', 'C', 'N' };
+	const uint32_t ENDIAN_TAG = 0x01020304;
+	const uint64_t BLOCK_ALIGNMENT = 64;
+	const uint32_t NO_OBJECT = 0xffffffffu;
+
+	enum TextureType : uint32_t
+	{
+		TEXTURE_SOLID,
+		TEXTURE_IMAGE
+	};
+
+	enum MaterialType : uint32_t
+	{
+		MATERIAL_LAMBERTIAN,
+		MATERIAL_METAL,
+		MATERIAL_DIELECTRIC,
+		MATERIAL_DIFFUSE_LIGHT,
+		MATERIAL_ISOTROPIC
+	};
+
+	enum ObjectType : uint32_t
+	{
+		OBJECT_LIST,
+		OBJECT_XY_RECT,
+		OBJECT_XZ_RECT,
+		OBJECT_YZ_RECT,
+		OBJECT_BOX,
+		OBJECT_SPHERE,
+		OBJECT_MEDIUM,
+		OBJECT_ROTATE_Y,
+		OBJECT_TRANSLATE,
+		OBJECT_FLIP_FACE,
+		OBJECT_MESH,
+		OBJECT_INSTANCE,
+		OBJECT_BOX_ARRAY
+	};
+
+	struct CacheHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t endian_tag;
+		uint64_t file_size;
+
+		uint32_t texture_count;
+		uint32_t material_count;
+		uint32_t object_count;
+		uint32_t child_count;
+		uint64_t texture_offset;
+		uint64_t material_offset;
+		uint64_t object_offset;
+		uint64_t child_offset;
+
+		uint32_t world;		// object indices, lights may be NO_OBJECT
+		uint32_t lights;
+
+		double lookfrom[3];
+		double lookat[3];
+		double vup[3];
+		double vfov;
+		double aperture;
+		double dist_to_focus;
+		double background[3];
+	};
+
+	struct CacheTexture
+	{
+		uint32_t type;
+		int32_t width;		// image size, 0 for an image that failed to load
+		int32_t height;
+		uint32_t pad;
+		double color[3];
+		uint64_t pixels;	// offset of the rgb bytes
+	};
+
+	struct CacheMaterial
+	{
+		uint32_t type;
+		uint32_t texture;	// albedo or emission, index into the textures
+		double color[3];	// metal albedo
+		double param;		// metal fuzz, dielectric index of refraction
+	};
+
+	// Children are written before their parents, so loading is a single pass in order.
+	// Materials are 1 + their index, 0 is NO_MATERIAL.
+	struct CacheObject
+	{
+		uint32_t type;
+		uint32_t material;
+		uint32_t first_child;	// index into the child indices
+		uint32_t child_count;
+		double param[12];		// the shape's numbers, see Writer::AddObject
+		uint64_t mesh;			// offset of the CacheMesh, or of a box array's corners
+	};
+
+	// the arrays of a MeshView, triangles already in bvh leaf order
+	struct CacheMesh
+	{
+		uint32_t vertex_count;
+		uint32_t normal_count;
+		uint32_t uv_count;
+		uint32_t triangle_count;
+		uint32_t node_count;
+		uint32_t has_normal_index;
+		uint32_t has_uv_index;
+		uint32_t pad;
+		uint64_t px, py, pz;
+		uint64_t nx, ny, nz;
+		uint64_t u, v;
+		uint64_t position_index;
+		uint64_t normal_index;
+		uint64_t uv_index;
+		uint64_t nodes;
+	};
+
+	static_assert(sizeof(CacheHeader) == 200 && sizeof(CacheTexture) == 48 && sizeof(CacheMaterial) == 40
+		&& sizeof(CacheObject) == 120 && sizeof(CacheMesh) == 128, "scene cache records changed, bump SCENE_CACHE_VERSION");
+
+	inline void PutVec3(double* out, const Vec3& v)
+	{
+		out[0] = v.x();
+		out[1] = v.y();
+		out[2] = v.z();
+	}
+
+	inline Vec3 GetVec3(const double* in)
+	{
+		return Vec3(in[0], in[1], in[2]);
+	}
+
+	// ---Writer---
+
+	// Data blocks go to the file as soon as they are found, the records are collected and
+	// written after them, the header last.
+	class Writer
+	{
+	public:
+		Writer(const std::string& file_path, const MaterialTable& scene_materials)
+			: path(file_path), file(file_path, std::ios::binary), cursor(0), table(scene_materials)
+		{
+			CacheHeader header = {};
+			Write(&header, sizeof(header));
+		}
+
+		bool IsOpen() const { return static_cast<bool>(file); }
+
+		bool AddObject(const Hittable* object, uint32_t& index);
+		bool Finish(const Scene& scene, uint32_t world, uint32_t lights);
+
+		// remove a file that could not be finished
+		void Discard()
+		{
+			file.close();
+			std::remove(path.c_str());
+		}
+
+	private:
+		bool AddMaterial(MaterialID id, uint32_t& index);
+		bool AddTexture(const Texture* texture, uint32_t& index);
+		uint64_t AddBlock(const void* data, size_t size);
+		uint64_t AddMesh(const MeshView& view);
+		uint64_t AddBoxes(const BoxArray& boxes);
+
+		void Write(const void* data, size_t size)
+		{
+			file.write(static_cast<const char*>(data), size);
+			cursor += size;
+		}
+
+		bool Unsupported(const char* what)
+		{
+			std::cerr << "ERROR: " << path << ": the scene cache can't store " << what << "\n";
+			return false;
+		}
+
+	private:
+		std::string path;
+		std::ofstream file;
+		uint64_t cursor;
+		const MaterialTable& table;		// the scene's, the objects' material ids index it
+
+		std::vector<CacheTexture> textures;
+		std::vector<CacheMaterial> materials;
+		std::vector<CacheObject> objects;
+		std::vector<uint32_t> children;
+
+		// shared objects are written once and stay shared after loading
+		std::unordered_map<const Texture*, uint32_t> texture_ids;
+		std::unordered_map<const Material*, uint32_t> material_ids;
+		std::unordered_map<const Hittable*, uint32_t> object_ids;
+	};
+
+	uint64_t Writer::AddBlock(const void* data, size_t size)
+	{
+		static const char zeros[BLOCK_ALIGNMENT] = {};
+		Write(zeros, static_cast<size_t>((BLOCK_ALIGNMENT - cursor % BLOCK_ALIGNMENT) % BLOCK_ALIGNMENT));
+
+		uint64_t offset = cursor;
+		if (size > 0)
+			Write(data, size);
+		return offset;
+	}
+
+	uint64_t Writer::AddMesh(const MeshView& view)
+	{
+		CacheMesh mesh = {};
+		mesh.vertex_count = view.vertex_count;
+		mesh.normal_count = view.normal_count;
+		mesh.uv_count = view.uv_count;
+		mesh.triangle_count = view.triangle_count;
+		mesh.node_count = view.node_count;
+		mesh.has_normal_index = view.normal_index != nullptr;
+		mesh.has_uv_index = view.uv_index != nullptr;
+
+		const size_t corners = 3 * sizeof(uint32_t) * view.triangle_count;
+		mesh.px = AddBlock(view.px, sizeof(float) * view.vertex_count);
+		mesh.py = AddBlock(view.py, sizeof(float) * view.vertex_count);
+		mesh.pz = AddBlock(view.pz, sizeof(float) * view.vertex_count);
+		mesh.nx = AddBlock(view.nx, sizeof(float) * view.normal_count);
+		mesh.ny = AddBlock(view.ny, sizeof(float) * view.normal_count);
+		mesh.nz = AddBlock(view.nz, sizeof(float) * view.normal_count);
+		mesh.u = AddBlock(view.u, sizeof(float) * view.uv_count);
+		mesh.v = AddBlock(view.v, sizeof(float) * view.uv_count);
+		mesh.position_index = AddBlock(view.position_index, corners);
+		mesh.normal_index = AddBlock(view.normal_index, view.normal_index ? corners : 0);
+		mesh.uv_index = AddBlock(view.uv_index, view.uv_index ? corners : 0);
+		mesh.nodes = AddBlock(view.nodes, sizeof(LinearBVHNode) * view.node_count);
+
+		return AddBlock(&mesh, sizeof(mesh));
+	}
+
+	// min then max corner of every box, the bvh is built again on loading
+	uint64_t Writer::AddBoxes(const BoxArray& boxes)
+	{
+		std::vector<double> corners;
+		corners.reserve(6 * boxes.Size());
+		for (size_t i = 0; i < boxes.Size(); ++i)
+		{
+			const double box[6] = { boxes.x0[i], boxes.y0[i], boxes.z0[i], boxes.x1[i], boxes.y1[i], boxes.z1[i] };
+			corners.insert(corners.end(), box, box + 6);
+		}
+		return AddBlock(corners.data(), sizeof(double) * corners.size());
+	}
+
+	bool Writer::AddTexture(const Texture* texture, uint32_t& index)
+	{
+		auto found = texture_ids.find(texture);
+		if (found != texture_ids.end())
+		{
+			index = found->second;
+			return true;
+		}
+
+		CacheTexture record = {};
+		if (auto solid = dynamic_cast<const SolidColor*>(texture))
+		{
+			record.type = TEXTURE_SOLID;
+			PutVec3(record.color, solid->ColorValue());
+		}
+		else if (auto image = dynamic_cast<const ImageTexture*>(texture))
+		{
+			record.type = TEXTURE_IMAGE;
+			if (image->Pixels())
+			{
+				record.width = image->Width();
+				record.height = image->Height();
+				record.pixels = AddBlock(image->Pixels(),
+					static_cast<size_t>(ImageTexture::bytes_per_pixel) * image->Width() * image->Height());
+			}
+		}
+		else
+			return Unsupported("this texture type");
+
+		index = static_cast<uint32_t>(textures.size());
+		textures.push_back(record);
+		texture_ids[texture] = index;
+		return true;
+	}
+
+	bool Writer::AddMaterial(MaterialID id, uint32_t& index)
+	{
+		const Material* material = table.Get(id);
+		if (!material)
+		{
+			index = NO_MATERIAL;
+			return true;
+		}
+
+		auto found = material_ids.find(material);
+		if (found != material_ids.end())
+		{
+			index = found->second;
+			return true;
+		}
+
+		CacheMaterial record = {};
+		bool ok = true;
+		if (auto lambertian = dynamic_cast<const Lambertian*>(material))
+		{
+			record.type = MATERIAL_LAMBERTIAN;
+			ok = AddTexture(lambertian->albedo.get(), record.texture);
+		}
+		else if (auto metal = dynamic_cast<const Metal*>(material))
+		{
+			record.type = MATERIAL_METAL;
+			PutVec3(record.color, metal->albedo);
+			record.param = metal->fuzz;
+		}
+		else if (auto dielectric = dynamic_cast<const Dielectric*>(material))
+		{
+			record.type = MATERIAL_DIELECTRIC;
+			record.param = dielectric->ir;
+		}
+		else if (auto light = dynamic_cast<const DiffuseLight*>(material))
+		{
+			record.type = MATERIAL_DIFFUSE_LIGHT;
+			ok = AddTexture(light->emit.get(), record.texture);
+		}
+		else if (auto isotropic = dynamic_cast<const Isotropic*>(material))
+		{
+			record.type = MATERIAL_ISOTROPIC;
+			ok = AddTexture(isotropic->albedo.get(), record.texture);
+		}
+		else
+			return Unsupported("this material type");
+
+		if (!ok)
+			return false;
+
+		materials.push_back(record);
+		index = static_cast<uint32_t>(materials.size());
+		material_ids[material] = index;
+		return true;
+	}
+
+	bool Writer::AddObject(const Hittable* object, uint32_t& index)
+	{
+		auto found = object_ids.find(object);
+		if (found != object_ids.end())
+		{
+			index = found->second;
+			return true;
+		}
+
+		CacheObject record = {};
+		std::vector<const Hittable*> child_objects;
+		MaterialID mat_id = NO_MATERIAL;
+
+		if (auto list = dynamic_cast<const HittableList*>(object))
+		{
+			record.type = OBJECT_LIST;
+			for (const auto& child : list->objects)
+				child_objects.push_back(child.get());
+		}
+		else if (auto rect = dynamic_cast<const XYRect*>(object))
+		{
+			record.type = OBJECT_XY_RECT;
+			double param[5] = { rect->x0, rect->x1, rect->y0, rect->y1, rect->k };
+			memcpy(record.param, param, sizeof(param));
+			mat_id = rect->mat_id;
+		}
+		else if (auto rect = dynamic_cast<const XZRect*>(object))
+		{
+			record.type = OBJECT_XZ_RECT;
+			double param[5] = { rect->x0, rect->x1, rect->z0, rect->z1, rect->k };
+			memcpy(record.param, param, sizeof(param));
+			mat_id = rect->mat_id;
+		}
+		else if (auto rect = dynamic_cast<const YZRect*>(object))
+		{
+			record.type = OBJECT_YZ_RECT;
+			double param[5] = { rect->y0, rect->y1, rect->z0, rect->z1, rect->k };
+			memcpy(record.param, param, sizeof(param));
+			mat_id = rect->mat_id;
+		}
+		else if (auto box = dynamic_cast<const Box*>(object))
+		{
+			record.type = OBJECT_BOX;
+			PutVec3(record.param, box->box_min);
+			PutVec3(record.param + 3, box->box_max);
+			mat_id = box->mat_id;
+		}
+		else if (auto boxes = dynamic_cast<const BoxArray*>(object))
+		{
+			record.type = OBJECT_BOX_ARRAY;
+			record.param[0] = static_cast<double>(boxes->Size());
+			record.mesh = AddBoxes(*boxes);
+			mat_id = boxes->mat_id;
+		}
+		else if (auto sphere = dynamic_cast<const Sphere*>(object))
+		{
+			record.type = OBJECT_SPHERE;
+			PutVec3(record.param, sphere->center);
+			record.param[3] = sphere->radius;
+			mat_id = sphere->mat_id;
+		}
+		else if (auto medium = dynamic_cast<const ConstantMedium*>(object))
+		{
+			record.type = OBJECT_MEDIUM;
+			record.param[0] = medium->neg_inv_density;
+			if (!dynamic_cast<const Isotropic*>(table.Get(medium->phase_function)))
+				return Unsupported("a medium with a phase function other than Isotropic");
+			mat_id = medium->phase_function;
+			child_objects.push_back(medium->boundary.get());
+		}
+		else if (auto rotate = dynamic_cast<const RotateY*>(object))
+		{
+			// the exact sine, cosine and box, recomputing them from the angle could round differently
+			record.type = OBJECT_ROTATE_Y;
+			record.param[0] = rotate->sin_theta;
+			record.param[1] = rotate->cos_theta;
+			record.param[2] = rotate->hasbox ? 1.0 : 0.0;
+			PutVec3(record.param + 3, rotate->bbox.min());
+			PutVec3(record.param + 6, rotate->bbox.max());
+			child_objects.push_back(rotate->ptr.get());
+		}
+		else if (auto translate = dynamic_cast<const Translate*>(object))
+		{
+			record.type = OBJECT_TRANSLATE;
+			PutVec3(record.param, translate->offset);
+			child_objects.push_back(translate->ptr.get());
+		}
+		else if (auto instance = dynamic_cast<const Instance*>(object))
+		{
+			// the inverse is computed again on loading, from the same numbers
+			record.type = OBJECT_INSTANCE;
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int j = 0; j < 4; ++j)
+					record.param[i * 4 + j] = instance->to_world.m[i][j];
+			}
+			child_objects.push_back(instance->ptr.get());
+		}
+		else if (auto flip = dynamic_cast<const FlipFace*>(object))
+		{
+			record.type = OBJECT_FLIP_FACE;
+			child_objects.push_back(flip->ptr.get());
+		}
+		else if (auto mesh = dynamic_cast<const TriangleMesh*>(object))
+		{
+			record.type = OBJECT_MESH;
+			PutVec3(record.param, mesh->box.min());
+			PutVec3(record.param + 3, mesh->box.max());
+			record.mesh = AddMesh(mesh->view);
+			mat_id = mesh->mat_id;
+		}
+		else
+			return Unsupported("this object type (bvhs are built again after loading)");
+
+		if (!AddMaterial(mat_id, record.material))
+			return false;
+
+		std::vector<uint32_t> child_ids(child_objects.size());
+		for (size_t i = 0; i < child_objects.size(); ++i)
+		{
+			if (!AddObject(child_objects[i], child_ids[i]))
+				return false;
+		}
+		record.first_child = static_cast<uint32_t>(children.size());
+		record.child_count = static_cast<uint32_t>(child_ids.size());
+		children.insert(children.end(), child_ids.begin(), child_ids.end());
+
+		index = static_cast<uint32_t>(objects.size());
+		objects.push_back(record);
+		object_ids[object] = index;
+		return true;
+	}
+
+	bool Writer::Finish(const Scene& scene, uint32_t world, uint32_t lights)
+	{
+		CacheHeader header = {};
+		memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic));
+		header.version = SCENE_CACHE_VERSION;
+		header.endian_tag = ENDIAN_TAG;
+
+		header.texture_count = static_cast<uint32_t>(textures.size());
+		header.texture_offset = AddBlock(textures.data(), sizeof(CacheTexture) * textures.size());
+		header.material_count = static_cast<uint32_t>(materials.size());
+		header.material_offset = AddBlock(materials.data(), sizeof(CacheMaterial) * materials.size());
+		header.object_count = static_cast<uint32_t>(objects.size());
+		header.object_offset = AddBlock(objects.data(), sizeof(CacheObject) * objects.size());
+		header.child_count = static_cast<uint32_t>(children.size());
+		header.child_offset = AddBlock(children.data(), sizeof(uint32_t) * children.size());
+		header.file_size = cursor;
+
+		header.world = world;
+		header.lights = lights;
+		PutVec3(header.lookfrom, scene.camera.lookfrom);
+		PutVec3(header.lookat, scene.camera.lookat);
+		PutVec3(header.vup, scene.camera.vup);
+		header.vfov = scene.camera.vfov;
+		header.aperture = scene.camera.aperture;
+		header.dist_to_focus = scene.camera.dist_to_focus;
+		PutVec3(header.background, scene.background);
+
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.close();
+		if (!file)
+		{
+			std::cerr << "ERROR: could not write '" << path << "'\n";
+			return false;
+		}
+		return true;
+	}
+
+	// ---Loading---
+
+	// count elements of size bytes at offset lie inside a file of file_size bytes
+	inline bool InFile(uint64_t offset, uint64_t count, uint64_t size, uint64_t file_size)
+	{
+		return offset <= file_size && (size == 0 || count <= (file_size - offset) / size);
+	}
+
+	bool Corrupt(const std::string& path, const char* what)
+	{
+		std::cerr << "ERROR: " << path << ": broken scene cache (" << what << "), write it again\n";
+		return false;
+	}
+
+	// Point view at the arrays of a mesh record, all of which have to lie inside the file.
+	// What is in them is left to CheckMesh.
+	bool MapMesh(const MappedFile& file, uint64_t offset, MeshView& view)
+	{
+		const uint64_t size = file.Size();
+		if (!InFile(offset, 1, sizeof(CacheMesh), size) || offset % 8 != 0)
+			return false;
+
+		const unsigned char* base = file.Data();
+		const CacheMesh& mesh = *reinterpret_cast<const CacheMesh*>(base + offset);
+		const uint64_t corners = 3ull * mesh.triangle_count;
+
+		const uint64_t float_arrays[8] = { mesh.px, mesh.py, mesh.pz, mesh.nx, mesh.ny, mesh.nz, mesh.u, mesh.v };
+		const uint64_t float_counts[8] = { mesh.vertex_count, mesh.vertex_count, mesh.vertex_count,
+			mesh.normal_count, mesh.normal_count, mesh.normal_count, mesh.uv_count, mesh.uv_count };
+		for (int i = 0; i < 8; ++i)
+		{
+			if (!InFile(float_arrays[i], float_counts[i], sizeof(float), size) || float_arrays[i] % BLOCK_ALIGNMENT != 0)
+				return false;
+		}
+		const uint64_t index_arrays[3] = { mesh.position_index, mesh.normal_index, mesh.uv_index };
+		const bool has_index[3] = { true, mesh.has_normal_index != 0, mesh.has_uv_index != 0 };
+		for (int i = 0; i < 3; ++i)
+		{
+			if (has_index[i] && (!InFile(index_arrays[i], corners, sizeof(uint32_t), size) || index_arrays[i] % BLOCK_ALIGNMENT != 0))
+				return false;
+		}
+		if (!InFile(mesh.nodes, mesh.node_count, sizeof(LinearBVHNode), size) || mesh.nodes % BLOCK_ALIGNMENT != 0)
+			return false;
+
+		view.px = reinterpret_cast<const float*>(base + mesh.px);
+		view.py = reinterpret_cast<const float*>(base + mesh.py);
+		view.pz = reinterpret_cast<const float*>(base + mesh.pz);
+		view.nx = reinterpret_cast<const float*>(base + mesh.nx);
+		view.ny = reinterpret_cast<const float*>(base + mesh.ny);
+		view.nz = reinterpret_cast<const float*>(base + mesh.nz);
+		view.u = reinterpret_cast<const float*>(base + mesh.u);
+		view.v = reinterpret_cast<const float*>(base + mesh.v);
+		view.position_index = reinterpret_cast<const uint32_t*>(base + mesh.position_index);
+		view.normal_index = mesh.has_normal_index ? reinterpret_cast<const uint32_t*>(base + mesh.normal_index) : nullptr;
+		view.uv_index = mesh.has_uv_index ? reinterpret_cast<const uint32_t*>(base + mesh.uv_index) : nullptr;
+		view.nodes = reinterpret_cast<const LinearBVHNode*>(base + mesh.nodes);
+		view.vertex_count = mesh.vertex_count;
+		view.normal_count = mesh.normal_count;
+		view.uv_count = mesh.uv_count;
+		view.triangle_count = mesh.triangle_count;
+		view.node_count = mesh.node_count;
+		return true;
+	}
+
+	// every one of the corners indices is below count, or NO_INDEX where allowed
+	bool IndicesBelow(const uint32_t* index, uint64_t corners, uint32_t count, bool allow_none)
+	{
+		for (uint64_t i = 0; i < corners; ++i)
+		{
+			if (index[i] >= count && !(allow_none && index[i] == NO_INDEX))
+				return false;
+		}
+		return true;
+	}
+
+	// A mapped mesh is used without copying, so anything a broken file could make the
+	// traversal read out of bounds is checked once here: the vertex indices, and the nodes
+	// forming the depth first tree TraverseLinearBVH walks. Every node but the root has
+	// exactly one parent before it, leaves stay inside the triangles and the tree fits
+	// the traversal stack. This reads the index and node arrays once at load.
+	bool CheckMesh(const MeshView& view)
+	{
+		const uint64_t corners = 3ull * view.triangle_count;
+		if (!IndicesBelow(view.position_index, corners, view.vertex_count, false)
+			|| (view.normal_index && !IndicesBelow(view.normal_index, corners, view.normal_count, true))
+			|| (view.uv_index && !IndicesBelow(view.uv_index, corners, view.uv_count, true)))
+			return false;
+
+		std::vector<uint8_t> depth(view.node_count, 0);	// 0 until a parent points at the node
+		if (view.node_count > 0)
+			depth[0] = 1;
+		for (uint32_t i = 0; i < view.node_count; ++i)
+		{
+			const LinearBVHNode& node = view.nodes[i];
+			if (depth[i] == 0)
+				return false;
+			if (node.primitive_count > 0)
+			{
+				if (node.offset > view.triangle_count || node.primitive_count > view.triangle_count - node.offset)
+					return false;
+				continue;
+			}
+			if (node.axis > 2 || depth[i] > LINEAR_BVH_MAX_DEPTH
+				|| node.offset <= i + 1 || node.offset >= view.node_count
+				|| depth[i + 1] != 0 || depth[node.offset] != 0)
+				return false;
+			depth[i + 1] = depth[node.offset] = static_cast<uint8_t>(depth[i] + 1);
+		}
+		return true;
+	}
+}
+
+bool WriteSceneCache(const std::string& path, const Scene& scene)
+{
+	if (!scene.animation.Empty())
+	{
+		std::cerr << "ERROR: the scene cache can't store animations\n";
+		return false;
+	}
+
+	Writer writer(path, scene.materials);
+	if (!writer.IsOpen())
+	{
+		std::cerr << "ERROR: could not create '" << path << "'\n";
+		return false;
+	}
+
+	uint32_t world = NO_OBJECT;
+	uint32_t lights = NO_OBJECT;
+	if (!writer.AddObject(&scene.world, world)
+		|| (scene.lights && !writer.AddObject(scene.lights.get(), lights))
+		|| !writer.Finish(scene, world, lights))
+	{
+		writer.Discard();
+		return false;
+	}
+	return true;
+}
+
+bool LoadSceneCache(const std::string& path, Scene& scene)
+{
+	auto file = make_shared<MappedFile>();
+	if (!file->Open(path))
+		return false;
+
+	const unsigned char* base = file->Data();
+	const uint64_t size = file->Size();
+	if (size < sizeof(CacheHeader) || memcmp(base, SCENE_CACHE_MAGIC, sizeof(SCENE_CACHE_MAGIC)) != 0)
+	{
+		std::cerr << "ERROR: '" << path << "' is not a scene cache\n";
+		return false;
+	}
+
+	const CacheHeader& header = *reinterpret_cast<const CacheHeader*>(base);
+	if (header.version != SCENE_CACHE_VERSION || header.endian_tag != ENDIAN_TAG)
+	{
+		std::cerr << "ERROR: " << path << ": scene cache version " << header.version
+			<< " can't be read by this build (version " << SCENE_CACHE_VERSION << "), write it again\n";
+		return false;
+	}
+
+	if (header.file_size != size)
+		return Corrupt(path, "wrong size");
+	if (!InFile(header.texture_offset, header.texture_count, sizeof(CacheTexture), size)
+		|| !InFile(header.material_offset, header.material_count, sizeof(CacheMaterial), size)
+		|| !InFile(header.object_offset, header.object_count, sizeof(CacheObject), size)
+		|| !InFile(header.child_offset, header.child_count, sizeof(uint32_t), size))
+		return Corrupt(path, "table outside the file");
+
+	const CacheTexture* texture_records = reinterpret_cast<const CacheTexture*>(base + header.texture_offset);
+	const CacheMaterial* material_records = reinterpret_cast<const CacheMaterial*>(base + header.material_offset);
+	const CacheObject* object_records = reinterpret_cast<const CacheObject*>(base + header.object_offset);
+	const uint32_t* child_ids = reinterpret_cast<const uint32_t*>(base + header.child_offset);
+
+	std::vector<shared_ptr<Texture>> textures(header.texture_count);
+	for (uint32_t i = 0; i < header.texture_count; ++i)
+	{
+		const CacheTexture& record = texture_records[i];
+		if (record.type == TEXTURE_SOLID)
+			textures[i] = make_shared<SolidColor>(GetVec3(record.color));
+		else if (record.type == TEXTURE_IMAGE)
+		{
+			if (record.width <= 0 || record.height <= 0)
+			{
+				textures[i] = make_shared<ImageTexture>();
+				continue;
+			}
+			const uint64_t pixel_count = static_cast<uint64_t>(record.width) * record.height;
+			if (!InFile(record.pixels, pixel_count, ImageTexture::bytes_per_pixel, size))
+				return Corrupt(path, "texture outside the file");
+
+			// shares ownership of the mapping, points at the pixels inside it
+			std::shared_ptr<const unsigned char> pixels(file, base + record.pixels);
+			textures[i] = make_shared<ImageTexture>(pixels, record.width, record.height);
+		}
+		else
+			return Corrupt(path, "unknown texture type");
+	}
+
+	// the materials go to the scene's table, materials[i] is the id of record i - 1
+	std::vector<MaterialID> materials(header.material_count + 1, NO_MATERIAL);
+	for (uint32_t i = 0; i < header.material_count; ++i)
+	{
+		const CacheMaterial& record = material_records[i];
+		if (record.type != MATERIAL_METAL && record.type != MATERIAL_DIELECTRIC && record.texture >= header.texture_count)
+			return Corrupt(path, "texture index");
+
+		shared_ptr<Material> material;
+		switch (record.type)
+		{
+		case MATERIAL_LAMBERTIAN:
+			material = make_shared<Lambertian>(textures[record.texture]);
+			break;
+		case MATERIAL_METAL:
+			material = make_shared<Metal>(GetVec3(record.color), record.param);
+			break;
+		case MATERIAL_DIELECTRIC:
+			material = make_shared<Dielectric>(record.param);
+			break;
+		case MATERIAL_DIFFUSE_LIGHT:
+			material = make_shared<DiffuseLight>(textures[record.texture]);
+			break;
+		case MATERIAL_ISOTROPIC:
+			material = make_shared<Isotropic>(textures[record.texture]);
+			break;
+		default:
+			return Corrupt(path, "unknown material type");
+		}
+		materials[i + 1] = scene.materials.Add(material);
+	}
+
+	std::vector<shared_ptr<Hittable>> objects(header.object_count);
+	for (uint32_t i = 0; i < header.object_count; ++i)
+	{
+		const CacheObject& record = object_records[i];
+		if (record.material > header.material_count
+			|| !InFile(record.first_child, record.child_count, 1, header.child_count))
+			return Corrupt(path, "object index");
+
+		// children come first, anything else would be a cycle
+		std::vector<shared_ptr<Hittable>> children(record.child_count);
+		for (uint32_t c = 0; c < record.child_count; ++c)
+		{
+			uint32_t child = child_ids[record.first_child + c];
+			if (child >= i)
+				return Corrupt(path, "child index");
+			children[c] = objects[child];
+		}
+		const bool one_child = record.child_count == 1;
+
+		const MaterialID material = materials[record.material];
+		const double* p = record.param;
+		switch (record.type)
+		{
+		case OBJECT_LIST:
+		{
+			auto list = make_shared<HittableList>();
+			list->objects = children;
+			objects[i] = list;
+			break;
+		}
+		case OBJECT_XY_RECT:
+			objects[i] = make_shared<XYRect>(p[0], p[1], p[2], p[3], p[4], material);
+			break;
+		case OBJECT_XZ_RECT:
+			objects[i] = make_shared<XZRect>(p[0], p[1], p[2], p[3], p[4], material);
+			break;
+		case OBJECT_YZ_RECT:
+			objects[i] = make_shared<YZRect>(p[0], p[1], p[2], p[3], p[4], material);
+			break;
+		case OBJECT_BOX:
+			objects[i] = make_shared<Box>(GetVec3(p), GetVec3(p + 3), material);
+			break;
+		case OBJECT_BOX_ARRAY:
+		{
+			const uint64_t count = static_cast<uint64_t>(p[0]);
+			if (!(p[0] >= 0) || !InFile(record.mesh, count, 6 * sizeof(double), size) || record.mesh % BLOCK_ALIGNMENT != 0)
+				return Corrupt(path, "box array outside the file");
+			const double* corners = reinterpret_cast<const double*>(base + record.mesh);
+			std::vector<AABB> boxes(count);
+			for (uint64_t b = 0; b < count; ++b)
+				boxes[b] = AABB(GetVec3(corners + 6 * b), GetVec3(corners + 6 * b + 3));
+			objects[i] = make_shared<BoxArray>(boxes, material);
+			break;
+		}
+		case OBJECT_SPHERE:
+			objects[i] = make_shared<Sphere>(GetVec3(p), p[3], material);
+			break;
+		case OBJECT_MEDIUM:
+		{
+			if (!one_child || !dynamic_cast<const Isotropic*>(scene.materials.Get(material)))
+				return Corrupt(path, "medium");
+			auto medium = make_shared<ConstantMedium>(children[0], -1 / p[0], material);
+			medium->neg_inv_density = p[0];
+			objects[i] = medium;
+			break;
+		}
+		case OBJECT_ROTATE_Y:
+		{
+			if (!one_child)
+				return Corrupt(path, "rotation");
+			auto rotate = make_shared<RotateY>(children[0], 0.0);
+			rotate->sin_theta = p[0];
+			rotate->cos_theta = p[1];
+			rotate->hasbox = p[2] != 0.0;
+			rotate->bbox = AABB(GetVec3(p + 3), GetVec3(p + 6));
+			objects[i] = rotate;
+			break;
+		}
+		case OBJECT_TRANSLATE:
+			if (!one_child)
+				return Corrupt(path, "translation");
+			objects[i] = make_shared<Translate>(children[0], GetVec3(p));
+			break;
+		case OBJECT_INSTANCE:
+		{
+			Transform to_world;
+			for (int r = 0; r < 3; ++r)
+			{
+				for (int c = 0; c < 4; ++c)
+					to_world.m[r][c] = static_cast<Real>(p[r * 4 + c]);
+			}
+			Transform to_object;
+			if (!one_child || !to_world.Inverse(to_object))
+				return Corrupt(path, "instance");
+			objects[i] = make_shared<Instance>(children[0], to_world);
+			break;
+		}
+		case OBJECT_FLIP_FACE:
+			if (!one_child)
+				return Corrupt(path, "flipped face");
+			objects[i] = make_shared<FlipFace>(children[0]);
+			break;
+		case OBJECT_MESH:
+		{
+			MeshView view;
+			if (!MapMesh(*file, record.mesh, view))
+				return Corrupt(path, "mesh outside the file");
+			if (!CheckMesh(view))
+				return Corrupt(path, "mesh indices or bvh");
+			objects[i] = make_shared<TriangleMesh>(view, AABB(GetVec3(p), GetVec3(p + 3)), material, file);
+			break;
+		}
+		default:
+			return Corrupt(path, "unknown object type");
+		}
+	}
+
+	auto world = header.world < header.object_count
+		? std::dynamic_pointer_cast<HittableList>(objects[header.world]) : nullptr;
+	if (!world)
+		return Corrupt(path, "no world");
+	shared_ptr<HittableList> lights;
+	if (header.lights != NO_OBJECT)
+	{
+		lights = header.lights < header.object_count
+			? std::dynamic_pointer_cast<HittableList>(objects[header.lights]) : nullptr;
+		if (!lights)
+			return Corrupt(path, "lights");
+	}
+
+	scene.world = *world;
+	scene.lights = lights;
+	scene.camera.lookfrom = GetVec3(header.lookfrom);
+	scene.camera.lookat = GetVec3(header.lookat);
+	scene.camera.vup = GetVec3(header.vup);
+	scene.camera.vfov = header.vfov;
+	scene.camera.aperture = header.aperture;
+	scene.camera.dist_to_focus = header.dist_to_focus;
+	scene.background = GetVec3(header.background);
+	return true;
+}
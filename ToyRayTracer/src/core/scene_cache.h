@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+#include "./scene.h"
+
+// Binary scene cache. Geometry, materials, textures (decoded) and the bvhs of the
+// triangle meshes are written to one file that is later mapped into memory: meshes and
+// image textures use the mapped arrays in place, only the small objects (shapes,
+// wrappers, materials) are created again from fixed size records. The top level
+// acceleration structure is still built by SceneAccel after loading.
+//
+// File layout, little endian, every offset counted from the start of the file:
+//   header | data blocks (64 byte aligned) | textures | materials | objects | child indices
+// The version goes up whenever the layout or a record changes, older files are refused.
+const uint32_t SCENE_CACHE_VERSION = 3;
+
+// Write scene to path, objects the cache can't describe (e.g. bvhs, so write it before
+// building SceneAccel) and animations are reported on std::cerr and return false.
+bool WriteSceneCache(const std::string& path, const Scene& scene);
+
+// Load a scene written by WriteSceneCache, errors are reported on std::cerr and return
+// false. The file stays mapped as long as a mesh or texture of the scene is alive.
+bool LoadSceneCache(const std::string& path, Scene& scene);
@@ -0,0 +1,607 @@
+#include "./scene_file.h"
+
+#include <initializer_list>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#include "./json.h"
+#include "./aarec.h"
+#include "./instance.h"
+#include "./simple_shape.h"
+#include "./materials.h"
+#include "./texture.h"
+#include "./obj_loader.h"
+
+namespace
+{
+	// members every object may have besides its own
+	const char* const TRANSFORM_KEYS[] = { "type", "material", "scale", "rotate", "rotate_y", "translate", "flip" };
+
+	std::string DirectoryOf(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	class SceneFileReader
+	{
+	public:
+		// the materials of the objects go to table, the scene's
+		SceneFileReader(const std::string& file_path, MaterialTable& table)
+			: path(file_path), directory(DirectoryOf(file_path)), table(table) {}
+
+		bool Read(const JsonValue& root, Scene& scene, RenderSettings& settings);
+
+	private:
+		bool Error(const JsonValue& at, const std::string& what)
+		{
+			std::cerr << "ERROR: " << path << ":" << at.line << ": " << what << "\n";
+			return false;
+		}
+
+		// file names are relative to the scene file unless they are absolute
+		std::string Resolve(const std::string& file) const
+		{
+			bool absolute = !file.empty() && (file[0] == '/' || file[0] == '\\' || file.find(':') != std::string::npos);
+			return absolute ? file : directory + file;
+		}
+
+		bool CheckKeys(const JsonValue& object, std::initializer_list<const char*> keys, bool transforms = false);
+		bool GetNumber(const JsonValue& object, const char* key, double& value, bool required = true);
+		bool GetVec3(const JsonValue& object, const char* key, Vec3& value, bool required = true);
+		bool GetRange(const JsonValue& object, const char* key, double& lo, double& hi);
+		bool GetString(const JsonValue& object, const char* key, std::string& value);
+
+		template<typename T>
+		bool ReadKeyframes(const JsonValue& value, const char* key, int size, Keyframes<T>& keys);
+		bool ReadTexture(const JsonValue& value, shared_ptr<Texture>& texture);
+		bool ReadColorOrTexture(const JsonValue& object, const char* key, shared_ptr<Texture>& texture);
+		bool ReadMaterial(const JsonValue& value, shared_ptr<Material>& material);
+		bool ReadObject(const JsonValue& value, bool material_required, shared_ptr<Hittable>& object);
+		bool ReadObjects(const JsonValue& root, const char* key, bool material_required, HittableList& list);
+		bool ReadTransforms(const JsonValue& value, shared_ptr<Hittable>& object);
+		bool ReadCamera(const JsonValue& camera, Scene& scene);
+		bool ReadRender(const JsonValue& render, RenderSettings& settings);
+
+	private:
+		std::string path;
+		std::string directory;
+		MaterialTable& table;
+		std::unordered_map<std::string, shared_ptr<Texture>> textures;
+		std::unordered_map<std::string, shared_ptr<Material>> materials;
+		std::unordered_map<std::string, shared_ptr<Hittable>> shapes;
+		Animation animation;
+	};
+
+	double KeyValue(const JsonValue* numbers, double) { return numbers[0].number; }
+	Vec3 KeyValue(const JsonValue* numbers, Vec3) { return Vec3(numbers[0].number, numbers[1].number, numbers[2].number); }
+
+	bool SceneFileReader::CheckKeys(const JsonValue& object, std::initializer_list<const char*> keys, bool transforms)
+	{
+		if (!object.IsObject())
+			return Error(object, std::string("expected an object, found ") + object.TypeName());
+
+		for (const auto& member : object.members)
+		{
+			bool known = false;
+			for (const char* key : keys)
+				known = known || member.first == key;
+			if (transforms)
+			{
+				for (const char* key : TRANSFORM_KEYS)
+					known = known || member.first == key;
+			}
+			if (!known)
+				return Error(member.second, "unknown member '" + member.first + "'");
+		}
+		return true;
+	}
+
+	bool SceneFileReader::GetNumber(const JsonValue& object, const char* key, double& value, bool required)
+	{
+		const JsonValue* found = object.Find(key);
+		if (!found)
+			return !required || Error(object, std::string("'") + key + "' is missing");
+		if (!found->IsNumber())
+			return Error(*found, std::string("'") + key + "' should be a number");
+		value = found->number;
+		return true;
+	}
+
+	bool SceneFileReader::GetVec3(const JsonValue& object, const char* key, Vec3& value, bool required)
+	{
+		const JsonValue* found = object.Find(key);
+		if (!found)
+			return !required || Error(object, std::string("'") + key + "' is missing");
+		if (!found->IsArray() || found->items.size() != 3
+			|| !found->items[0].IsNumber() || !found->items[1].IsNumber() || !found->items[2].IsNumber())
+			return Error(*found, std::string("'") + key + "' should be three numbers [x, y, z]");
+		value = Vec3(found->items[0].number, found->items[1].number, found->items[2].number);
+		return true;
+	}
+
+	bool SceneFileReader::GetRange(const JsonValue& object, const char* key, double& lo, double& hi)
+	{
+		const JsonValue* found = object.Find(key);
+		if (!found)
+			return Error(object, std::string("'") + key + "' is missing");
+		if (!found->IsArray() || found->items.size() != 2 || !found->items[0].IsNumber() || !found->items[1].IsNumber())
+			return Error(*found, std::string("'") + key + "' should be two numbers [min, max]");
+		lo = found->items[0].number;
+		hi = found->items[1].number;
+		return true;
+	}
+
+	bool SceneFileReader::GetString(const JsonValue& object, const char* key, std::string& value)
+	{
+		const JsonValue* found = object.Find(key);
+		if (!found)
+			return Error(object, std::string("'") + key + "' is missing");
+		if (!found->IsString())
+			return Error(*found, std::string("'") + key + "' should be a string");
+		value = found->string;
+		return true;
+	}
+
+	// a fixed value of size numbers, or keys [[frame, value...], ...] in increasing frames
+	template<typename T>
+	bool SceneFileReader::ReadKeyframes(const JsonValue& value, const char* key, int size, Keyframes<T>& keys)
+	{
+		const std::string what = std::string("'") + key + "' should be " + (size == 1 ? "a number" : "three numbers [x, y, z]")
+			+ " or keyframes [[frame, " + (size == 1 ? "value" : "x, y, z") + "], ...]";
+
+		auto numbers = [&](const JsonValue& list, size_t count) {
+			if (!list.IsArray() || list.items.size() != count)
+				return false;
+			for (const auto& item : list.items)
+			{
+				if (!item.IsNumber())
+					return false;
+			}
+			return true;
+		};
+
+		if (size == 1 && value.IsNumber())
+			keys.Add(0, KeyValue(&value, T()));
+		else if (size > 1 && numbers(value, size))
+			keys.Add(0, KeyValue(value.items.data(), T()));
+		else if (value.IsArray() && !value.items.empty())
+		{
+			for (const auto& item : value.items)
+			{
+				if (!numbers(item, size + 1))
+					return Error(item, what);
+				if (!keys.times.empty() && !(item.items[0].number > keys.times.back()))
+					return Error(item, "keyframes should be in increasing frames");
+				keys.Add(item.items[0].number, KeyValue(item.items.data() + 1, T()));
+			}
+		}
+		else
+			return Error(value, what);
+		return true;
+	}
+
+	bool SceneFileReader::ReadTexture(const JsonValue& value, shared_ptr<Texture>& texture)
+	{
+		if (value.IsString())
+		{
+			auto found = textures.find(value.string);
+			if (found == textures.end())
+				return Error(value, "there is no texture '" + value.string + "'");
+			texture = found->second;
+			return true;
+		}
+
+		std::string type;
+		if (!CheckKeys(value, { "type", "color", "file" }) || !GetString(value, "type", type))
+			return false;
+
+		if (type == "solid")
+		{
+			Color color;
+			if (!GetVec3(value, "color", color))
+				return false;
+			texture = make_shared<SolidColor>(color);
+		}
+		else if (type == "image")
+		{
+			std::string file;
+			if (!GetString(value, "file", file))
+				return false;
+			auto image = LoadImageTexture(Resolve(file));
+			if (!image)
+				return Error(value, "could not load the image");
+			texture = image;
+		}
+		else
+			return Error(value, "unknown texture type '" + type + "'");
+		return true;
+	}
+
+	bool SceneFileReader::ReadColorOrTexture(const JsonValue& object, const char* key, shared_ptr<Texture>& texture)
+	{
+		const JsonValue* found = object.Find(key);
+		if (found && found->IsArray())
+		{
+			Color color;
+			if (!GetVec3(object, key, color))
+				return false;
+			texture = make_shared<SolidColor>(color);
+			return true;
+		}
+		if (!found)
+			return Error(object, std::string("'") + key + "' is missing");
+		return ReadTexture(*found, texture);
+	}
+
+	bool SceneFileReader::ReadMaterial(const JsonValue& value, shared_ptr<Material>& material)
+	{
+		if (value.IsString())
+		{
+			auto found = materials.find(value.string);
+			if (found == materials.end())
+				return Error(value, "there is no material '" + value.string + "'");
+			material = found->second;
+			return true;
+		}
+
+		std::string type;
+		if (!CheckKeys(value, { "type", "albedo", "fuzz", "ior", "emit" }) || !GetString(value, "type", type))
+			return false;
+
+		if (type == "lambertian")
+		{
+			shared_ptr<Texture> albedo;
+			if (!ReadColorOrTexture(value, "albedo", albedo))
+				return false;
+			material = make_shared<Lambertian>(albedo);
+		}
+		else if (type == "metal")
+		{
+			Color albedo;
+			double fuzz = 0;
+			if (!GetVec3(value, "albedo", albedo) || !GetNumber(value, "fuzz", fuzz, false))
+				return false;
+			material = make_shared<Metal>(albedo, fuzz);
+		}
+		else if (type == "dielectric")
+		{
+			double ior;
+			if (!GetNumber(value, "ior", ior))
+				return false;
+			material = make_shared<Dielectric>(ior);
+		}
+		else if (type == "diffuse_light")
+		{
+			shared_ptr<Texture> emit;
+			if (!ReadColorOrTexture(value, "emit", emit))
+				return false;
+			material = make_shared<DiffuseLight>(emit);
+		}
+		else
+			return Error(value, "unknown material type '" + type + "'");
+		return true;
+	}
+
+	bool SceneFileReader::ReadObject(const JsonValue& value, bool material_required, shared_ptr<Hittable>& object)
+	{
+		std::string type;
+		if (!value.IsObject())
+			return Error(value, std::string("expected an object, found ") + value.TypeName());
+		if (!GetString(value, "type", type))
+			return false;
+
+		shared_ptr<Material> material;
+		const JsonValue* material_value = value.Find("material");
+		bool needs_material = type != "list" && type != "medium" && type != "instance";
+		if (material_value && needs_material)
+		{
+			if (!ReadMaterial(*material_value, material))
+				return false;
+		}
+		else if (material_value)
+			return Error(*material_value, "a " + type + " has no material of its own");
+		else if (material_required && needs_material)
+			return Error(value, "'material' is missing");
+		const MaterialID mat_id = table.Add(material);
+
+		if (type == "sphere")
+		{
+			Point3 center;
+			double radius;
+			if (!CheckKeys(value, { "center", "radius" }, true)
+				|| !GetVec3(value, "center", center) || !GetNumber(value, "radius", radius))
+				return false;
+			object = make_shared<Sphere>(center, radius, mat_id);
+		}
+		else if (type == "moving_sphere")
+		{
+			Point3 center0, center1;
+			double time0, time1, radius;
+			if (!CheckKeys(value, { "center0", "center1", "time0", "time1", "radius" }, true)
+				|| !GetVec3(value, "center0", center0) || !GetVec3(value, "center1", center1)
+				|| !GetNumber(value, "time0", time0) || !GetNumber(value, "time1", time1)
+				|| !GetNumber(value, "radius", radius))
+				return false;
+			if (!(time1 > time0))
+				return Error(value, "'time1' should be after 'time0'");
+			object = make_shared<MovingSphere>(center0, center1, time0, time1, radius, mat_id);
+			animation.moving.push_back(object);
+		}
+		else if (type == "xy_rect" || type == "xz_rect" || type == "yz_rect")
+		{
+			// the two axes in the plane, k is the position along the third
+			const char* a = type == "yz_rect" ? "y" : "x";
+			const char* b = type == "xy_rect" ? "y" : "z";
+			double a0, a1, b0, b1, k;
+			if (!CheckKeys(value, { a, b, "k" }, true)
+				|| !GetRange(value, a, a0, a1) || !GetRange(value, b, b0, b1) || !GetNumber(value, "k", k))
+				return false;
+			if (type == "xy_rect")
+				object = make_shared<XYRect>(a0, a1, b0, b1, k, mat_id);
+			else if (type == "xz_rect")
+				object = make_shared<XZRect>(a0, a1, b0, b1, k, mat_id);
+			else
+				object = make_shared<YZRect>(a0, a1, b0, b1, k, mat_id);
+		}
+		else if (type == "box")
+		{
+			Point3 box_min, box_max;
+			if (!CheckKeys(value, { "min", "max" }, true)
+				|| !GetVec3(value, "min", box_min) || !GetVec3(value, "max", box_max))
+				return false;
+			object = make_shared<Box>(box_min, box_max, mat_id);
+		}
+		else if (type == "mesh")
+		{
+			std::string file;
+			if (!CheckKeys(value, { "file" }, true) || !GetString(value, "file", file))
+				return false;
+			object = LoadOBJMesh(Resolve(file), mat_id);
+			if (!object)
+				return Error(value, "could not load the mesh");
+		}
+		else if (type == "medium")
+		{
+			shared_ptr<Hittable> boundary;
+			shared_ptr<Texture> albedo;
+			double density;
+			const JsonValue* boundary_value = value.Find("boundary");
+			if (!CheckKeys(value, { "boundary", "density", "albedo" }, true))
+				return false;
+			if (!boundary_value)
+				return Error(value, "'boundary' is missing");
+			if (!ReadObject(*boundary_value, false, boundary)
+				|| !GetNumber(value, "density", density) || !ReadColorOrTexture(value, "albedo", albedo))
+				return false;
+			object = make_shared<ConstantMedium>(boundary, density, table.Add(make_shared<Isotropic>(albedo)));
+		}
+		else if (type == "list")
+		{
+			auto list = make_shared<HittableList>();
+			if (!CheckKeys(value, { "objects" }, true) || !ReadObjects(value, "objects", material_required, *list))
+				return false;
+			object = list;
+		}
+		else if (type == "instance")
+		{
+			std::string name;
+			if (!CheckKeys(value, { "shape" }, true) || !GetString(value, "shape", name))
+				return false;
+			auto found = shapes.find(name);
+			if (found == shapes.end())
+				return Error(value, "there is no shape '" + name + "'");
+			object = found->second;
+		}
+		else
+			return Error(value, "unknown object type '" + type + "'");
+
+		return ReadTransforms(value, object);
+	}
+
+	// The steps that don't move are gathered in one Instance, an animated rotation or
+	// translation keeps its own wrapper, so it can be turned or moved from frame to frame.
+	bool SceneFileReader::ReadTransforms(const JsonValue& value, shared_ptr<Hittable>& object)
+	{
+		Transform pending;
+		auto flush = [&]() {
+			if (!pending.IsIdentity())
+				object = make_shared<Instance>(object, pending);
+			pending = Transform();
+		};
+
+		if (const JsonValue* scale = value.Find("scale"))
+		{
+			Vec3 factors;
+			if (scale->IsNumber())
+				factors = Vec3(scale->number, scale->number, scale->number);
+			else if (!GetVec3(value, "scale", factors))
+				return false;
+			if (factors.x() == 0 || factors.y() == 0 || factors.z() == 0)
+				return Error(*scale, "'scale' can't be 0");
+			pending = Transform::Scale(factors);
+		}
+		if (value.Find("rotate"))
+		{
+			Vec3 angles;
+			if (!GetVec3(value, "rotate", angles))
+				return false;
+			pending = Transform::Rotation(Vec3(0, 0, 1), angles.z()) * Transform::Rotation(Vec3(0, 1, 0), angles.y())
+				* Transform::Rotation(Vec3(1, 0, 0), angles.x()) * pending;
+		}
+		if (const JsonValue* rotate = value.Find("rotate_y"))
+		{
+			Keyframes<double> keys;
+			if (!ReadKeyframes(*rotate, "rotate_y", 1, keys))
+				return false;
+			if (keys.times.size() > 1)
+			{
+				flush();
+				auto rotated = make_shared<RotateY>(object, keys.values.front());
+				rotated->motion = keys;
+				rotated->UpdateBox();
+				animation.rotations.push_back(rotated);
+				object = rotated;
+			}
+			else
+				pending = Transform::Rotation(Vec3(0, 1, 0), keys.values.front()) * pending;
+		}
+		if (const JsonValue* translate = value.Find("translate"))
+		{
+			Keyframes<Vec3> keys;
+			if (!ReadKeyframes(*translate, "translate", 3, keys))
+				return false;
+			if (keys.times.size() > 1)
+			{
+				flush();
+				auto translated = make_shared<Translate>(object, keys.values.front());
+				translated->motion = keys;
+				animation.translations.push_back(translated);
+				object = translated;
+			}
+			else
+				pending = Transform::Translation(keys.values.front()) * pending;
+		}
+		flush();
+
+		if (const JsonValue* flip = value.Find("flip"))
+		{
+			if (flip->type != JsonValue::Type::Bool)
+				return Error(*flip, "'flip' should be true or false");
+			if (flip->boolean)
+				object = make_shared<FlipFace>(object);
+		}
+		return true;
+	}
+
+	bool SceneFileReader::ReadObjects(const JsonValue& root, const char* key, bool material_required, HittableList& list)
+	{
+		const JsonValue* objects = root.Find(key);
+		if (!objects)
+			return true;
+		if (!objects->IsArray())
+			return Error(*objects, std::string("'") + key + "' should be an array of objects");
+
+		for (const auto& item : objects->items)
+		{
+			shared_ptr<Hittable> object;
+			if (!ReadObject(item, material_required, object))
+				return false;
+			list.add(object);
+		}
+		return true;
+	}
+
+	bool SceneFileReader::ReadCamera(const JsonValue& camera, Scene& scene)
+	{
+		return CheckKeys(camera, { "lookfrom", "lookat", "vup", "vfov", "aperture", "focus_dist" })
+			&& GetVec3(camera, "lookfrom", scene.camera.lookfrom, false)
+			&& GetVec3(camera, "lookat", scene.camera.lookat, false)
+			&& GetVec3(camera, "vup", scene.camera.vup, false)
+			&& GetNumber(camera, "vfov", scene.camera.vfov, false)
+			&& GetNumber(camera, "aperture", scene.camera.aperture, false)
+			&& GetNumber(camera, "focus_dist", scene.camera.dist_to_focus, false);
+	}
+
+	// the members go through SetRenderOption, so files and the command line share names
+	bool SceneFileReader::ReadRender(const JsonValue& render, RenderSettings& settings)
+	{
+		if (!render.IsObject())
+			return Error(render, std::string("expected an object, found ") + render.TypeName());
+
+		for (const auto& member : render.members)
+		{
+			std::ostringstream text;
+			const JsonValue& value = member.second;
+			if (value.IsNumber())
+			{
+				text.precision(17);
+				text << value.number;
+			}
+			else if (value.IsString())
+				text << value.string;
+			else if (value.type == JsonValue::Type::Bool)
+				text << (value.boolean ? "true" : "false");
+			else
+				return Error(value, "render option '" + member.first + "' should be a number, string or boolean");
+
+			if (!SetRenderOption(settings, member.first, text.str()))
+				return Error(value, "in the render block");
+		}
+		return true;
+	}
+
+	bool SceneFileReader::Read(const JsonValue& root, Scene& scene, RenderSettings& settings)
+	{
+		if (!CheckKeys(root, { "camera", "background", "render", "textures", "materials", "shapes", "objects", "lights" }))
+			return false;
+
+		const JsonValue* camera = root.Find("camera");
+		const JsonValue* render = root.Find("render");
+		if ((camera && !ReadCamera(*camera, scene))
+			|| !GetVec3(root, "background", scene.background, false)
+			|| (render && !ReadRender(*render, settings)))
+			return false;
+
+		// named textures and materials, in the order of the file so later ones can use earlier ones
+		const JsonValue* texture_defs = root.Find("textures");
+		if (texture_defs)
+		{
+			if (!texture_defs->IsObject())
+				return Error(*texture_defs, "'textures' should be an object of named textures");
+			for (const auto& member : texture_defs->members)
+			{
+				shared_ptr<Texture> texture;
+				if (!ReadTexture(member.second, texture))
+					return false;
+				textures[member.first] = texture;
+			}
+		}
+
+		const JsonValue* material_defs = root.Find("materials");
+		if (material_defs)
+		{
+			if (!material_defs->IsObject())
+				return Error(*material_defs, "'materials' should be an object of named materials");
+			for (const auto& member : material_defs->members)
+			{
+				shared_ptr<Material> material;
+				if (!ReadMaterial(member.second, material))
+					return false;
+				materials[member.first] = material;
+			}
+		}
+
+		// named objects, built once and placed by any number of instances
+		const JsonValue* shape_defs = root.Find("shapes");
+		if (shape_defs)
+		{
+			if (!shape_defs->IsObject())
+				return Error(*shape_defs, "'shapes' should be an object of named objects");
+			for (const auto& member : shape_defs->members)
+			{
+				shared_ptr<Hittable> shape;
+				if (!ReadObject(member.second, true, shape))
+					return false;
+				shapes[member.first] = shape;
+			}
+		}
+
+		scene.lights = make_shared<HittableList>();
+		if (!ReadObjects(root, "objects", true, scene.world) || !ReadObjects(root, "lights", false, *scene.lights))
+			return false;
+		scene.animation = animation;
+		return true;
+	}
+}
+
+bool LoadSceneFile(const std::string& path, Scene& scene, RenderSettings& settings)
+{
+	JsonValue root;
+	if (!ReadJsonFile(path, root))
+		return false;
+
+	SceneFileReader reader(path, scene.materials);
+	return reader.Read(root, scene, settings);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+
+#include "./scene.h"
+#include "./render_settings.h"
+
+// Build scene from a json scene file and apply its "render" block to settings, see
+// src/scenes for complete examples. The top level members are all optional:
+//   "camera":    { "lookfrom", "lookat", "vup": [x, y, z], "vfov", "aperture", "focus_dist" }
+//   "background": [r, g, b]
+//   "render":    { render options by name, see SetRenderOption }
+//   "textures":  { name: { "type": "solid", "color" } | { "type": "image", "file" } }
+//   "materials": { name: { "type": "lambertian", "albedo" } | { "type": "metal", "albedo", "fuzz" }
+//                      | { "type": "dielectric", "ior" } | { "type": "diffuse_light", "emit" } }
+//   "shapes":    { name: object, placed by { "type": "instance", "shape": name } objects }
+//   "objects":   [ objects ]
+//   "lights":    [ objects sampled directly by the integrator, materials are optional ]
+// Objects are { "type": "sphere", "center", "radius" } | { "type": "moving_sphere",
+// "center0", "center1", "time0", "time1" (frames), "radius" } | { "type": "xy_rect",
+// "x": [x0, x1], "y": [y0, y1], "k" } (xz_rect, yz_rect alike) | { "type": "box", "min",
+// "max" } | { "type": "mesh", "file" } (wavefront obj) | { "type": "medium", "boundary":
+// object, "density", "albedo" } | { "type": "list", "objects": [ objects ] } | { "type":
+// "instance", "shape" }, each with a "material" (lists, media and instances have none of
+// their own) and optionally "scale" (a number or [x, y, z]), "rotate" ([x, y, z] degrees
+// about x, then y, then z), "rotate_y" (degrees), "translate" ([x, y, z]) and "flip"
+// (true), applied in that order. The fixed ones become a single Instance. rotate_y and
+// translate can be animated with keyframes instead, [[frame, degrees], ...] and
+// [[frame, x, y, z], ...], which go to scene.animation. Materials and textures are given by name or written inline, albedo
+// and emit take a color [r, g, b] or a texture. Relative file names start at the scene file.
+// Errors are reported on std::cerr with the line they were found on and return false.
+bool LoadSceneFile(const std::string& path, Scene& scene, RenderSettings& settings);
@@ -0,0 +1,125 @@
+#include "./scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+TileScheduler::TileScheduler(int image_width, int image_height, int tile_size, int threads)
+	: tiles_done(0), cancelled(false), thread_count(threads)
+{
+	if (thread_count <= 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	for (int y = 0; y < image_height; y += tile_size)
+		for (int x = 0; x < image_width; x += tile_size)
+			tiles.push_back({ x, y, std::min(x + tile_size, image_width), std::min(y + tile_size, image_height) });
+
+	for (int w = 0; w < thread_count; ++w)
+		queues.emplace_back(new WorkQueue());
+}
+
+void TileScheduler::FillQueues()
+{
+	// contiguous runs keep neighbouring tiles (and their bvh nodes) on the same core
+	for (int w = 0; w < thread_count; ++w)
+	{
+		std::lock_guard<std::mutex> lock(queues[w]->mutex);
+		queues[w]->tiles.clear();
+		size_t begin = tiles.size() * w / thread_count;
+		size_t end = tiles.size() * (w + 1) / thread_count;
+		for (size_t t = begin; t < end; ++t)
+			queues[w]->tiles.push_back(static_cast<int>(t));
+	}
+}
+
+bool TileScheduler::NextTile(int worker, int& tile)
+{
+	if (cancelled)
+		return false;
+
+	{
+		WorkQueue& own = *queues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tiles.empty())
+		{
+			tile = own.tiles.front();
+			own.tiles.pop_front();
+			return true;
+		}
+	}
+
+	// steal from the far end of another queue, away from where its owner is working
+	for (int i = 1; i < thread_count; ++i)
+	{
+		WorkQueue& victim = *queues[(worker + i) % thread_count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tiles.empty())
+		{
+			tile = victim.tiles.back();
+			victim.tiles.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TileScheduler::Worker(int worker, const std::function<void(const Tile&)>& render_tile)
+{
+	int tile;
+	while (NextTile(worker, tile))
+	{
+		render_tile(tiles[tile]);
+		++tiles_done;
+	}
+}
+
+bool TileScheduler::Run(const std::function<void(const Tile&)>& render_tile)
+{
+	using clock = std::chrono::steady_clock;
+	const auto start = clock::now();
+	const int total = TileCount();
+	tiles_done = 0;
+	FillQueues();
+
+	std::vector<std::thread> workers;
+	for (int w = 1; w < thread_count; ++w)
+		workers.emplace_back(&TileScheduler::Worker, this, w, std::cref(render_tile));
+
+	// the calling thread renders too, and reports progress from a helper thread
+	std::mutex report_mutex;
+	std::condition_variable report_cv;
+	bool finished = false;
+	std::thread reporter([&]() {
+		std::unique_lock<std::mutex> lock(report_mutex);
+		while (!report_cv.wait_for(lock, std::chrono::milliseconds(500), [&]() { return finished; }))
+		{
+			int done = tiles_done;
+			double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			double rate = done / std::max(elapsed, 1e-6);
+			double eta = done > 0 ? (total - done) / rate : 0.0;
+			std::ostringstream line;
+			line << "\rtiles " << done << "/" << total << "  " << std::fixed << std::setprecision(1)
+				<< rate << " tiles/s  ETA " << eta << "s   ";
+			std::cerr << line.str() << std::flush;
+		}
+	});
+
+	Worker(0, render_tile);
+	for (auto& t : workers)
+		t.join();
+
+	{
+		std::lock_guard<std::mutex> lock(report_mutex);
+		finished = true;
+	}
+	report_cv.notify_one();
+	reporter.join();
+	std::cerr << "\rtiles " << tiles_done << "/" << total << (cancelled ? "  cancelled" : "") << "                    \n";
+
+	return !cancelled;
+}
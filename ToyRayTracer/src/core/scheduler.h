@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// rectangle of pixels [x0,x1) x [y0,y1)
+struct Tile
+{
+	int x0, y0;
+	int x1, y1;
+};
+
+// Splits the image into tiles and renders them on a pool of threads. Every worker starts
+// with a contiguous run of tiles in its own queue and steals from the back of the other
+// queues once it runs dry, so expensive regions (glass, fog) don't leave cores idle.
+class TileScheduler
+{
+public:
+	// thread_count 0 uses every hardware thread
+	TileScheduler(int image_width, int image_height, int tile_size = 32, int thread_count = 0);
+
+	// Render every tile, blocking until all are done or Cancel() is called. Progress
+	// (tiles/s and ETA) is reported on std::cerr. Returns false if the render was cancelled.
+	// Can be called again for another pass over the image.
+	bool Run(const std::function<void(const Tile&)>& render_tile);
+
+	// Stop handing out tiles, tiles already started are finished. Safe to call from any
+	// thread or from a signal handler.
+	void Cancel() { cancelled = true; }
+	bool IsCancelled() const { return cancelled; }
+
+	int ThreadCount() const { return thread_count; }
+	int TileCount() const { return static_cast<int>(tiles.size()); }
+
+private:
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<int> tiles;
+	};
+
+	void FillQueues();
+	bool NextTile(int worker, int& tile);
+	void Worker(int worker, const std::function<void(const Tile&)>& render_tile);
+
+private:
+	std::vector<Tile> tiles;
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::atomic<int> tiles_done;
+	std::atomic<bool> cancelled;
+	int thread_count;
+};
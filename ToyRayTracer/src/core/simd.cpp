@@ -0,0 +1,47 @@
+#include "./simd.h"
+
+namespace
+{
+	SimdLevel QuerySimdLevel()
+	{
+#if TOYRT_X86
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return SimdLevel::AVX2;
+		return SimdLevel::SSE;
+#else
+		int info[4];
+		__cpuid(info, 0);
+		int max_leaf = info[0];
+		__cpuid(info, 1);
+		bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+		if (os_saves_ymm && max_leaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5))
+				return SimdLevel::AVX2;
+		}
+		return SimdLevel::SSE;
+#endif
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+}
+
+SimdLevel DetectSimdLevel()
+{
+	static const SimdLevel level = QuerySimdLevel();
+	return level;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::AVX2: return "avx2";
+	case SimdLevel::SSE: return "sse";
+	default: return "scalar";
+	}
+}
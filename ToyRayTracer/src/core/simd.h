@@ -0,0 +1,33 @@
+#pragma once
+
+// x86 simd support, the sse path is always built on x86-64 while the avx2 path is compiled
+// per function and only entered when the running cpu reports avx2
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TOYRT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define TOYRT_X86 0
+#endif
+
+// gcc and clang only accept avx2 intrinsics inside functions compiled for avx2, msvc
+// accepts them anywhere
+#if TOYRT_X86 && (defined(__GNUC__) || defined(__clang__))
+#define TOYRT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TOYRT_TARGET_AVX2
+#endif
+
+enum class SimdLevel
+{
+	Scalar,
+	SSE,
+	AVX2
+};
+
+// best instruction set supported by the cpu, detected once
+SimdLevel DetectSimdLevel();
+
+const char* SimdLevelName(SimdLevel level);
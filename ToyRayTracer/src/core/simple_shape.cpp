@@ -2,6 +2,28 @@
 
 #include "./onb.h"
 
+namespace
+{
+	// whether the sphere at center is hit between t_min and t_max
+	bool HitsSphere(const Point3& center, Real radius, const Ray& r, double t_min, double t_max)
+	{
+		Vec3 oc = r.Origin() - center;
+		auto a = r.Direction().LengthSquared();
+		auto half_b = DotProduct(oc, r.Direction());
+		auto c = oc.LengthSquared() - radius * radius;
+
+		auto discriminant = half_b * half_b - a * c;
+		if (discriminant < 0) return false;
+		auto sqrtd = sqrt(discriminant);
+
+		auto root = (-half_b - sqrtd) / a;
+		if (root >= t_min && root <= t_max)
+			return true;
+		root = (-half_b + sqrtd) / a;
+		return root >= t_min && root <= t_max;
+	}
+}
+
 // ---Box---
 
 bool Box::BoundingBox(AABB& output_box) const 
@@ -10,23 +32,24 @@ bool Box::BoundingBox(AABB& output_box) const
 	return true;
 }
 
-Box::Box(const Point3& p0, const Point3& p1, shared_ptr<Material> ptr) {
-	box_min = p0;
-	box_max = p1;
-
-	sides.add(make_shared<XYRect>(p0.x(), p1.x(), p0.y(), p1.y(), p1.z(), ptr));
-	sides.add(make_shared<XYRect>(p0.x(), p1.x(), p0.y(), p1.y(), p0.z(), ptr));
-
-	sides.add(make_shared<XZRect>(p0.x(), p1.x(), p0.z(), p1.z(), p1.y(), ptr));
-	sides.add(make_shared<XZRect>(p0.x(), p1.x(), p0.z(), p1.z(), p0.y(), ptr));
+bool Box::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
+{
+	const Vec3 d = r.Direction();
+	double t;
+	int face;
+	if (!Intersect(box_min.e, box_max.e, r.Origin(), Vec3(1.0 / d.x(), 1.0 / d.y(), 1.0 / d.z()), t_min, t_max, t, face))
+		return false;
 
-	sides.add(make_shared<YZRect>(p0.y(), p1.y(), p0.z(), p1.z(), p1.x(), ptr));
-	sides.add(make_shared<YZRect>(p0.y(), p1.y(), p0.z(), p1.z(), p0.x(), ptr));
+	FillHitRecord(box_min.e, box_max.e, r, t, face, mat_id, rec);
+	return true;
 }
 
-bool Box::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
+bool Box::Occluded(const Ray& r, double t_min, double t_max) const
 {
-	return sides.Hit(r, t_min, t_max, rec);
+	const Vec3 d = r.Direction();
+	double t;
+	int face;
+	return Intersect(box_min.e, box_max.e, r.Origin(), Vec3(1.0 / d.x(), 1.0 / d.y(), 1.0 / d.z()), t_min, t_max, t, face);
 }
 
 // ---Sphere---
@@ -57,11 +80,16 @@ bool Sphere::Hit(const Ray& r, double tMin, double tMax, HitRecord& rec) const
 	Vec3 outwardNormal = (rec.p - center) / radius;
 	rec.SetFaceNormal(r, outwardNormal);
 	GetSphereUV(outwardNormal, rec.u, rec.v);
-	rec.mat_ptr = mat_ptr;
+	rec.mat_id = mat_id;
 
 	return true;
 }
 
+bool Sphere::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	return HitsSphere(center, radius, r, t_min, t_max);
+}
+
 bool Sphere::BoundingBox(AABB& output_box) const
 {
 	// ֱͨӷ½ǺϽǹɵaabbУܼ
@@ -71,8 +99,7 @@ bool Sphere::BoundingBox(AABB& output_box) const
 
 double Sphere::PDFValue(const Point3& o, const Vec3& v) const 
 {
-	HitRecord rec;
-	if (!this->Hit(Ray(o, v), 0.001, INF, rec))
+	if (!Occluded(Ray(o, v), 0.001, INF))
 		return 0;
 
 	auto cos_theta_max = sqrt(1 - radius * radius / (center - o).LengthSquared());
@@ -90,6 +117,70 @@ Vec3 Sphere::Random(const Point3& o) const
 	return uvw.Local(random_to_sphere(radius, distance_squared));
 }
 
+// ---MovingSphere---
+
+MovingSphere::MovingSphere(Point3 center0, Point3 center1, double time0, double time1, double r, MaterialID m)
+	: radius(r), mat_id(m)
+{
+	path.Add(time0, center0);
+	if (time1 > time0)
+		path.Add(time1, center1);
+}
+
+bool MovingSphere::Hit(const Ray& r, double tMin, double tMax, HitRecord& rec) const
+{
+	// the sphere where it is at the ray's time
+	const Point3 center = Center(r.Time());
+	Vec3 oc = r.Origin() - center;
+	auto a = r.Direction().LengthSquared();
+	auto half_b = DotProduct(oc, r.Direction());
+	auto c = oc.LengthSquared() - radius * radius;
+
+	auto discriminant = half_b * half_b - a * c;
+	if (discriminant < 0) return false;
+	auto sqrtd = sqrt(discriminant);
+
+	auto root = (-half_b - sqrtd) / a;
+	if (root < tMin || root > tMax)
+	{
+		root = (-half_b + sqrtd) / a;
+		if (root < tMin || root > tMax)
+			return false;
+	}
+
+	rec.t = root;
+	rec.p = r.At(rec.t);
+	Vec3 outwardNormal = (rec.p - center) / radius;
+	rec.SetFaceNormal(r, outwardNormal);
+	Sphere::GetSphereUV(outwardNormal, rec.u, rec.v);
+	rec.mat_id = mat_id;
+
+	return true;
+}
+
+bool MovingSphere::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	return HitsSphere(Center(r.Time()), radius, r, t_min, t_max);
+}
+
+bool MovingSphere::BoundingBox(AABB& output_box) const
+{
+	const Vec3 r(radius, radius, radius);
+	output_box = SurroundingBox(AABB(path.values.front() - r, path.values.front() + r),
+		AABB(path.values.back() - r, path.values.back() + r));
+	return true;
+}
+
+bool MovingSphere::MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const
+{
+	Vec3 lo0, lo1, hi0, hi1;
+	path.LinearBounds(time0, time1, lo0, lo1, hi0, hi1);
+	const Vec3 r(radius, radius, radius);
+	box0 = AABB(lo0 - r, hi0 + r);
+	box1 = AABB(lo1 - r, hi1 + r);
+	return true;
+}
+
 // ---ConstantMedium---
 
 bool ConstantMedium::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
@@ -140,7 +231,7 @@ bool ConstantMedium::Hit(const Ray& r, double t_min, double t_max, HitRecord& re
 
 	rec.normal = Vec3(1, 0, 0);  // arbitrary
 	rec.is_front_face = true;     // also arbitrary
-	rec.mat_ptr = phase_function;
+	rec.mat_id = phase_function;
 
 	return true;
 }
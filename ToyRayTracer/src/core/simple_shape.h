@@ -4,39 +4,114 @@
 #include "./hittable.h"
 #include "./materials.h"
 
+// Axis aligned box, intersected as one slab test. Its sides are textured like the rects
+// they replace and their normals face out of the box.
 class Box : public Hittable {
 public:
 	Box() {}
-	Box(const Point3& p0, const Point3& p1, shared_ptr<Material> ptr);
+	Box(const Point3& p0, const Point3& p1, MaterialID m)
+		: box_min(p0), box_max(p1), mat_id(m) {}
 
 	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
 	virtual bool BoundingBox(AABB& output_box) const override;
 
+	// Slab test of the box from lo to hi with the reciprocal ray direction, also used by
+	// BoxArray. t is where the ray enters the box, or leaves it when it starts inside, and
+	// face the side crossed there: its axis, plus 3 on the hi side.
+	static inline bool Intersect(const Real* lo, const Real* hi, const Point3& o, const Vec3& inv_dir,
+		double t_min, double t_max, double& t, int& face)
+	{
+		double t_near = -INF, t_far = INF;
+		int near_face = 0, far_face = 0;
+		for (int a = 0; a < 3; a++)
+		{
+			// a ray in the plane of a side gets nan here, which is left out
+			double t0 = (lo[a] - o.e[a]) * inv_dir.e[a];
+			double t1 = (hi[a] - o.e[a]) * inv_dir.e[a];
+			int f0 = a, f1 = a + 3;
+			if (inv_dir.e[a] < 0)
+			{
+				std::swap(t0, t1);
+				std::swap(f0, f1);
+			}
+			if (t0 > t_near)
+			{
+				t_near = t0;
+				near_face = f0;
+			}
+			if (t1 < t_far)
+			{
+				t_far = t1;
+				far_face = f1;
+			}
+		}
+
+		if (t_near > t_far)
+			return false;
+		if (t_near >= t_min && t_near <= t_max)
+		{
+			t = t_near;
+			face = near_face;
+			return true;
+		}
+		if (t_far >= t_min && t_far <= t_max)
+		{
+			t = t_far;
+			face = far_face;
+			return true;
+		}
+		return false;
+	}
+
+	static inline void FillHitRecord(const Real* lo, const Real* hi, const Ray& r, double t, int face,
+		MaterialID mat_id, HitRecord& rec)
+	{
+		const int a = face % 3;
+		const Real side = face < 3 ? lo[a] : hi[a];
+		rec.t = t;
+		rec.p = r.At(t);
+		rec.p.e[a] = side;	// exactly on the side
+
+		// u and v run along the same axes as on the rects: x, y on xy, x, z on xz, y, z on yz
+		const int ua = a == 0 ? 1 : 0;
+		const int va = a == 2 ? 1 : 2;
+		rec.u = (rec.p.e[ua] - lo[ua]) / (hi[ua] - lo[ua]);
+		rec.v = (rec.p.e[va] - lo[va]) / (hi[va] - lo[va]);
+
+		Vec3 outward_normal(0, 0, 0);
+		outward_normal.e[a] = face < 3 ? -1 : 1;
+		rec.SetFaceNormal(r, outward_normal);
+		rec.mat_id = mat_id;
+	}
+
 public:
 	Point3 box_min;
 	Point3 box_max;
-	HittableList sides;
+	MaterialID mat_id;
 };
 
 class Sphere : public Hittable
 {
 public:
 	Sphere() {}
-	Sphere(Point3 cen, double r, shared_ptr<Material> m)
-		: center(cen), radius(r), mat_ptr(m) {};
+	Sphere(Point3 cen, double r, MaterialID m)
+		: center(cen), radius(r), mat_id(m) {};
 
 	virtual bool Hit(const Ray& r, double tMin, double tMax, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
 	virtual bool BoundingBox(AABB& output_box) const override;
 	double PDFValue(const Point3& o, const Vec3& v) const override;
 	Vec3 Random(const Point3& o) const override;
+	double Area() const override { return 4 * PI * radius * radius; }
 
 public:
 	Point3 center;
-	double radius;
-	shared_ptr<Material> mat_ptr;
+	Real radius;
+	MaterialID mat_id;
 
-private:
-	static void GetSphereUV(const Point3& p, double& u, double& v) 
+	// also used by MovingSphere
+	static void GetSphereUV(const Point3& p, Real& u, Real& v) 
 	{
 		// p: a given point on the sphere of radius one, centered at the origin.
 		// u: returned value [0,1] of angle around the Y axis from X=-1.
@@ -52,19 +127,33 @@ private:
 	}
 };
 
-class ConstantMedium : public Hittable
+// sphere moving from center0 at time0 to center1 at time1, holding still before and after
+class MovingSphere : public Hittable
 {
 public:
-	ConstantMedium(shared_ptr<Hittable> b, double d, shared_ptr<Texture> a)
-		: boundary(b),
-		neg_inv_density(-1 / d),
-		phase_function(make_shared<Isotropic>(a))
-	{}
+	MovingSphere(Point3 center0, Point3 center1, double time0, double time1, double r, MaterialID m);
 
-	ConstantMedium(shared_ptr<Hittable> b, double d, Color c)
+	Point3 Center(double time) const { return path.At(time); }
+
+	virtual bool Hit(const Ray& r, double tMin, double tMax, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
+	virtual bool BoundingBox(AABB& output_box) const override;
+	virtual bool MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const override;
+
+public:
+	Keyframes<Vec3> path;	// of the center
+	Real radius;
+	MaterialID mat_id;
+};
+
+class ConstantMedium : public Hittable
+{
+public:
+	// phase is the id of an Isotropic material
+	ConstantMedium(shared_ptr<Hittable> b, double d, MaterialID phase)
 		: boundary(b),
 		neg_inv_density(-1 / d),
-		phase_function(make_shared<Isotropic>(c))
+		phase_function(phase)
 	{}
 
 	virtual bool Hit(
@@ -75,9 +164,14 @@ public:
 		return boundary->BoundingBox(output_box);
 	}
 
+	virtual bool MotionBounds(double time0, double time1, AABB& box0, AABB& box1) const override
+	{
+		return boundary->MotionBounds(time0, time1, box0, box1);
+	}
+
 public:
 	shared_ptr<Hittable> boundary;
-	shared_ptr<Material> phase_function;
+	MaterialID phase_function;
 	double neg_inv_density;
 };
 
@@ -1,6 +1,10 @@
 #include "./texture.h"
 #include "./raw_stb_image.h"
 
+#include <iterator>
+#include <map>
+#include <mutex>
+
 ImageTexture::ImageTexture()
 	: data(nullptr), width(0), height(0), bytes_per_scanline(0) {}
 
@@ -8,8 +12,8 @@ ImageTexture::ImageTexture(const char* filename)
 {
 	auto components_per_pixel = bytes_per_pixel;
 
-	data = stbi_load(
-		filename, &width, &height, &components_per_pixel, components_per_pixel);
+	data.reset(stbi_load(filename, &width, &height, &components_per_pixel, components_per_pixel),
+		stbi_image_free);
 
 	if (!data) {
 		std::cerr << "ERROR: Could not load texture image file '" << filename << "'.\n";
@@ -19,10 +23,13 @@ ImageTexture::ImageTexture(const char* filename)
 	bytes_per_scanline = bytes_per_pixel * width;
 }
 
-ImageTexture::~ImageTexture()
+ImageTexture::ImageTexture(std::shared_ptr<const unsigned char> pixels, int w, int h)
+	: data(pixels), width(w), height(h), bytes_per_scanline(bytes_per_pixel * w)
 {
-	delete data;
+	if (!data)
+		width = height = bytes_per_scanline = 0;
 }
+
 Color ImageTexture::Value(double u, double v, const Vec3& p) const
 {
 	// If we have no texture data, then return solid cyan as a debugging aid.
@@ -41,7 +48,31 @@ Color ImageTexture::Value(double u, double v, const Vec3& p) const
 	if (j >= height) j = height - 1;
 
 	const auto color_scale = 1.0 / 255.0;
-	auto pixel = data + j * bytes_per_scanline + i * bytes_per_pixel;
+	auto pixel = data.get() + j * bytes_per_scanline + i * bytes_per_pixel;
 
 	return Color(color_scale*pixel[0], color_scale*pixel[1], color_scale*pixel[2]);
-}
\ No newline at end of file
+}
+
+std::shared_ptr<ImageTexture> LoadImageTexture(const std::string& path)
+{
+	static std::mutex mutex;
+	static std::map<std::string, std::weak_ptr<ImageTexture>> loaded;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = loaded.find(path);
+	if (found != loaded.end())
+	{
+		if (auto image = found->second.lock())
+			return image;
+	}
+
+	// forget the images no scene uses any more, a server sees many files over its life
+	for (auto it = loaded.begin(); it != loaded.end();)
+		it = it->second.expired() ? loaded.erase(it) : std::next(it);
+
+	auto image = std::make_shared<ImageTexture>(path.c_str());
+	if (!image->Pixels())
+		return nullptr;
+	loaded[path] = image;
+	return image;
+}
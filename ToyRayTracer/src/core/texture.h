@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <memory>
+#include <string>
 
 #include "./math.h"
 
@@ -23,6 +25,8 @@ public:
 		return color_value;
 	}
 
+	Color ColorValue() const { return color_value; }
+
 private:
 	Color color_value;
 };
@@ -33,12 +37,23 @@ public:
 
 	ImageTexture();
 	ImageTexture(const char* filename);
-	~ImageTexture();
+
+	// 8-bit rgb pixels decoded elsewhere (e.g. in a scene cache), used in place
+	ImageTexture(std::shared_ptr<const unsigned char> pixels, int w, int h);
 
 	virtual Color Value(double u, double v, const Vec3& p) const override;
 
+	const unsigned char* Pixels() const { return data.get(); }
+	int Width() const { return width; }
+	int Height() const { return height; }
+
 private:
-	unsigned char *data;
+	std::shared_ptr<const unsigned char> data;
 	int width, height;
 	int bytes_per_scanline;
-};
\ No newline at end of file
+};
+
+// Decode an image file, or share the texture decoded by an earlier call while that one is
+// still in use (a render server reloading a scene doesn't decode its images again).
+// Returns nullptr if the file can't be read.
+std::shared_ptr<ImageTexture> LoadImageTexture(const std::string& path);
@@ -0,0 +1,141 @@
+#include "./transform.h"
+
+#include <algorithm>
+#include <cmath>
+
+// ---Transform---
+
+Transform::Transform()
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+			m[i][j] = i == j ? 1 : 0;
+	}
+}
+
+Transform Transform::Translation(const Vec3& offset)
+{
+	Transform t;
+	for (int i = 0; i < 3; ++i)
+		t.m[i][3] = offset[i];
+	return t;
+}
+
+Transform Transform::Scale(const Vec3& factors)
+{
+	Transform t;
+	for (int i = 0; i < 3; ++i)
+		t.m[i][i] = factors[i];
+	return t;
+}
+
+Transform Transform::Rotation(const Vec3& axis, double angle)
+{
+	// Rodrigues: cos * I + sin * [k]x + (1 - cos) * k k^T
+	const double radians = DegreesToRadians(angle);
+	const double s = std::sin(radians), c = std::cos(radians);
+	const double length = std::sqrt(DotProduct(axis, axis));
+	const double k[3] = { axis[0] / length, axis[1] / length, axis[2] / length };
+	const double cross[3][3] = {
+		{ 0, -k[2], k[1] },
+		{ k[2], 0, -k[0] },
+		{ -k[1], k[0], 0 }
+	};
+
+	Transform t;
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			t.m[i][j] = static_cast<Real>((i == j ? c : 0) + s * cross[i][j] + (1 - c) * k[i] * k[j]);
+	}
+	return t;
+}
+
+Transform Transform::operator*(const Transform& b) const
+{
+	Transform t;
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			double sum = j == 3 ? m[i][3] : 0;
+			for (int k = 0; k < 3; ++k)
+				sum += static_cast<double>(m[i][k]) * b.m[k][j];
+			t.m[i][j] = static_cast<Real>(sum);
+		}
+	}
+	return t;
+}
+
+double Transform::Determinant() const
+{
+	return static_cast<double>(m[0][0]) * (static_cast<double>(m[1][1]) * m[2][2] - static_cast<double>(m[1][2]) * m[2][1])
+		- static_cast<double>(m[0][1]) * (static_cast<double>(m[1][0]) * m[2][2] - static_cast<double>(m[1][2]) * m[2][0])
+		+ static_cast<double>(m[0][2]) * (static_cast<double>(m[1][0]) * m[2][1] - static_cast<double>(m[1][1]) * m[2][0]);
+}
+
+bool Transform::Inverse(Transform& inverse) const
+{
+	const double det = Determinant();
+	if (det == 0 || !std::isfinite(det))
+		return false;
+
+	// the linear part by its cofactors, in double so a float build loses nothing extra
+	double a[3][3];
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+			a[i][j] = m[i][j];
+	}
+	double inv[3][3] = {
+		{ a[1][1] * a[2][2] - a[1][2] * a[2][1], a[0][2] * a[2][1] - a[0][1] * a[2][2], a[0][1] * a[1][2] - a[0][2] * a[1][1] },
+		{ a[1][2] * a[2][0] - a[1][0] * a[2][2], a[0][0] * a[2][2] - a[0][2] * a[2][0], a[0][2] * a[1][0] - a[0][0] * a[1][2] },
+		{ a[1][0] * a[2][1] - a[1][1] * a[2][0], a[0][1] * a[2][0] - a[0][0] * a[2][1], a[0][0] * a[1][1] - a[0][1] * a[1][0] }
+	};
+
+	for (int i = 0; i < 3; ++i)
+	{
+		double offset = 0;
+		for (int j = 0; j < 3; ++j)
+		{
+			inv[i][j] /= det;
+			offset -= inv[i][j] * m[j][3];
+		}
+		for (int j = 0; j < 3; ++j)
+			inverse.m[i][j] = static_cast<Real>(inv[i][j]);
+		inverse.m[i][3] = static_cast<Real>(offset);
+	}
+	return true;
+}
+
+bool Transform::IsIdentity() const
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			if (m[i][j] != (i == j ? 1 : 0))
+				return false;
+		}
+	}
+	return true;
+}
+
+AABB Transform::Box(const AABB& box) const
+{
+	// Arvo: every output bound picks the smaller or larger end of each input axis
+	Point3 lo, hi;
+	for (int i = 0; i < 3; ++i)
+	{
+		lo[i] = hi[i] = m[i][3];
+		for (int j = 0; j < 3; ++j)
+		{
+			const Real a = m[i][j] * box.min()[j];
+			const Real b = m[i][j] * box.max()[j];
+			lo[i] += std::min(a, b);
+			hi[i] += std::max(a, b);
+		}
+	}
+	return AABB(lo, hi);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "./math.h"
+#include "./ray.h"
+#include "./aabb.h"
+
+// Affine transform, the top three rows of a 4x4 matrix: the linear part in columns 0-2
+// and the translation in column 3. The default is the identity.
+class Transform
+{
+public:
+	Transform();
+
+	static Transform Translation(const Vec3& offset);
+	static Transform Scale(const Vec3& factors);
+
+	// angle in degrees, right handed about axis. Rotation(Vec3(0, 1, 0), a) turns like
+	// RotateY(object, a)
+	static Transform Rotation(const Vec3& axis, double angle);
+
+	// a * b applies b first, then a
+	Transform operator*(const Transform& b) const;
+
+	// false, and inverse untouched, when the transform flattens space
+	bool Inverse(Transform& inverse) const;
+
+	bool IsIdentity() const;
+
+	// of the linear part, how much volumes grow
+	double Determinant() const;
+
+	inline Point3 Point(const Point3& p) const
+	{
+		return Point3(m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3],
+			m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3],
+			m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3]);
+	}
+
+	inline Vec3 Vector(const Vec3& v) const
+	{
+		return Vec3(m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2],
+			m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2],
+			m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2]);
+	}
+
+	// by the transposed linear part, normals go through the transposed inverse
+	inline Vec3 TransposedVector(const Vec3& v) const
+	{
+		return Vec3(m[0][0] * v[0] + m[1][0] * v[1] + m[2][0] * v[2],
+			m[0][1] * v[0] + m[1][1] * v[1] + m[2][1] * v[2],
+			m[0][2] * v[0] + m[1][2] * v[1] + m[2][2] * v[2]);
+	}
+
+	// t along the ray stays the same
+	inline Ray Apply(const Ray& r) const
+	{
+		return Ray(Point(r.Origin()), Vector(r.Direction()), r.Time());
+	}
+
+	// the tightest box around the transformed box
+	AABB Box(const AABB& box) const;
+
+public:
+	Real m[3][4];
+};
@@ -0,0 +1,252 @@
+#include "./triangle_mesh.h"
+
+#include <cmath>
+
+namespace
+{
+	// Per ray part of the watertight ray/triangle test (Woop, Benthin, Wald 2013). The ray
+	// is sheared so it runs along +z through the origin, the triangle is then tested in 2d
+	// with edge functions that are exactly consistent between neighbouring triangles, so
+	// rays can't slip through shared edges.
+	struct WatertightRay
+	{
+		int kx, ky, kz;
+		double sx, sy, sz;
+		Point3 o;
+
+		WatertightRay(const Ray& r) : o(r.Origin())
+		{
+			const Vec3 d = r.Direction();
+			kz = std::fabs(d.x()) > std::fabs(d.y())
+				? (std::fabs(d.x()) > std::fabs(d.z()) ? 0 : 2)
+				: (std::fabs(d.y()) > std::fabs(d.z()) ? 1 : 2);
+			kx = (kz + 1) % 3;
+			ky = (kx + 1) % 3;
+			// keep the winding of the triangle
+			if (d.e[kz] < 0)
+				std::swap(kx, ky);
+
+			sx = d.e[kx] / d.e[kz];
+			sy = d.e[ky] / d.e[kz];
+			sz = 1.0 / d.e[kz];
+		}
+
+		// t and the barycentric weights of the second and third corner of a triangle
+		inline bool Intersect(const MeshView& mesh, const uint32_t* corner,
+			double t_min, double t_max, double& t, double& b1, double& b2) const
+		{
+			// corners relative to the ray origin, read straight from the arrays
+			double a[3], b[3], c[3];
+			const float* p[3] = { mesh.px, mesh.py, mesh.pz };
+			for (int k = 0; k < 3; ++k)
+			{
+				a[k] = p[k][corner[0]] - o.e[k];
+				b[k] = p[k][corner[1]] - o.e[k];
+				c[k] = p[k][corner[2]] - o.e[k];
+			}
+
+			const double ax = a[kx] - sx * a[kz];
+			const double ay = a[ky] - sy * a[kz];
+			const double bx = b[kx] - sx * b[kz];
+			const double by = b[ky] - sy * b[kz];
+			const double cx = c[kx] - sx * c[kz];
+			const double cy = c[ky] - sy * c[kz];
+
+			const double e0 = cx * by - cy * bx;
+			const double e1 = ax * cy - ay * cx;
+			const double e2 = bx * ay - by * ax;
+
+			// the ray passes outside of an edge
+			if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0))
+				return false;
+
+			const double det = e0 + e1 + e2;
+			if (det == 0)
+				return false;
+
+			const double inv_det = 1.0 / det;
+			t = (e0 * a[kz] + e1 * b[kz] + e2 * c[kz]) * sz * inv_det;
+			if (t < t_min || t > t_max)
+				return false;
+
+			b1 = e1 * inv_det;
+			b2 = e2 * inv_det;
+			return true;
+		}
+	};
+
+	// reorder the corners of a per corner index array to follow the triangle order
+	void ReorderCorners(std::vector<uint32_t>& corners, const std::vector<uint32_t>& order)
+	{
+		if (corners.empty())
+			return;
+		std::vector<uint32_t> sorted(corners.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			for (int k = 0; k < 3; ++k)
+				sorted[3 * i + k] = corners[3 * order[i] + k];
+		corners.swap(sorted);
+	}
+}
+
+// ---TriangleMesh---
+
+TriangleMesh::TriangleMesh(MeshData&& data, MaterialID m)
+	: mat_id(m), mesh(std::move(data))
+{
+	UpdateView();
+	const size_t triangle_count = mesh.TriangleCount();
+	std::vector<AABB> bounds(triangle_count);
+	for (size_t i = 0; i < triangle_count; ++i)
+	{
+		const Point3 p0 = Position(mesh.position_index[3 * i]);
+		const Point3 p1 = Position(mesh.position_index[3 * i + 1]);
+		const Point3 p2 = Position(mesh.position_index[3 * i + 2]);
+		bounds[i] = AABB(
+			Point3(fmin(p0.x(), fmin(p1.x(), p2.x())), fmin(p0.y(), fmin(p1.y(), p2.y())), fmin(p0.z(), fmin(p1.z(), p2.z()))),
+			Point3(fmax(p0.x(), fmax(p1.x(), p2.x())), fmax(p0.y(), fmax(p1.y(), p2.y())), fmax(p0.z(), fmax(p1.z(), p2.z()))));
+		box = i == 0 ? bounds[i] : SurroundingBox(box, bounds[i]);
+	}
+
+	// a flat mesh still needs some thickness, same padding as the rects
+	Point3 lo = box.min();
+	Point3 hi = box.max();
+	for (int a = 0; a < 3; a++)
+	{
+		if (hi[a] - lo[a] < 0.0001)
+		{
+			lo.e[a] -= 0.0001;
+			hi.e[a] += 0.0001;
+		}
+	}
+	box = AABB(lo, hi);
+
+	// store the triangles in leaf order, leaves then index them directly
+	std::vector<uint32_t> order;
+	BuildLinearBVH(bounds, nodes, order);
+	ReorderCorners(mesh.position_index, order);
+	ReorderCorners(mesh.normal_index, order);
+	ReorderCorners(mesh.uv_index, order);
+	UpdateView();
+}
+
+TriangleMesh::TriangleMesh(const MeshView& v, const AABB& bounds, MaterialID m,
+	shared_ptr<const void> keep_alive)
+	: view(v), box(bounds), mat_id(m), storage(keep_alive)
+{}
+
+void TriangleMesh::UpdateView()
+{
+	view.px = mesh.px.data();
+	view.py = mesh.py.data();
+	view.pz = mesh.pz.data();
+	view.nx = mesh.nx.data();
+	view.ny = mesh.ny.data();
+	view.nz = mesh.nz.data();
+	view.u = mesh.u.data();
+	view.v = mesh.v.data();
+	view.position_index = mesh.position_index.data();
+	view.normal_index = mesh.normal_index.empty() ? nullptr : mesh.normal_index.data();
+	view.uv_index = mesh.uv_index.empty() ? nullptr : mesh.uv_index.data();
+	view.nodes = nodes.data();
+	view.vertex_count = static_cast<uint32_t>(mesh.px.size());
+	view.normal_count = static_cast<uint32_t>(mesh.nx.size());
+	view.uv_count = static_cast<uint32_t>(mesh.u.size());
+	view.triangle_count = static_cast<uint32_t>(mesh.TriangleCount());
+	view.node_count = static_cast<uint32_t>(nodes.size());
+}
+
+bool TriangleMesh::BoundingBox(AABB& output_box) const
+{
+	if (view.node_count == 0)
+		return false;
+
+	output_box = box;
+	return true;
+}
+
+bool TriangleMesh::Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const
+{
+	const WatertightRay ray(r);
+	uint32_t hit_triangle = 0;
+	double hit_t = 0, hit_b1 = 0, hit_b2 = 0;
+
+	// find the closest triangle first, the hit record is only filled in for that one
+	bool hit_anything = TraverseLinearBVH(view.nodes, view.node_count, r, t_min, t_max,
+		[&](uint32_t first, uint32_t count, double& closest) {
+			bool hit_leaf = false;
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				double t, b1, b2;
+				if (ray.Intersect(view, &view.position_index[3 * i], t_min, closest, t, b1, b2))
+				{
+					closest = t;
+					hit_triangle = i;
+					hit_t = t;
+					hit_b1 = b1;
+					hit_b2 = b2;
+					hit_leaf = true;
+				}
+			}
+			return hit_leaf;
+		});
+
+	if (hit_anything)
+		FillHitRecord(r, hit_triangle, hit_t, hit_b1, hit_b2, rec);
+	return hit_anything;
+}
+
+bool TriangleMesh::Occluded(const Ray& r, double t_min, double t_max) const
+{
+	const WatertightRay ray(r);
+	return TraverseLinearBVH<true>(view.nodes, view.node_count, r, t_min, t_max,
+		[&](uint32_t first, uint32_t count, double& t_far) {
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				double t, b1, b2;
+				if (ray.Intersect(view, &view.position_index[3 * i], t_min, t_far, t, b1, b2))
+					return true;
+			}
+			return false;
+		});
+}
+
+void TriangleMesh::FillHitRecord(const Ray& r, uint32_t triangle, double t, double b1, double b2, HitRecord& rec) const
+{
+	const double b0 = 1.0 - b1 - b2;
+	const uint32_t* corner = &view.position_index[3 * triangle];
+	const Point3 p0 = Position(corner[0]);
+	const Point3 p1 = Position(corner[1]);
+	const Point3 p2 = Position(corner[2]);
+
+	rec.t = t;
+	rec.p = r.At(t);
+	rec.mat_id = mat_id;
+
+	// counter clockwise winding faces outwards
+	Vec3 normal = UnitVector(CrossProduct(p1 - p0, p2 - p0));
+	if (view.normal_index)
+	{
+		const uint32_t* n = &view.normal_index[3 * triangle];
+		if (n[0] != NO_INDEX && n[1] != NO_INDEX && n[2] != NO_INDEX)
+		{
+			Vec3 shading = b0 * Vec3(view.nx[n[0]], view.ny[n[0]], view.nz[n[0]])
+				+ b1 * Vec3(view.nx[n[1]], view.ny[n[1]], view.nz[n[1]])
+				+ b2 * Vec3(view.nx[n[2]], view.ny[n[2]], view.nz[n[2]]);
+			if (shading.LengthSquared() > 0)
+				normal = UnitVector(shading);
+		}
+	}
+	rec.SetFaceNormal(r, normal);
+
+	rec.u = b1;
+	rec.v = b2;
+	if (view.uv_index)
+	{
+		const uint32_t* uv = &view.uv_index[3 * triangle];
+		if (uv[0] != NO_INDEX && uv[1] != NO_INDEX && uv[2] != NO_INDEX)
+		{
+			rec.u = b0 * view.u[uv[0]] + b1 * view.u[uv[1]] + b2 * view.u[uv[2]];
+			rec.v = b0 * view.v[uv[0]] + b1 * view.v[uv[1]] + b2 * view.v[uv[2]];
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "./math.h"
+#include "./hittable.h"
+#include "./bvh.h"
+#include "./materials.h"
+
+// index of a missing normal or texture coordinate
+const uint32_t NO_INDEX = 0xffffffffu;
+
+// Vertex data of a mesh, each attribute kept in its own arrays (structure of arrays) and
+// shared by every triangle that references it. Triangle t uses corners 3t, 3t+1, 3t+2 of
+// the index arrays; normal_index and uv_index are either empty or hold one entry (maybe
+// NO_INDEX) per corner, like the v/vt/vn triples of an obj face.
+struct MeshData
+{
+	std::vector<float> px, py, pz;
+	std::vector<float> nx, ny, nz;
+	std::vector<float> u, v;
+
+	std::vector<uint32_t> position_index;
+	std::vector<uint32_t> normal_index;
+	std::vector<uint32_t> uv_index;
+
+	size_t TriangleCount() const { return position_index.size() / 3; }
+};
+
+// The arrays a mesh is traced from, triangles in bvh leaf order. They point either into
+// the mesh's own MeshData or straight into a mapped scene cache (see scene_cache.h).
+struct MeshView
+{
+	const float* px, * py, * pz;
+	const float* nx, * ny, * nz;
+	const float* u, * v;
+	const uint32_t* position_index;
+	const uint32_t* normal_index;	// null without normals
+	const uint32_t* uv_index;		// null without texture coordinates
+	const LinearBVHNode* nodes;
+	uint32_t vertex_count, normal_count, uv_count;
+	uint32_t triangle_count, node_count;
+};
+
+// Indexed triangle mesh with its own bvh, one hittable for the whole mesh so a million
+// triangles cost one shared_ptr instead of a million.
+class TriangleMesh : public Hittable
+{
+public:
+	TriangleMesh(MeshData&& data, MaterialID m);
+
+	// mesh with a bvh that is already built, the arrays of v are used in place and
+	// keep_alive owns them
+	TriangleMesh(const MeshView& v, const AABB& bounds, MaterialID m,
+		shared_ptr<const void> keep_alive);
+
+	// the view points into the mesh's own arrays
+	TriangleMesh(const TriangleMesh&) = delete;
+	TriangleMesh& operator=(const TriangleMesh&) = delete;
+
+	virtual bool Hit(const Ray& r, double t_min, double t_max, HitRecord& rec) const override;
+	virtual bool Occluded(const Ray& r, double t_min, double t_max) const override;
+	virtual bool BoundingBox(AABB& output_box) const override;
+
+	size_t TriangleCount() const { return view.triangle_count; }
+
+private:
+	Point3 Position(uint32_t index) const { return Point3(view.px[index], view.py[index], view.pz[index]); }
+	void FillHitRecord(const Ray& r, uint32_t triangle, double t, double b1, double b2, HitRecord& rec) const;
+	void UpdateView();
+
+public:
+	MeshView view;
+	AABB box;
+	MaterialID mat_id;
+
+	MeshData mesh;		// own arrays, empty when the view points elsewhere
+	std::vector<LinearBVHNode> nodes;
+	shared_ptr<const void> storage;	// owner of the arrays when they aren't in mesh
+};
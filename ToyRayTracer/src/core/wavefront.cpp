@@ -0,0 +1,221 @@
+#include "./wavefront.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "./material_table.h"
+#include "./ray_packet.h"
+#include "./sampler.h"
+
+namespace
+{
+	// most paths traced together, so the buffers of a wave stay in the cache
+	const size_t MAX_WAVE_SIZE = 16384;
+
+	// the paths of a wave, one array per field so a stage only streams through what it uses
+	struct PathBuffer
+	{
+		std::vector<Real> ox, oy, oz;		// ray origin
+		std::vector<Real> dx, dy, dz;		// ray direction
+		std::vector<Real> time;
+		std::vector<Real> tr, tg, tb;		// throughput
+		std::vector<Real> bounce_pdf;
+		std::vector<int> depth;
+		std::vector<uint32_t> sample;		// the sample the path adds its light to
+		size_t size = 0;
+
+		// room for n paths, the vectors only grow so a thread allocates them once
+		void Reserve(size_t n)
+		{
+			if (ox.size() >= n)
+				return;
+			for (auto* v : { &ox, &oy, &oz, &dx, &dy, &dz, &time, &tr, &tg, &tb, &bounce_pdf })
+				v->resize(n);
+			depth.resize(n);
+			sample.resize(n);
+		}
+
+		Ray GetRay(size_t k) const
+		{
+			return Ray(Point3(ox[k], oy[k], oz[k]), Vec3(dx[k], dy[k], dz[k]), time[k]);
+		}
+
+		PathState Get(size_t k) const
+		{
+			return { GetRay(k), Color(tr[k], tg[k], tb[k]), Color(0, 0, 0), depth[k], bounce_pdf[k] };
+		}
+
+		void Set(size_t k, const PathState& path, uint32_t s)
+		{
+			const Point3 o = path.ray.Origin();
+			const Vec3 d = path.ray.Direction();
+			ox[k] = o.x(); oy[k] = o.y(); oz[k] = o.z();
+			dx[k] = d.x(); dy[k] = d.y(); dz[k] = d.z();
+			time[k] = path.ray.Time();
+			tr[k] = path.throughput.x(); tg[k] = path.throughput.y(); tb[k] = path.throughput.z();
+			bounce_pdf[k] = path.bounce_pdf;
+			depth[k] = path.depth;
+			sample[k] = s;
+		}
+	};
+
+	// everything a thread needs for a tile, kept from tile to tile
+	struct WavefrontBuffers
+	{
+		PathBuffer paths[2];			// the wave being traced and its survivors
+		std::vector<HitRecord> recs;
+		std::vector<uint32_t> order;	// paths that hit something, by material
+		std::vector<uint32_t> first_of;	// where each material starts in order
+		std::vector<Color> radiance;	// per sample
+		std::vector<int> pixels;		// x + row * width of the tile's pixels still sampling
+	};
+
+	WavefrontBuffers& ThreadBuffers()
+	{
+		static thread_local WavefrontBuffers buffers;
+		return buffers;
+	}
+}
+
+// ---WavefrontIntegrator---
+
+void WavefrontIntegrator::RenderTile(const Tile& tile, const Camera& cam, int samples, Film& film) const
+{
+	WavefrontBuffers& b = ThreadBuffers();
+	const int width = film.Width();
+
+	b.pixels.clear();
+	for (int row = tile.y0; row < tile.y1; ++row)
+	{
+		for (int x = tile.x0; x < tile.x1; ++x)
+		{
+			if (!film.IsConverged(x, row))
+				b.pixels.push_back(row * width + x);
+		}
+	}
+
+	// a big tile is traced in several waves
+	const size_t wave_pixels = std::max<size_t>(1, MAX_WAVE_SIZE / samples);
+	for (size_t first = 0; first < b.pixels.size(); first += wave_pixels)
+		TraceWave(&b.pixels[first], std::min(wave_pixels, b.pixels.size() - first), cam, samples, film);
+}
+
+void WavefrontIntegrator::TraceWave(const int* pixels, size_t pixel_count, const Camera& cam, int samples, Film& film) const
+{
+	WavefrontBuffers& b = ThreadBuffers();
+	const int width = film.Width();
+	const int height = film.Height();
+
+	// generate: the camera rays of a pixel next to each other, sample k is path k
+	const size_t count = pixel_count * samples;
+	PathBuffer* wave = &b.paths[0];
+	PathBuffer* survivors = &b.paths[1];
+	wave->Reserve(count);
+	survivors->Reserve(count);
+	b.recs.resize(std::max(b.recs.size(), count));
+	b.order.resize(std::max(b.order.size(), count));
+	b.radiance.assign(count, Color(0, 0, 0));
+
+	uint32_t k = 0;
+	for (size_t n = 0; n < pixel_count; ++n)
+	{
+		const int pixel = pixels[n];
+		// tiles count rows from the top of the image, j counts them from the bottom
+		const int i = pixel % width;
+		const int j = height - 1 - pixel / width;
+		for (int s = 0; s < samples; ++s, ++k)
+		{
+			auto u = (i + RandomDouble()) / (width - 1);
+			auto v = (j + RandomDouble()) / (height - 1);
+			wave->Set(k, { cam.GetRay(u, v), Color(1, 1, 1), Color(0, 0, 0), 0, 0.0 }, k);
+		}
+	}
+	wave->size = count;
+
+	const Hittable& world = integrator.world;
+	const size_t material_count = integrator.materials.Size();
+	std::vector<uint32_t>& first_of = b.first_of;
+
+	for (int depth = 0; wave->size > 0 && depth < integrator.max_depth; ++depth)
+	{
+		// intersect: the camera rays of a pixel are nearly parallel and go as packets
+		first_of.assign(material_count + 1, 0);
+		for (size_t p = 0; p < wave->size; p += PACKET_SIZE)
+		{
+			RayPacket packet;
+			packet.size = static_cast<int>(std::min<size_t>(PACKET_SIZE, wave->size - p));
+			double t_max[PACKET_SIZE];
+			uint32_t hit_mask = 0;
+			if (depth == 0)
+			{
+				for (int q = 0; q < packet.size; ++q)
+				{
+					packet.rays[q] = wave->GetRay(p + q);
+					t_max[q] = INF;
+				}
+				hit_mask = world.HitPacket(packet, packet.FullMask(), 0, t_max, &b.recs[p]);
+			}
+			else
+			{
+				for (int q = 0; q < packet.size; ++q)
+				{
+					if (world.Hit(wave->GetRay(p + q), 0, INF, b.recs[p + q]))
+						hit_mask |= 1u << q;
+				}
+			}
+
+			// a path that hits nothing picks up the background and ends here
+			for (int q = 0; q < packet.size; ++q)
+			{
+				const size_t path = p + q;
+				if (hit_mask & (1u << q))
+					first_of[b.recs[path].mat_id + 1]++;
+				else
+				{
+					b.recs[path].mat_id = static_cast<MaterialID>(material_count);
+					b.radiance[wave->sample[path]] += Color(wave->tr[path], wave->tg[path], wave->tb[path]) * integrator.background;
+				}
+			}
+		}
+
+		// sort: counting sort of the paths that hit something by their material
+		for (size_t m = 0; m < material_count; ++m)
+			first_of[m + 1] += first_of[m];
+		const uint32_t hits = first_of[material_count];
+		for (uint32_t path = 0; path < wave->size; ++path)
+		{
+			MaterialID m = b.recs[path].mat_id;
+			if (m < material_count)
+				b.order[first_of[m]++] = path;
+		}
+
+		// shade and compact: the surviving paths are written out in shading order
+		survivors->size = 0;
+		for (uint32_t n = 0; n < hits; ++n)
+		{
+			const uint32_t path = b.order[n];
+			PathState state = wave->Get(path);
+			bool alive = integrator.Bounce(state, b.recs[path]);
+			b.radiance[wave->sample[path]] += state.radiance;
+			if (alive)
+				survivors->Set(survivors->size++, state, wave->sample[path]);
+		}
+		std::swap(wave, survivors);
+	}
+
+	// the samples of a pixel go to the film in packet sized batches, like the packet tracer's
+	k = 0;
+	for (size_t n = 0; n < pixel_count; ++n)
+	{
+		const int pixel = pixels[n];
+		for (int s = 0; s < samples; s += PACKET_SIZE)
+		{
+			const int batch = std::min(PACKET_SIZE, samples - s);
+			Color sum(0, 0, 0);
+			for (int q = 0; q < batch; ++q)
+				sum += b.radiance[k++];
+			film.AddBatch(pixel % width, pixel / width, sum, batch);
+		}
+	}
+}
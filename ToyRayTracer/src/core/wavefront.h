@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+
+#include "./camera.h"
+#include "./film.h"
+#include "./integrator.h"
+#include "./scheduler.h"
+
+// Path tracer that follows all the samples of a tile together, one stage at a time: the
+// camera rays are generated, every path is intersected, the hits are sorted by material,
+// shaded (PathIntegrator::Bounce, shadow rays included) and the surviving paths are
+// compacted for the next bounce. Each stage runs the same code over the whole batch, and
+// shading works through one material's code and data after the other instead of jumping
+// between them at every path. The paths are kept in structure of arrays buffers.
+// It estimates the same image as PathIntegrator, with other random numbers.
+class WavefrontIntegrator
+{
+public:
+	explicit WavefrontIntegrator(const PathIntegrator& integrator) : integrator(integrator) {}
+
+	// Add samples camera rays to every unconverged pixel of tile. The random numbers come
+	// from the calling thread's sampler, seeded once for the tile.
+	void RenderTile(const Tile& tile, const Camera& cam, int samples, Film& film) const;
+
+private:
+	// trace samples paths from each of the pixels (x + row * width) together
+	void TraceWave(const int* pixels, size_t pixel_count, const Camera& cam, int samples, Film& film) const;
+
+private:
+	const PathIntegrator& integrator;
+};
@@ -1,327 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <iostream>
-#include <memory>
-
-#include "core/hittable.h"
-#include "core/materials.h"
-#include "core/math.h"
-#include "core/camera.h"
-#include "core/aarec.h"
-#include "core/simple_shape.h"
-#include "core/pdf.h"
-#include "core/bvh.h"
-
-void outputToImage(std::ofstream &out, Color **colorbuffer, int height, int width, int samples_per_pixel);
-Color RayTrace(const Ray& r, const Color& background,const Hittable& world, shared_ptr<HittableList> lights, int depth);
-
-// scenes
-HittableList CornellBox1();
-HittableList CornellBox2();
-HittableList NextWeekendFinalScene();
-
-int main()
+#include <string>
+#include <vector>
+
+#include "core/simd.h"
+#include "core/scene.h"
+#include "core/scene_cache.h"
+#include "core/render_settings.h"
+#include "core/render_job.h"
+#include "core/renderer.h"
+#include "./builtin_scenes.h"
+
+// ctrl+c stops the render after the tiles in flight, the finished part is still written,
+// a server stops after that job
+Renderer renderer;
+void OnInterrupt(int)
 {
-	std::ofstream ofs("./image/res.ppm"); 
-	if (!ofs) 
-		std::cerr << "ERROR: Could not open image file '" << "./image/res.ppm" << "'.\n";
-	
-
-	// image settings
-	const auto aspect_ratio = 1.0 / 1.0;
-	const int image_width = 500;
-	const int image_height = static_cast<int>(image_width / aspect_ratio);
-	const int samples_per_pixel = 200;
-	const int max_depth = 50;
+	renderer.Cancel();
+}
 
-	// camera settings
-	Point3 lookfrom;
-	Point3 lookat;
-	Vec3 vup(0, 1, 0);
-	auto dist_to_focus = 10.0;
-	auto aperture = 0.0;
-	auto vfov = 40.0;
-	Color background;
+void PrintUsage()
+{
+	std::cerr << "usage: ToyRayTracer [--scene FILE | --builtin N | --cache FILE] [--write-cache FILE] [--OPTION VALUE]...\n"
+		<< "       ToyRayTracer --serve - | FILE [--keep-scenes N] [--OPTION VALUE]...\n"
+		<< "  --scene FILE        json scene file (see src/scenes)\n"
+		<< "  --builtin N         one of the scenes built in code, 1 when no scene is given\n"
+		<< "  --cache FILE        scene cache written by --write-cache\n"
+		<< "  --write-cache FILE  store the scene in a cache and exit\n"
+		<< "  --serve - | FILE    read jobs from stdin or a file (e.g. a named pipe), one per line in the\n"
+		<< "                      arguments above, and render them in order; scenes stay loaded between\n"
+		<< "                      jobs, 'quit' stops. Options given with --serve apply to every job\n"
+		<< "  --keep-scenes N     most scenes a server keeps loaded, the one used longest ago goes\n"
+		<< "                      first (default " << DEFAULT_KEPT_SCENES << ", 0 keeps every scene)\n"
+		<< "render options, given as --NAME VALUE, override the scene file:\n" << RenderOptionHelp();
+}
 
-	// world
-	HittableList world;
-	shared_ptr<HittableList> lights;
-	switch (1)
+// Render job, or write its scene cache. Prints one result line on stdout.
+bool RunJob(SceneLibrary& library, const RenderJob& job, int number)
+{
+	if (!job.write_cache_path.empty())
 	{
-	case 1:
-		world = CornellBox1();
-		lights = make_shared<HittableList>();
-		lights->add(make_shared<XZRect>(193, 363, 207, 352, 554, shared_ptr<Material>()));
-		lights->add(make_shared<Sphere>(Point3(215.5, 300, 100), 80, shared_ptr<Material>()));
-		lookfrom = Point3(278, 278, -800);
-		lookat = Point3(278, 278, 0);
-		break;
-	case 2:
-		world = CornellBox2();
-		lights = make_shared<HittableList>();
-		lights->add(make_shared<XZRect>(153, 403, 187, 372, 554, shared_ptr<Material>()));
-		lookfrom = Point3(278, 278, -800);
-		lookat = Point3(278, 278, 0);
-		break;
-
-	case 3:
-		world = NextWeekendFinalScene();
-		lights = make_shared<HittableList>();
-		lights->add(make_shared<XZRect>(123, 423, 147, 412, 554, shared_ptr<Material>()));
-		lookfrom = Point3(478, 278, -600);
-		lookat = Point3(278, 278, 0);
-		break;
-
-	default:
-		break;
-
+		Scene scene;
+		RenderSettings settings;
+		bool written = library.LoadFresh(job, scene, settings) && WriteSceneCache(job.write_cache_path, scene);
+		std::cout << (written ? "done " : "failed ") << number << " " << job.write_cache_path << "\n" << std::flush;
+		return written;
 	}
 
-	// create camera
-	Camera cam(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, dist_to_focus);
-
-	Color** colorbuffer = new Color*[image_height];
-	for (int i = 0; i < image_height; ++i)
-		colorbuffer[i] = new Color[image_width];
-
-	// Render
-	ofs << "P3\n" << image_width << " " << image_height << "\n255\n";
-
-	clock_t start, end;
-	start = clock();
-
-	std::cerr << "running..." << std::flush;
-#pragma omp parallel for num_threads(8)
-	for (int j = image_height - 1; j >= 0; --j)
+	bool cached = false;
+	LoadedScene* loaded = library.Get(job, cached);
+	RenderSettings settings;
+	CameraSettings camera;
+	if (loaded)
 	{
-		//std::cerr << "\rScanlines remaining: " << j << " " << std::flush;
-		for (int i = 0; i < image_width; ++i)
-		{
-			Color pixel_color(0, 0, 0);
-			for (int s = 0; s < samples_per_pixel; ++s)
-			{
-				auto u = (i + RandomDouble()) / (image_width - 1);
-				auto v = (j + RandomDouble()) / (image_height - 1);
-				Ray r = cam.GetRay(u, v);
-				pixel_color += RayTrace(r, background, world, lights, max_depth);
-			}
-			colorbuffer[image_height - 1 - j][i] = pixel_color;
-		}
+		settings = loaded->settings;
+		camera = loaded->scene.camera;
 	}
-
-	end = clock();
-	double time = (double)(end - start) / CLOCKS_PER_SEC;
-	std::cerr << "\nruntime:" << time << "s" << std::flush;
-	outputToImage(ofs, colorbuffer, image_height, image_width, samples_per_pixel);
-	std::cerr << "\nDone.\n" << std::flush;
-
-	for (int i = 0; i < image_height; ++i)
-		delete[] colorbuffer[i];
-	delete[] colorbuffer;
-
-	system("pause");
-	return 0;
-}
-
-Color RayTrace(const Ray& r, const Color& background,
-	const Hittable& world, shared_ptr<HittableList> lights, int depth)
-{
-	HitRecord rec;
-
-	if (depth <= 0)
-		return Color(0, 0, 0);
-
-	// If the ray hits nothing, return the background color.
-	if (!world.Hit(r, 0.001, INF, rec))
-		return background;
-
-	ScatterRecord srec;
-	Color emitted = rec.mat_ptr->Emitted(r, rec, rec.u, rec.v, rec.p);
-	if (!rec.mat_ptr->Scatter(r, rec, srec))
-		return emitted;
-
-	if (srec.is_specular) {
-		return srec.attenuation
-			* RayTrace(srec.specular_ray, background, world, lights, depth - 1);
+	// motion blur needs MotionBVHs above whatever moves, a scene without animation has nothing to blur
+	if (!loaded || !ApplyJobOptions(job, settings, camera)
+		|| !library.Prepare(job, *loaded, settings.shutter > 0 && !loaded->scene.animation.Empty(), cached))
+	{
+		std::cout << "failed " << number << "\n" << std::flush;
+		return false;
 	}
+	if (!cached)
+		std::cerr << "scene load:" << loaded->load_time << "s, accel build:" << loaded->accel_time << "s ("
+			<< SimdLevelName(DetectSimdLevel()) << ")\n" << std::flush;
+
+	// an animation moves its transforms to every frame, the bvhs above them are refit to
+	// where they are while the shutter is open
+	const Animation& animation = loaded->scene.animation;
+	bool all_written = true;
+	for (int f = 0; f < settings.frames && (f == 0 || !renderer.IsCancelled()); ++f)
+	{
+		const int frame = settings.first_frame + f;
+		RenderSettings frame_settings = settings;
+		if (settings.frames > 1)
+			frame_settings.output_path = FrameOutputPath(settings.output_path, frame);
 
-	auto light_ptr = make_shared<HittablePDF>(lights, rec.p);
-	MixturePDF p(light_ptr, srec.pdf_ptr);
-
-	Ray scattered = Ray(rec.p, p.Generate());
-	auto pdf_val = p.Value(scattered.Direction());
-
-	return emitted
-		+ srec.attenuation * rec.mat_ptr->ScatteringPDF(r, rec, scattered)
-		* RayTrace(scattered, background, world, lights, depth - 1) / pdf_val;
-}
-
-HittableList CornellBox1()
-{
-	HittableList objects;
-
-	auto red = make_shared<Lambertian>(Color(.65, .05, .05));
-	auto white = make_shared<Lambertian>(Color(.73, .73, .73));
-	auto green = make_shared<Lambertian>(Color(.22, .45, .15));
-	auto blue = make_shared<Lambertian>(Color(.12, .42, .75));
-	auto light = make_shared<DiffuseLight>(Color(15, 15, 15));
-
-	objects.add(make_shared<YZRect>(0, 555, 0, 555, 555, green));
-	objects.add(make_shared<YZRect>(0, 555, 0, 555, 0, red));
-	objects.add(make_shared<FlipFace>(make_shared<XZRect>(193, 363, 207, 352, 554, light)));// ԴfrontfaceҪתһ£adapterģʽ
-
-	objects.add(make_shared<XZRect>(0, 555, 0, 555, 0, white));
-	objects.add(make_shared<XZRect>(0, 555, 0, 555, 555, white));
-	objects.add(make_shared<XYRect>(0, 555, 0, 555, 555, white));
-
-	shared_ptr<Hittable> box1 = make_shared<Box>(Point3(0, 0, 0), Point3(165, 220, 165), blue);
-	box1 = make_shared<RotateY>(box1, -18);
-	box1 = make_shared<Translate>(box1, Vec3(130, 0, 65));
-	objects.add(box1);	
-	auto glass = make_shared<Dielectric>(1.5);
-	objects.add(make_shared<Sphere>(Point3(215.5, 300, 130), 80, glass));
-
-	shared_ptr<Material> aluminum = make_shared<Metal>(Color(0.8, 0.85, 0.85), 0.0);
-	shared_ptr<Hittable> box2 = make_shared<Box>(Point3(0, 0, 0), Point3(165, 300, 165), aluminum);
-	box2 = make_shared<RotateY>(box2, 15);
-	box2 = make_shared<Translate>(box2, Vec3(300, 0, 295));
-	objects.add(box2);
+		SceneAccel::UpdateStats update;
+		if (!animation.Empty())
+		{
+			animation.SetTime(frame);
+			update = loaded->accel->Update(frame, frame + settings.shutter, settings.rebuild_ratio);
+			std::cerr << "frame " << frame << ": accel update:" << update.time << "s (" << update.refit << " refit, "
+				<< update.rebuilt << " rebuilt, cost " << update.cost_ratio << "x)\n" << std::flush;
+		}
 
-	return objects;
+		RenderStats stats;
+		renderer.Render(*loaded->accel, loaded->scene, camera, frame_settings, stats, frame);
+		all_written = all_written && stats.written;
+
+		// one line per image for whoever feeds the jobs, the details went to std::cerr
+		bool reused = cached || f > 0;
+		std::cout << (stats.written ? "done " : "failed ") << number << " " << frame_settings.output_path
+			<< " load=" << (reused ? 0.0 : loaded->load_time) << (reused ? "s(cached)" : "s")
+			<< " accel=" << (reused ? 0.0 : loaded->accel_time) << "s";
+		if (!animation.Empty())
+			std::cout << " frame=" << frame << " update=" << update.time << "s refit=" << update.refit
+				<< " rebuilt=" << update.rebuilt << " cost=" << update.cost_ratio;
+		std::cout << " render=" << stats.render_time << "s write=" << stats.write_time
+			<< "s samples=" << stats.samples << " passes=" << stats.passes
+			<< (stats.finished ? "" : " cancelled") << "\n" << std::flush;
+	}
+	return all_written;
 }
 
-HittableList CornellBox2()
+// Jobs from in, one line each, until the end or 'quit'. Options given to the server come
+// before those of the job. Returns the number of failed jobs.
+int Serve(std::istream& in, const RenderJob& defaults, size_t kept_scenes)
 {
-	HittableList objects;
-
-	auto red = make_shared<Lambertian>(Color(.65, .05, .05));
-	auto white = make_shared<Lambertian>(Color(.73, .73, .73));
-	auto green = make_shared<Lambertian>(Color(.22, .45, .15));
-	auto blue = make_shared<Lambertian>(Color(.12, .42, .75));
-	auto light = make_shared<DiffuseLight>(Color(15, 15, 15));
-
-	objects.add(make_shared<YZRect>(0, 555, 0, 555, 555, green));
-	objects.add(make_shared<YZRect>(0, 555, 0, 555, 0, red));
-	objects.add(make_shared<FlipFace>(make_shared<XZRect>(153, 403, 187, 372, 554, light)));// ԴfrontfaceҪתһ£adapterģʽ
-
-	objects.add(make_shared<XZRect>(0, 555, 0, 555, 0, white));
-	objects.add(make_shared<XZRect>(0, 555, 0, 555, 555, white));
-	objects.add(make_shared<XYRect>(0, 555, 0, 555, 555, white));
-
-	shared_ptr<Hittable> box1 = make_shared<Box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
-	box1 = make_shared<RotateY>(box1, 15);
-	box1 = make_shared<Translate>(box1, Vec3(265, 0, 295));
-
-	shared_ptr<Hittable> box2 = make_shared<Box>(Point3(0, 0, 0), Point3(165, 165, 165), white);
-	box2 = make_shared<RotateY>(box2, -18);
-	box2 = make_shared<Translate>(box2, Vec3(130, 0, 65));
-
-	auto boundary = make_shared<Sphere>(Point3(185, 235, 195), 70, make_shared<Dielectric>(1.5));
-	objects.add(boundary);
-	objects.add(make_shared<ConstantMedium>(boundary, 0.1, Color(0.25, 0.75, 0.4)));
-
-	objects.add(make_shared<ConstantMedium>(box1, 0.01, Color(0.9, 0.9, 0.9)));
-	objects.add(make_shared<ConstantMedium>(box2, 0.01, Color(0.2, 0.4, 0.9)));
-
-	return objects;
+	SceneLibrary library(BuildScene, kept_scenes);
+	int number = 0, failed = 0;
+	std::string line;
+	while (!renderer.IsCancelled() && std::getline(in, line))
+	{
+		std::vector<std::string> args;
+		if (!SplitJobLine(line, args))
+		{
+			std::cout << "failed " << ++number << "\n" << std::flush;
+			++failed;
+			continue;
+		}
+		if (args.empty() || args[0][0] == '#')
+			continue;
+		if (args.size() == 1 && args[0] == "quit")
+			break;
+
+		RenderJob job;
+		job.options = defaults.options;
+		auto start = std::chrono::steady_clock::now();
+		bool ok = ParseJobArguments(args, job);
+		if (!ok)
+			std::cout << "failed " << ++number << "\n" << std::flush;
+		else
+			ok = RunJob(library, job, ++number);
+		if (!ok)
+			++failed;
+		std::cerr << "job " << number << ": "
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s\n" << std::flush;
+	}
+	return failed;
 }
 
-
-HittableList NextWeekendFinalScene()
+int main(int argc, char* argv[])
 {
-	HittableList boxes1;
-	auto ground = make_shared<Lambertian>(Color(0.48, 0.83, 0.53));
-
-	// ground box
-	const int boxes_per_side = 20;
-	for (int i = 0; i < boxes_per_side; i++) 
+	// what to render and how, see PrintUsage
+	std::vector<std::string> args(argv + 1, argv + argc);
+	std::string serve_path;
+	size_t kept_scenes = DEFAULT_KEPT_SCENES;
+	for (size_t a = 0; a + 1 < args.size();)
 	{
-		for (int j = 0; j < boxes_per_side; j++) 
+		if (args[a] == "--serve")
+			serve_path = args[a + 1];
+		else if (args[a] == "--keep-scenes")
+			kept_scenes = static_cast<size_t>(std::max(0, std::atoi(args[a + 1].c_str())));
+		else
 		{
-			auto w = 100.0;
-			auto x0 = -1000.0 + i * w;
-			auto z0 = -1000.0 + j * w;
-			auto y0 = 0.0;
-			auto x1 = x0 + w;
-			auto y1 = RandomDouble(1, 101);
-			auto z1 = z0 + w;
-
-			boxes1.add(make_shared<Box>(Point3(x0, y0, z0), Point3(x1, y1, z1), ground));
+			a += 2;
+			continue;
 		}
+		args.erase(args.begin() + a, args.begin() + a + 2);
 	}
 
-	HittableList objects;
-
-	objects.add(make_shared<BVHNode>(boxes1, 0, 1));
-
-	// top light
-	auto light = make_shared<DiffuseLight>(Color(7, 7, 7));
-	objects.add(make_shared<FlipFace>(make_shared<XZRect>(123, 423, 147, 412, 554, light)));
-
-	// sphere
-	auto center = Point3(400, 400, 200);
-	auto moving_sphere_material = make_shared<Lambertian>(Color(0.7, 0.3, 0.1));
-	objects.add(make_shared<Sphere>(center, 50, moving_sphere_material));
-
-	// glass sphere and metal sphere
-	objects.add(make_shared<Sphere>(Point3(260, 150, 45), 50, make_shared<Dielectric>(1.5)));
-	objects.add(make_shared<Sphere>(Point3(0, 150, 145), 50, make_shared<Metal>(Color(0.8, 0.8, 0.9), 1.0)));
-
-	// subsurface
-	auto boundary = make_shared<Sphere>(Point3(360, 170, 145), 70, make_shared<Dielectric>(1.5));
-	objects.add(boundary);
-	objects.add(make_shared<ConstantMedium>(boundary, 0.2, Color(0.2, 0.4, 0.9)));
-
-	// huge fog
-	boundary = make_shared<Sphere>(Point3(0, 0, 0), 5000, make_shared<Dielectric>(1.5));
-	objects.add(make_shared<ConstantMedium>(boundary, .0001, Color(0.1, 0.1, 0.1)));
-
-	auto emat = make_shared<Lambertian>(make_shared<ImageTexture>("./src/resource/earthmap.jpg"));
-	objects.add(make_shared<Sphere>(Point3(400, 200, 400), 100, emat));
-
-	objects.add(make_shared<Sphere>(Point3(220, 280, 300), 80, make_shared<Metal>(Color(0.8, 0.88, 0.85), 0.0)));
-
-	HittableList boxes2;
-	auto white = make_shared<Lambertian>(Color(.73, .73, .73));
-	int ns = 1000;
-	for (int j = 0; j < ns; j++) {
-		boxes2.add(make_shared<Sphere>(Point3::Random(0, 165), 10, white));
+	RenderJob job;
+	if (!ParseJobArguments(args, job))
+	{
+		PrintUsage();
+		return 1;
 	}
 
-	objects.add(make_shared<Translate>(
-		make_shared<RotateY>(
-			make_shared<BVHNode>(boxes2, 0.0, 1.0), 15),
-		Vec3(-100, 270, 395)
-		)
-	);
-
-	return objects;
-}
-
-void outputToImage(std::ofstream &out, Color **colorbuffer, int height, int width, int samples_per_pixel)
-{
-	for (int i = 0; i < height; ++i)
+	std::signal(SIGINT, OnInterrupt);
+	int failed = 0;
+	if (serve_path == "-")
+		failed = Serve(std::cin, job, kept_scenes);
+	else if (!serve_path.empty())
 	{
-		for (int j = 0; j < width; ++j)
+		std::ifstream jobs(serve_path);
+		if (!jobs)
 		{
-			auto r = colorbuffer[i][j].x();
-			auto g = colorbuffer[i][j].y();
-			auto b = colorbuffer[i][j].z();
-
-			if (r != r) r = 0.0;
-			if (g != g) g = 0.0;
-			if (b != b) b = 0.0;
-
-			// Divide the color by the number of samples.
-			auto scale = 1.0 / samples_per_pixel;
-			r = sqrt(r * scale);
-			g = sqrt(g * scale);
-			b = sqrt(b * scale);
-
-			// Write the translated [0,255] value of each color component.
-			out << static_cast<int>(256 * Clamp(r, 0.0, 0.999)) << ' '
-				<< static_cast<int>(256 * Clamp(g, 0.0, 0.999)) << ' '
-				<< static_cast<int>(256 * Clamp(b, 0.0, 0.999)) << '\n';
+			std::cerr << "ERROR: can't read jobs from '" << serve_path << "'\n";
+			return 1;
 		}
+		failed = Serve(jobs, job, kept_scenes);
 	}
-}
\ No newline at end of file
+	else
+	{
+		SceneLibrary library(BuildScene);
+		failed = RunJob(library, job, 1) ? 0 : 1;
+	}
+	std::signal(SIGINT, SIG_DFL);
+
+	std::cerr << "Done.\n" << std::flush;
+	return failed == 0 ? 0 : 1;
+}